@@ -0,0 +1,385 @@
+#include "cpu.h"
+
+#include <algorithm>
+
+using namespace hemu;
+
+namespace {
+
+// See Figure 4.4 - d1 (A), d2 (D), d3 (M)
+enum : uint8_t {
+  DEST_M = 0b001,
+  DEST_D = 0b010,
+  DEST_A = 0b100,
+};
+
+// See Figure 4.5 - j1 (out < 0), j2 (out = 0), j3 (out > 0)
+enum : uint8_t {
+  JUMP_GT = 0b001,
+  JUMP_EQ = 0b010,
+  JUMP_LT = 0b100,
+};
+
+// The documented computations, in the order of Figure 4.3
+enum : uint8_t {
+  COMP_ZERO,
+  COMP_ONE,
+  COMP_NEG_ONE,
+  COMP_D,
+  COMP_A,
+  COMP_NOT_D,
+  COMP_NOT_A,
+  COMP_NEG_D,
+  COMP_NEG_A,
+  COMP_D_PLUS_1,
+  COMP_A_PLUS_1,
+  COMP_D_MINUS_1,
+  COMP_A_MINUS_1,
+  COMP_D_PLUS_A,
+  COMP_D_MINUS_A,
+  COMP_A_MINUS_D,
+  COMP_D_AND_A,
+  COMP_D_OR_A,
+  COMP_M,
+  COMP_NOT_M,
+  COMP_NEG_M,
+  COMP_M_PLUS_1,
+  COMP_M_MINUS_1,
+  COMP_D_PLUS_M,
+  COMP_D_MINUS_M,
+  COMP_M_MINUS_D,
+  COMP_D_AND_M,
+  COMP_D_OR_M,
+  COMP_COUNT
+};
+
+// a-bit and c1..c6 of each of the above
+constexpr uint8_t comp_bits[COMP_COUNT] = {
+    0b0101010, 0b0111111, 0b0111010, 0b0001100, 0b0110000, 0b0001101,
+    0b0110001, 0b0001111, 0b0110011, 0b0011111, 0b0110111, 0b0001110,
+    0b0110010, 0b0000010, 0b0010011, 0b0000111, 0b0000000, 0b0010101,
+    0b1110000, 0b1110001, 0b1110011, 0b1110111, 0b1110010, 0b1000010,
+    0b1010011, 0b1000111, 0b1000000, 0b1010101,
+};
+
+constexpr uint16_t op_of(uint8_t comp, uint8_t dest)
+{
+  return static_cast<uint16_t>(comp * 8 + dest);
+}
+
+// The ALU of chapter 2 for any combination of the control bits
+int16_t alu(uint8_t comp, int16_t x, int16_t y)
+{
+  if (comp & 0b100000)
+    x = 0;
+  if (comp & 0b010000)
+    x = static_cast<int16_t>(~x);
+  if (comp & 0b001000)
+    y = 0;
+  if (comp & 0b000100)
+    y = static_cast<int16_t>(~y);
+
+  int16_t out = (comp & 0b000010) ? static_cast<int16_t>(x + y)
+                                  : static_cast<int16_t>(x & y);
+
+  if (comp & 0b000001)
+    out = static_cast<int16_t>(~out);
+
+  return out;
+}
+
+// The jump bit of the condition `out` satisfies
+uint8_t sign_class(int16_t out)
+{
+  return (out < 0) ? JUMP_LT : ((out == 0) ? JUMP_EQ : JUMP_GT);
+}
+
+}  // namespace
+
+Cpu::Cpu() : rom_words(ROM_SIZE), rom_ops(ROM_SIZE), memory(RAM_SIZE)
+{
+  load({});
+}
+
+Cpu::MicroOp Cpu::decode(uint16_t instruction)
+{
+  if ((instruction & 0x8000) == 0)
+    return {OP_LOAD_A, 0, instruction};
+
+  auto comp = static_cast<uint8_t>((instruction >> 6) & 0x7f);
+  auto dest = static_cast<uint8_t>((instruction >> 3) & 0x7);
+  auto jump = static_cast<uint8_t>(instruction & 0x7);
+
+  for (uint8_t i = 0; i < COMP_COUNT; i++)
+  {
+    if (comp_bits[i] == comp)
+      return {op_of(i, dest), jump, 0};
+  }
+
+  return {OP_ALU, jump, static_cast<uint16_t>((dest << 8) | comp)};
+}
+
+// Decode the word at `address` and the one before, whose MicroOp depends
+// on it.  An A-instruction followed by a documented computation is fused
+// into one MicroOp that executes both, and "(END) @END 0;JMP" becomes
+// OP_HALT.
+void Cpu::decode_at(uint16_t address)
+{
+  for (uint16_t i : {static_cast<uint16_t>((address - 1) & 0x7fff), address})
+  {
+    MicroOp op = decode(rom_words[i]);
+    uint16_t next_word = rom_words[(i + 1) & 0x7fff];
+    MicroOp next = decode(next_word);
+
+    if (op.op == OP_LOAD_A)
+    {
+      // @i followed by a jump that is always taken and stores nothing
+      if ((op.value == i) && (next_word & 0x8000) &&
+          ((next_word & 0x3f) == 0b000111))
+        op.op = OP_HALT;
+      else if (next.op < OP_FUSED)
+        op = {static_cast<uint16_t>(OP_FUSED + next.op), next.jump, op.value};
+    }
+
+    rom_ops[i] = op;
+  }
+}
+
+void Cpu::load(const std::vector<uint16_t>& program)
+{
+  std::fill(rom_words.begin(), rom_words.end(), 0);
+  std::copy_n(program.begin(), std::min<size_t>(program.size(), ROM_SIZE),
+              rom_words.begin());
+
+  for (uint32_t i = 0; i < ROM_SIZE; i++)
+  {
+    decode_at(static_cast<uint16_t>(i));
+  }
+
+  reset();
+  time = 0;
+}
+
+void Cpu::set_rom(uint16_t address, uint16_t instruction)
+{
+  address &= 0x7fff;
+  rom_words[address] = instruction;
+  decode_at(address);
+  decode_at(static_cast<uint16_t>((address + 1) & 0x7fff));
+}
+
+void Cpu::reset() { pc = 0; }
+
+// Two cases per destination of a computation: with and without a fused
+// A-instruction first.  Neither the d-bits nor the fusion are tested at
+// run time.  `target` is A before the computation.
+#define COMPUTATION(comp, expression)                    \
+  case OP_FUSED + op_of(comp, 0):                        \
+    ra = static_cast<int16_t>(op.value);                 \
+    target = op.value & 0x7fff;                          \
+    rpc = (rpc + 1) & 0x7fff;                            \
+    n++;                                                 \
+    [[fallthrough]];                                     \
+  case op_of(comp, 0):                                   \
+    out = (expression);                                  \
+    break;                                               \
+  case OP_FUSED + op_of(comp, DEST_M):                   \
+    ra = static_cast<int16_t>(op.value);                 \
+    target = op.value & 0x7fff;                          \
+    rpc = (rpc + 1) & 0x7fff;                            \
+    n++;                                                 \
+    [[fallthrough]];                                     \
+  case op_of(comp, DEST_M):                              \
+    out = (expression);                                  \
+    m[target] = out;                                     \
+    break;                                               \
+  case OP_FUSED + op_of(comp, DEST_D):                   \
+    ra = static_cast<int16_t>(op.value);                 \
+    target = op.value & 0x7fff;                          \
+    rpc = (rpc + 1) & 0x7fff;                            \
+    n++;                                                 \
+    [[fallthrough]];                                     \
+  case op_of(comp, DEST_D):                              \
+    rd = out = (expression);                             \
+    break;                                               \
+  case OP_FUSED + op_of(comp, DEST_D | DEST_M):          \
+    ra = static_cast<int16_t>(op.value);                 \
+    target = op.value & 0x7fff;                          \
+    rpc = (rpc + 1) & 0x7fff;                            \
+    n++;                                                 \
+    [[fallthrough]];                                     \
+  case op_of(comp, DEST_D | DEST_M):                     \
+    rd = out = (expression);                             \
+    m[target] = out;                                     \
+    break;                                               \
+  case OP_FUSED + op_of(comp, DEST_A):                   \
+    ra = static_cast<int16_t>(op.value);                 \
+    target = op.value & 0x7fff;                          \
+    rpc = (rpc + 1) & 0x7fff;                            \
+    n++;                                                 \
+    [[fallthrough]];                                     \
+  case op_of(comp, DEST_A):                              \
+    ra = out = (expression);                             \
+    break;                                               \
+  case OP_FUSED + op_of(comp, DEST_A | DEST_M):          \
+    ra = static_cast<int16_t>(op.value);                 \
+    target = op.value & 0x7fff;                          \
+    rpc = (rpc + 1) & 0x7fff;                            \
+    n++;                                                 \
+    [[fallthrough]];                                     \
+  case op_of(comp, DEST_A | DEST_M):                     \
+    out = (expression);                                  \
+    m[target] = ra = out;                                \
+    break;                                               \
+  case OP_FUSED + op_of(comp, DEST_A | DEST_D):          \
+    ra = static_cast<int16_t>(op.value);                 \
+    target = op.value & 0x7fff;                          \
+    rpc = (rpc + 1) & 0x7fff;                            \
+    n++;                                                 \
+    [[fallthrough]];                                     \
+  case op_of(comp, DEST_A | DEST_D):                     \
+    ra = rd = out = (expression);                        \
+    break;                                               \
+  case OP_FUSED + op_of(comp, DEST_A | DEST_D | DEST_M): \
+    ra = static_cast<int16_t>(op.value);                 \
+    target = op.value & 0x7fff;                          \
+    rpc = (rpc + 1) & 0x7fff;                            \
+    n++;                                                 \
+    [[fallthrough]];                                     \
+  case op_of(comp, DEST_A | DEST_D | DEST_M):            \
+    ra = rd = out = (expression);                        \
+    m[target] = out;                                     \
+    break;
+
+uint64_t Cpu::run(uint64_t cycles, bool stop_at_halt)
+{
+  // Work on locals so the compiler can keep the registers in registers
+  const MicroOp* ops = rom_ops.data();
+  int16_t* m = memory.data();
+  int16_t ra = a;
+  int16_t rd = d;
+  uint16_t rpc = pc;
+  uint64_t n = 0;
+
+  // Leave room for a fused MicroOp's two cycles
+  while (n + 1 < cycles)
+  {
+    const MicroOp op = ops[rpc];
+    int16_t out;
+
+    uint16_t target = static_cast<uint16_t>(ra) & 0x7fff;
+
+    switch (op.op)
+    {
+      case OP_LOAD_A:
+        ra = static_cast<int16_t>(op.value);
+        rpc = (rpc + 1) & 0x7fff;
+        n++;
+        continue;
+
+      case OP_HALT:
+        if (stop_at_halt)
+          goto done;
+
+        // Nothing changes from one trip around the loop to the next, so
+        // skip all but a possible odd cycle
+        ra = static_cast<int16_t>(op.value);
+        n += (cycles - n) & ~uint64_t {1};
+        continue;
+
+      COMPUTATION(COMP_ZERO, 0)
+      COMPUTATION(COMP_ONE, 1)
+      COMPUTATION(COMP_NEG_ONE, -1)
+      COMPUTATION(COMP_D, rd)
+      COMPUTATION(COMP_A, ra)
+      COMPUTATION(COMP_NOT_D, static_cast<int16_t>(~rd))
+      COMPUTATION(COMP_NOT_A, static_cast<int16_t>(~ra))
+      COMPUTATION(COMP_NEG_D, static_cast<int16_t>(-rd))
+      COMPUTATION(COMP_NEG_A, static_cast<int16_t>(-ra))
+      COMPUTATION(COMP_D_PLUS_1, static_cast<int16_t>(rd + 1))
+      COMPUTATION(COMP_A_PLUS_1, static_cast<int16_t>(ra + 1))
+      COMPUTATION(COMP_D_MINUS_1, static_cast<int16_t>(rd - 1))
+      COMPUTATION(COMP_A_MINUS_1, static_cast<int16_t>(ra - 1))
+      COMPUTATION(COMP_D_PLUS_A, static_cast<int16_t>(rd + ra))
+      COMPUTATION(COMP_D_MINUS_A, static_cast<int16_t>(rd - ra))
+      COMPUTATION(COMP_A_MINUS_D, static_cast<int16_t>(ra - rd))
+      COMPUTATION(COMP_D_AND_A, static_cast<int16_t>(rd & ra))
+      COMPUTATION(COMP_D_OR_A, static_cast<int16_t>(rd | ra))
+      COMPUTATION(COMP_M, m[target])
+      COMPUTATION(COMP_NOT_M, static_cast<int16_t>(~m[target]))
+      COMPUTATION(COMP_NEG_M, static_cast<int16_t>(-m[target]))
+      COMPUTATION(COMP_M_PLUS_1, static_cast<int16_t>(m[target] + 1))
+      COMPUTATION(COMP_M_MINUS_1, static_cast<int16_t>(m[target] - 1))
+      COMPUTATION(COMP_D_PLUS_M, static_cast<int16_t>(rd + m[target]))
+      COMPUTATION(COMP_D_MINUS_M, static_cast<int16_t>(rd - m[target]))
+      COMPUTATION(COMP_M_MINUS_D, static_cast<int16_t>(m[target] - rd))
+      COMPUTATION(COMP_D_AND_M, static_cast<int16_t>(rd & m[target]))
+      COMPUTATION(COMP_D_OR_M, static_cast<int16_t>(rd | m[target]))
+
+      default:
+      {
+        auto comp = static_cast<uint8_t>(op.value);
+        auto dest = static_cast<uint8_t>(op.value >> 8);
+
+        out = alu(comp & 0x3f, rd, (comp & 0x40) ? m[target] : ra);
+
+        if (dest & DEST_M)
+          m[target] = out;
+        if (dest & DEST_A)
+          ra = out;
+        if (dest & DEST_D)
+          rd = out;
+        break;
+      }
+    }
+
+    n++;
+    rpc = (op.jump & sign_class(out)) ? target : ((rpc + 1) & 0x7fff);
+  }
+
+done:
+  a = ra;
+  d = rd;
+  pc = rpc;
+
+  // The last cycle may be half of a fused MicroOp
+  if ((n < cycles) && !(stop_at_halt && halted()))
+  {
+    step();
+    n++;
+  }
+
+  time += n;
+
+  return n;
+}
+
+// Execute the instruction at the PC without its MicroOp
+void Cpu::step()
+{
+  uint16_t instruction = rom_words[pc];
+
+  if ((instruction & 0x8000) == 0)
+  {
+    a = static_cast<int16_t>(instruction);
+    pc = (pc + 1) & 0x7fff;
+    return;
+  }
+
+  const uint16_t target = static_cast<uint16_t>(a) & 0x7fff;
+  auto comp = static_cast<uint8_t>((instruction >> 6) & 0x7f);
+  auto dest = static_cast<uint8_t>((instruction >> 3) & 0x7);
+
+  int16_t out = alu(comp & 0x3f, d, (comp & 0x40) ? memory[target] : a);
+
+  if (dest & DEST_M)
+    memory[target] = out;
+  if (dest & DEST_A)
+    a = out;
+  if (dest & DEST_D)
+    d = out;
+
+  pc = ((instruction & 0x7) & sign_class(out)) ? target : ((pc + 1) & 0x7fff);
+}
+
+#undef COMPUTATION
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace hemu {
+
+// The Hack computer: CPU, 32K ROM and the data memory of Figure 5.7.
+//
+// load() predecodes each ROM word into a MicroOp so that run() never looks
+// at instruction bits: an A-instruction becomes OP_LOAD_A with its
+// constant, a C-instruction becomes a handler for its computation and
+// destination together, with the jump bits kept alongside.  A jump is
+// taken when `jump` has the bit of the result's sign class set, so every
+// jump condition costs the same test.
+//
+// Each instruction takes one clock cycle and `time` counts them.  As in
+// CPU.hdl, a jump goes to the value A had before the instruction.
+class Cpu {
+public:
+  static constexpr uint32_t ROM_SIZE = 32768;
+  static constexpr uint32_t RAM_SIZE = 32768;  // 15 address bits
+  static constexpr uint16_t SCREEN = 16384;
+  static constexpr uint16_t KBD = 24576;
+
+  Cpu();
+
+  // Replace the ROM with `program`, padded with zeros, and reset
+  void load(const std::vector<uint16_t>& program);
+
+  // Set the PC to 0 as the reset input does; registers and RAM are kept
+  void reset();
+
+  // Execute up to `cycles` instructions.  With `stop_at_halt`, stops at
+  // the first halt loop reached.  Returns the number executed.
+  uint64_t run(uint64_t cycles, bool stop_at_halt = false);
+
+  // Execute the instruction at the PC, as run(1) does, for tools that
+  // look at each instruction
+  void single_step()
+  {
+    step();
+    time++;
+  }
+
+  // The PC is at a halt loop, "(END) @END 0;JMP"
+  bool halted() const { return rom_ops[pc].op == OP_HALT; }
+
+  uint16_t rom(uint16_t address) const { return rom_words[address & 0x7fff]; }
+  void set_rom(uint16_t address, uint16_t instruction);
+
+  int16_t ram(uint16_t address) const { return memory[address & 0x7fff]; }
+  void set_ram(uint16_t address, int16_t value)
+  {
+    memory[address & 0x7fff] = value;
+  }
+
+  const int16_t* ram_data() const { return memory.data(); }
+
+  int16_t a {0};
+  int16_t d {0};
+  uint16_t pc {0};
+  uint64_t time {0};
+
+private:
+  // Ops below OP_FUSED are one of the documented computations combined
+  // with a destination, computation * 8 + dest.  OP_FUSED is added when
+  // the A-instruction before is executed first.  OP_ALU is any other
+  // computation, with its bits and the destination in `value`.
+  enum : uint16_t {
+    OP_FUSED = 224,
+    OP_ALU = 2 * OP_FUSED,
+    OP_LOAD_A,
+    OP_HALT,
+  };
+
+  struct MicroOp {
+    uint16_t op;
+    uint8_t jump;    // JUMP_* bits
+    uint16_t value;  // of an A-instruction, or for OP_ALU
+  };
+
+  static MicroOp decode(uint16_t instruction);
+  void decode_at(uint16_t address);
+  void step();
+
+  std::vector<uint16_t> rom_words;
+  std::vector<MicroOp> rom_ops;
+  std::vector<int16_t> memory;
+};
+
+}  // namespace hemu
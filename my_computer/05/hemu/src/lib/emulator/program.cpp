@@ -0,0 +1,65 @@
+#include "program.h"
+
+#include "assembler/assembler.h"
+#include "util/mapped_file.h"
+
+#include <stdexcept>
+
+using namespace hemu;
+
+std::vector<uint16_t> hemu::parse_hack(std::string_view text)
+{
+  std::vector<uint16_t> program;
+  int line_number = 0;
+  size_t start = 0;
+
+  while (start < text.size())
+  {
+    size_t end = text.find('\n', start);
+
+    if (end == std::string_view::npos)
+      end = text.size();
+
+    std::string_view line = text.substr(start, end - start);
+    start = end + 1;
+    line_number++;
+
+    if (!line.empty() && (line.back() == '\r'))
+      line.remove_suffix(1);
+
+    if (line.empty())
+      continue;
+
+    if (line.size() != 16)
+      throw std::runtime_error("Expected 16 binary digits at line " +
+                               std::to_string(line_number));
+
+    uint16_t instruction = 0;
+
+    for (char c : line)
+    {
+      if ((c != '0') && (c != '1'))
+        throw std::runtime_error("Expected 16 binary digits at line " +
+                                 std::to_string(line_number));
+
+      instruction = static_cast<uint16_t>((instruction << 1) | (c - '0'));
+    }
+
+    program.push_back(instruction);
+  }
+
+  return program;
+}
+
+std::vector<uint16_t> hemu::load_program(const std::string& filename)
+{
+  hasm::MappedFile input(filename);
+
+  if (filename.ends_with(".asm"))
+  {
+    hasm::Assembler assembler(input.contents());
+    return assembler.assemble();
+  }
+
+  return parse_hack(input.contents());
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hemu {
+
+// Machine code of the program in `filename`: either a .hack file, one
+// line of 16 binary digits per instruction, or a .asm file, which is
+// assembled.  Throws std::runtime_error if it cannot be read or is invalid.
+std::vector<uint16_t> load_program(const std::string& filename);
+
+// Parse the text of a .hack file
+std::vector<uint16_t> parse_hack(std::string_view text);
+
+}  // namespace hemu
@@ -0,0 +1,220 @@
+#include "hemu.h"
+
+#include "emulator/cpu.h"
+#include "emulator/program.h"
+#include "profile/profiler.h"
+#include "profile/source_map.h"
+#include "script/script_error.h"
+#include "script/test_script.h"
+#include "util/mapped_file.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+using namespace hemu;
+
+namespace {
+
+constexpr uint64_t DEFAULT_CYCLES = 100000000;
+
+void show_usage()
+{
+  std::cout << "USAGE: hemu [-h] [-s] [-n CYCLES] [-d DIR] [-p N] "
+               "FILE.tst|FILE.hack|FILE.asm"
+            << std::endl;
+}
+
+void show_help()
+{
+  show_usage();
+  std::cout << std::endl
+            << "Runs a CPU emulator test script, comparing its output with the"
+            << std::endl
+            << "compare-to file, or runs a program until it reaches a halt"
+            << std::endl
+            << "loop and prints the registers and RAM[0..15]." << std::endl
+            << std::endl
+            << "    -h          Display available options" << std::endl
+            << "    -s          Report the instructions executed per second"
+            << std::endl
+            << "    -n CYCLES   Stop a program after CYCLES instructions"
+            << std::endl
+            << "    -d DIR      Write the output-file of a script to DIR"
+            << std::endl
+            << "    -p N        Profile a program written by vmt, showing the N"
+            << std::endl
+            << "                functions, VM lines, Jack lines and calls that"
+            << std::endl
+            << "                took the most cycles.  Reads the FILE.map of"
+            << std::endl
+            << "                vmt -m when found, else the comments of FILE.asm"
+            << std::endl;
+}
+
+// The source map of the program at `path`: its FILE.map when there is one,
+// else the comments of the .asm
+SourceMap read_source_map(const std::filesystem::path& path)
+{
+  std::filesystem::path map_path = path;
+  map_path.replace_extension(".map");
+
+  if (std::filesystem::exists(map_path))
+  {
+    hasm::MappedFile input(map_path.string());
+    return SourceMap::parse_map(input.contents());
+  }
+
+  if (path.extension() != ".asm")
+    throw std::runtime_error("Profiling needs the FILE.map or the .asm written "
+                             "by vmt");
+
+  hasm::MappedFile input(path.string());
+  return SourceMap(input.contents(), path.parent_path());
+}
+
+void show_speed(uint64_t instructions,
+                std::chrono::steady_clock::time_point start)
+{
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::cerr << "Executed " << instructions << " instructions in "
+            << elapsed.count() * 1000.0 << " ms ("
+            << static_cast<double>(instructions) / elapsed.count() / 1e6
+            << " MIPS)" << std::endl;
+}
+
+int run_script(const std::filesystem::path& path, const char* output_directory,
+               bool show_stats)
+{
+  hasm::MappedFile input(path.string());
+  TestScript script(input.contents(), path.parent_path());
+
+  if (output_directory != nullptr)
+    script.set_output_directory(output_directory);
+
+  auto start_time = std::chrono::steady_clock::now();
+  bool passed = script.run();
+
+  if (show_stats)
+    show_speed(script.cpu().time, start_time);
+
+  if (!passed)
+  {
+    std::cout << "Comparison failure at line " << script.failed_line()
+              << std::endl;
+    return 1;
+  }
+
+  std::cout << "End of script - Comparison ended successfully" << std::endl;
+  return 0;
+}
+
+int run_program(const std::filesystem::path& path, uint64_t cycles,
+                bool show_stats, size_t profile_top)
+{
+  Cpu cpu;
+  cpu.load(load_program(path.string()));
+
+  auto start_time = std::chrono::steady_clock::now();
+
+  if (profile_top > 0)
+  {
+    SourceMap source = read_source_map(path);
+    Profiler profiler(cpu, source);
+
+    profiler.run(cycles);
+    profiler.report(std::cout, profile_top);
+    std::cout << std::endl;
+  }
+  else
+  {
+    cpu.run(cycles, true);
+  }
+
+  if (show_stats)
+    show_speed(cpu.time, start_time);
+
+  std::cout << (cpu.halted() ? "Halted" : "Stopped") << " after "
+            << cpu.time << " cycles" << std::endl
+            << "PC: " << cpu.pc << "  A: " << cpu.a << "  D: " << cpu.d
+            << std::endl;
+
+  for (uint16_t i = 0; i < 16; i++)
+  {
+    std::cout << "RAM[" << i << "]: " << cpu.ram(i) << std::endl;
+  }
+
+  return 0;
+}
+
+}  // namespace
+
+int hemu_main(int argc, const char* argv[])
+{
+  bool show_stats = false;
+  uint64_t cycles = DEFAULT_CYCLES;
+  const char* output_directory = nullptr;
+  size_t profile_top = 0;
+  int argi = 1;
+
+  for (; argi < argc - 1; argi++)
+  {
+    if (strcmp(argv[argi], "-s") == 0)
+    {
+      show_stats = true;
+    }
+    else if ((strcmp(argv[argi], "-n") == 0) && (argi + 1 < argc - 1))
+    {
+      cycles = std::strtoull(argv[++argi], nullptr, 10);
+    }
+    else if ((strcmp(argv[argi], "-d") == 0) && (argi + 1 < argc - 1))
+    {
+      output_directory = argv[++argi];
+    }
+    else if ((strcmp(argv[argi], "-p") == 0) && (argi + 1 < argc - 1))
+    {
+      profile_top = std::strtoul(argv[++argi], nullptr, 10);
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  if (argi != argc - 1)
+  {
+    show_usage();
+    return 1;
+  }
+
+  if ((strcmp(argv[argi], "--help") == 0) || (strcmp(argv[argi], "-h") == 0))
+  {
+    show_help();
+    return 1;
+  }
+
+  std::filesystem::path path(argv[argi]);
+
+  try
+  {
+    if (path.extension() == ".tst")
+      return run_script(path, output_directory, show_stats);
+
+    return run_program(path, cycles, show_stats, profile_top);
+  }
+  catch (const ScriptError& e)
+  {
+    std::cout << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  catch (const std::runtime_error& e)
+  {
+    std::cout << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+}
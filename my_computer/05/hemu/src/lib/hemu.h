@@ -0,0 +1,4 @@
+#pragma once
+
+// Command line entry point of the emulator
+int hemu_main(int argc, const char* argv[]);
@@ -0,0 +1,240 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+using namespace hemu;
+
+namespace {
+
+constexpr uint16_t LCL = 1;
+
+// Entries of `table` with the most cycles first, ties in key order
+template <typename Key>
+std::vector<std::pair<Key, uint64_t>> sorted_by_cycles(
+    const std::map<Key, uint64_t>& table, size_t top)
+{
+  std::vector<std::pair<Key, uint64_t>> rows(table.begin(), table.end());
+
+  std::stable_sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+    return a.second > b.second;
+  });
+
+  if (rows.size() > top)
+    rows.resize(top);
+
+  return rows;
+}
+
+void write_cycles(std::ostream& out, uint64_t cycles, uint64_t total)
+{
+  double percent = (total > 0) ? 100.0 * static_cast<double>(cycles) /
+                                     static_cast<double>(total)
+                               : 0.0;
+
+  out << std::setw(12) << cycles << std::setw(7) << std::fixed
+      << std::setprecision(1) << percent << "%  ";
+}
+
+// "Main.vm" -> "Main.jack"
+std::string jack_file_name(const std::string& vm_file)
+{
+  return vm_file.substr(0, vm_file.rfind('.')) + ".jack";
+}
+
+}  // namespace
+
+Profiler::Profiler(Cpu& cpu, const SourceMap& map)
+    : computer(cpu),
+      source(map),
+      address_cycles(Cpu::ROM_SIZE, 0),
+      active(map.function_count(), 0),
+      inclusive(map.function_count())
+{
+}
+
+uint64_t Profiler::run(uint64_t cycles)
+{
+  uint64_t n = 0;
+
+  while ((n < cycles) && !computer.halted())
+  {
+    uint16_t address = computer.pc;
+
+    computer.single_step();
+    address_cycles[address]++;
+    n++;
+
+    if (computer.pc == ((address + 1) & 0x7fff))
+      continue;
+
+    // The return sequence restores the caller's LCL before it jumps.
+    // Frames replaced by tail calls (vmt -ftail-calls) return together.
+    while (!stack.empty() && (computer.pc == stack.back().return_address) &&
+           (computer.ram(LCL) == stack.back().caller_lcl))
+    {
+      leave();
+    }
+
+    // A goto to a label at the very start of a function reaches its entry
+    // too, but keeps the frame
+    if (int function = source.function_at_entry(computer.pc);
+        (function >= 0) &&
+        (stack.empty() || (computer.ram(LCL) != stack.back().lcl)))
+    {
+      enter(function);
+    }
+  }
+
+  return n;
+}
+
+void Profiler::enter(int function)
+{
+  // The outermost call is made by the bootstrap
+  int caller = stack.empty() ? 0 : stack.back().function;
+  int16_t lcl = computer.ram(LCL);
+
+  stack.push_back({function, lcl, computer.ram(lcl - 4),
+                   static_cast<uint16_t>(computer.ram(lcl - 5) & 0x7fff),
+                   computer.time});
+
+  active[function]++;
+  active_edges[{caller, function}]++;
+  inclusive[function].calls++;
+  edges[{caller, function}].calls++;
+}
+
+void Profiler::leave()
+{
+  Frame frame = stack.back();
+  stack.pop_back();
+
+  uint64_t elapsed = computer.time - frame.start;
+  int caller = stack.empty() ? 0 : stack.back().function;
+
+  if (--active_edges[{caller, frame.function}] == 0)
+    edges[{caller, frame.function}].cycles += elapsed;
+
+  if (--active[frame.function] == 0)
+    inclusive[frame.function].cycles += elapsed;
+}
+
+void Profiler::report(std::ostream& out, size_t top) const
+{
+  uint64_t total = 0;
+  std::map<int, uint64_t> self;
+  std::map<std::pair<int, int>, uint64_t> vm_lines;
+  std::map<std::pair<int, int>, uint64_t> jack_lines;
+
+  for (uint32_t address = 0; address < Cpu::ROM_SIZE; address++)
+  {
+    uint64_t cycles = address_cycles[address];
+
+    if (cycles == 0)
+      continue;
+
+    const SourceLocation& location = source.at(static_cast<uint16_t>(address));
+
+    total += cycles;
+    self[location.function] += cycles;
+    vm_lines[{location.file, location.vm_line}] += cycles;
+
+    if (location.jack_line > 0)
+      jack_lines[{location.file, location.jack_line}] += cycles;
+  }
+
+  // Functions still running, such as Sys.init, are charged to now
+  std::vector<Totals> totals = inclusive;
+  std::vector<int> open(active.size(), 0);
+
+  for (const auto& frame : stack)
+  {
+    if (open[frame.function]++ == 0)
+      totals[frame.function].cycles += computer.time - frame.start;
+  }
+
+  out << "Flat profile: " << total << " cycles" << std::endl
+      << std::setw(12) << "cycles" << std::setw(8) << "%" << "  function"
+      << std::endl;
+
+  for (const auto& [function, cycles] : sorted_by_cycles(self, top))
+  {
+    write_cycles(out, cycles, total);
+    out << source.function_name(function) << std::endl;
+  }
+
+  out << std::endl << "By VM line:" << std::endl;
+
+  for (const auto& [line, cycles] : sorted_by_cycles(vm_lines, top))
+  {
+    write_cycles(out, cycles, total);
+
+    // The bootstrap and vmt's shared routines
+    if (line.first < 0)
+      out << "(no VM line)" << std::endl;
+    else
+      out << source.file_name(line.first) << ":" << line.second << std::endl;
+  }
+
+  if (source.has_jack_lines())
+  {
+    out << std::endl << "By Jack line:" << std::endl;
+
+    for (const auto& [line, cycles] : sorted_by_cycles(jack_lines, top))
+    {
+      write_cycles(out, cycles, total);
+      out << jack_file_name(source.file_name(line.first)) << ":"
+          << line.second << std::endl;
+    }
+  }
+
+  std::map<int, uint64_t> functions;
+
+  for (size_t function = 0; function < totals.size(); function++)
+  {
+    if (totals[function].calls > 0)
+      functions[static_cast<int>(function)] = totals[function].cycles;
+  }
+
+  out << std::endl
+      << "Call graph, cycles including callees:" << std::endl
+      << std::setw(12) << "cycles" << std::setw(8) << "%" << "  function"
+      << " (calls)" << std::endl;
+
+  for (const auto& [function, cycles] : sorted_by_cycles(functions, top))
+  {
+    write_cycles(out, cycles, total);
+    out << source.function_name(function) << " (" << totals[function].calls
+        << ")" << std::endl;
+  }
+
+  // Open frames of the edges as well, the outermost of each
+  std::map<std::pair<int, int>, uint64_t> calls;
+  std::map<std::pair<int, int>, int> open_edges;
+
+  for (const auto& [edge, edge_totals] : edges)
+    calls[edge] = edge_totals.cycles;
+
+  for (size_t i = 0; i < stack.size(); i++)
+  {
+    int caller = (i == 0) ? 0 : stack[i - 1].function;
+    std::pair<int, int> edge {caller, stack[i].function};
+
+    if (open_edges[edge]++ == 0)
+      calls[edge] += computer.time - stack[i].start;
+  }
+
+  out << std::endl
+      << std::setw(12) << "cycles" << std::setw(8) << "%"
+      << "  caller -> callee (calls)" << std::endl;
+
+  for (const auto& [edge, cycles] : sorted_by_cycles(calls, top))
+  {
+    write_cycles(out, cycles, total);
+    out << source.function_name(edge.first) << " -> "
+        << source.function_name(edge.second) << " ("
+        << edges.at(edge).calls << ")" << std::endl;
+  }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "emulator/cpu.h"
+#include "profile/source_map.h"
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace hemu {
+
+// Runs a program translated by vmt one instruction at a time and
+// attributes each cycle to the address that took it.  The report groups
+// the cycles by function, VM line and Jack line (flat profile) and follows
+// calls and returns for the time of each function including its callees
+// (call graph).
+//
+// A call is a jump to the entry of a function that sets up a new frame,
+// i.e. LCL changes.  Its return address is then RAM[LCL - 5] and the
+// caller's LCL RAM[LCL - 4], as the VM frame layout puts them, and the
+// frame ends when that address is reached with the caller's LCL restored.
+// Checking LCL tells a return from a jump that only happens to reach the
+// same address, such as the entry of the function placed right after the
+// bootstrap's call of Sys.init.
+class Profiler {
+public:
+  Profiler(Cpu& cpu, const SourceMap& map);
+
+  // Execute up to `cycles` instructions, stopping at a halt loop.
+  // Returns the number executed.
+  uint64_t run(uint64_t cycles);
+
+  // Write the `top` entries of each table
+  void report(std::ostream& out, size_t top) const;
+
+private:
+  struct Frame {
+    int function;
+    int16_t lcl;
+    int16_t caller_lcl;
+    uint16_t return_address;
+    uint64_t start;
+  };
+
+  struct Totals {
+    uint64_t calls {0};
+    uint64_t cycles {0};
+  };
+
+  void enter(int function);
+  void leave();
+
+  Cpu& computer;
+  const SourceMap& source;
+
+  std::vector<uint64_t> address_cycles;
+  std::vector<Frame> stack;
+
+  // Frames of each function on the stack, so that the time of recursive
+  // calls is counted once
+  std::vector<int> active;
+  std::vector<Totals> inclusive;
+  std::map<std::pair<int, int>, Totals> edges;  // (caller, callee)
+
+  // Frames of each edge on the stack, for the same reason
+  std::map<std::pair<int, int>, int> active_edges;
+};
+
+}  // namespace hemu
@@ -0,0 +1,310 @@
+#include "source_map.h"
+
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+
+using namespace hemu;
+
+namespace {
+
+std::string_view trim(std::string_view text)
+{
+  while (!text.empty() && ((text.front() == ' ') || (text.front() == '\t')))
+    text.remove_prefix(1);
+
+  while (!text.empty() && ((text.back() == ' ') || (text.back() == '\t') ||
+                           (text.back() == '\r')))
+    text.remove_suffix(1);
+
+  return text;
+}
+
+// The number at the start of `text`, which is advanced past it
+bool parse_number(std::string_view& text, int& value)
+{
+  auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+
+  if ((ec != std::errc()) || (end == text.data()))
+    return false;
+
+  text.remove_prefix(static_cast<size_t>(end - text.data()));
+  return true;
+}
+
+// The next tab separated field of `text`, which is advanced past it
+std::string_view next_field(std::string_view& text)
+{
+  size_t end = text.find('\t');
+  std::string_view field = text.substr(0, end);
+
+  text.remove_prefix((end == std::string_view::npos) ? text.size() : end + 1);
+  return field;
+}
+
+// The name and line of a "Main.vm:12" position
+bool parse_position(std::string_view field, std::string_view& name, int& line)
+{
+  size_t colon = field.rfind(':');
+
+  if ((colon == std::string_view::npos) || (colon == 0))
+    return false;
+
+  name = field.substr(0, colon);
+  field.remove_prefix(colon + 1);
+  return parse_number(field, line) && field.empty();
+}
+
+}  // namespace
+
+SourceMap::SourceMap(std::string_view asm_text,
+                     const std::filesystem::path& vm_directory)
+{
+  int function = add_function("(bootstrap)");
+  int file = -1;
+  int vm_line = 0;
+  std::string_view pending_function;
+
+  while (!asm_text.empty())
+  {
+    size_t end = asm_text.find('\n');
+
+    if (end == std::string_view::npos)
+      end = asm_text.size();
+
+    std::string_view line = trim(asm_text.substr(0, end));
+    asm_text.remove_prefix(std::min(end + 1, asm_text.size()));
+
+    if (line.starts_with("//"))
+    {
+      std::string_view comment = trim(line.substr(2));
+
+      if (comment.starts_with("File: "))
+      {
+        std::string name(trim(comment.substr(6)));
+
+        file = static_cast<int>(file_names.size());
+        file_names.push_back(name);
+        read_jack_lines(file, vm_directory / name);
+
+        // Code ahead of the first function of the file, as in the course's
+        // Stage 1 tests
+        function = add_function(name);
+        vm_line = 0;
+      }
+      else if (int number; parse_number(comment, number))
+      {
+        int last;
+
+        // "N: command" or "N-M: superinstruction"
+        if (comment.starts_with("-"))
+        {
+          comment.remove_prefix(1);
+          parse_number(comment, last);
+        }
+
+        if (comment.starts_with(": "))
+        {
+          vm_line = number;
+          comment.remove_prefix(2);
+
+          if (comment.starts_with("function "))
+          {
+            comment.remove_prefix(9);
+            pending_function = comment.substr(0, comment.find(' '));
+          }
+        }
+      }
+
+      continue;
+    }
+
+    if (size_t comment = line.find("//"); comment != std::string_view::npos)
+      line = trim(line.substr(0, comment));
+
+    if (line.empty())
+      continue;
+
+    if (line.front() == '(')
+    {
+      std::string_view label = line.substr(1, line.find(')') - 1);
+
+      if (!pending_function.empty() && (label == pending_function))
+      {
+        function = add_function(label);
+        entries[static_cast<uint16_t>(locations.size())] = function;
+        pending_function = {};
+      }
+      else if (label.starts_with("$$"))
+      {
+        // A routine vmt places after the translated files
+        function = add_function(label);
+        file = -1;
+        vm_line = 0;
+      }
+
+      continue;
+    }
+
+    SourceLocation location {function, file, vm_line, 0};
+
+    if ((file >= 0) && (static_cast<size_t>(vm_line) < jack_lines[file].size()))
+      location.jack_line = jack_lines[file][vm_line];
+
+    locations.push_back(location);
+  }
+}
+
+SourceMap SourceMap::parse_map(std::string_view map_text)
+{
+  SourceMap map;
+  std::unordered_map<std::string_view, int> files;
+  int function = -1;
+  int line_number = 0;
+
+  while (!map_text.empty())
+  {
+    size_t end = map_text.find('\n');
+
+    if (end == std::string_view::npos)
+      end = map_text.size();
+
+    std::string_view line = map_text.substr(0, end);
+    map_text.remove_prefix(std::min(end + 1, map_text.size()));
+    line_number++;
+
+    if (line.ends_with('\r'))
+      line.remove_suffix(1);
+
+    if (line.empty())
+      continue;
+
+    std::string_view first_field = next_field(line);
+    std::string_view last_field = next_field(line);
+    std::string_view function_field = next_field(line);
+    std::string_view vm_field = next_field(line);
+    std::string_view jack_field = next_field(line);
+    std::string_view vm_file;
+    std::string_view jack_file;
+    SourceLocation location;
+    int first;
+    int last;
+
+    if (!parse_number(first_field, first) || !first_field.empty() ||
+        !parse_number(last_field, last) || !last_field.empty() ||
+        (static_cast<size_t>(first) < map.locations.size()) ||
+        (last < first) || (last > INT16_MAX) || function_field.empty() ||
+        (!vm_field.empty() &&
+         !parse_position(vm_field, vm_file, location.vm_line)) ||
+        (!jack_field.empty() &&
+         !parse_position(jack_field, jack_file, location.jack_line)) ||
+        !line.empty())
+    {
+      throw std::invalid_argument("Invalid source map line " +
+                                  std::to_string(line_number));
+    }
+
+    if (!vm_file.empty())
+    {
+      auto [found, inserted] = files.try_emplace(vm_file,
+          static_cast<int>(map.file_names.size()));
+
+      if (inserted)
+        map.file_names.emplace_back(vm_file);
+
+      location.file = found->second;
+    }
+
+    if (!jack_file.empty())
+      map.jack_lines_found = true;
+
+    // Named as by the comments of the .asm
+    std::string_view name = function_field;
+
+    if (name == "-")
+      name = (location.file >= 0) ? std::string_view(map.file_names[location.file])
+                                  : std::string_view("(bootstrap)");
+
+    if ((function < 0) || (map.function_names[function] != name))
+    {
+      function = map.add_function(name);
+
+      if ((function_field != "-") && !function_field.starts_with("$$"))
+        map.entries[static_cast<uint16_t>(first)] = function;
+    }
+
+    location.function = function;
+
+    // Addresses left out of the map are unknown
+    map.locations.resize(first);
+    map.locations.resize(last + 1, location);
+  }
+
+  return map;
+}
+
+int SourceMap::add_function(std::string_view name)
+{
+  function_names.emplace_back(name);
+  return static_cast<int>(function_names.size()) - 1;
+}
+
+void SourceMap::read_jack_lines(int file, const std::filesystem::path& path)
+{
+  jack_lines.resize(file + 1);
+
+  std::ifstream input(path);
+  std::vector<int>& lines = jack_lines[file];
+  std::string text;
+  int jack_line = 0;
+
+  // VM lines are numbered from 1
+  lines.push_back(0);
+
+  while (std::getline(input, text))
+  {
+    std::string_view line = trim(text);
+
+    if (line.starts_with("// line "))
+    {
+      line.remove_prefix(8);
+
+      if (parse_number(line, jack_line))
+        jack_lines_found = true;
+    }
+    else if (line.starts_with("function "))
+    {
+      jack_line = 0;
+    }
+
+    lines.push_back(jack_line);
+  }
+}
+
+const SourceLocation& SourceMap::at(uint16_t address) const
+{
+  static const SourceLocation unknown;
+
+  return (address < locations.size()) ? locations[address] : unknown;
+}
+
+int SourceMap::function_at_entry(uint16_t address) const
+{
+  auto found = entries.find(address);
+
+  return (found != entries.end()) ? found->second : -1;
+}
+
+const std::string& SourceMap::function_name(int function) const
+{
+  static const std::string unknown("(unknown)");
+
+  return (function >= 0) ? function_names[function] : unknown;
+}
+
+const std::string& SourceMap::file_name(int file) const
+{
+  static const std::string unknown("(unknown)");
+
+  return (file >= 0) ? file_names[file] : unknown;
+}
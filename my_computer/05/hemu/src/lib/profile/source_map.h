@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace hemu {
+
+// Where the instruction at a ROM address came from.  Indexes refer to
+// SourceMap::function_name() and SourceMap::file_name(); -1 is unknown.
+struct SourceLocation {
+  int function {-1};
+  int file {-1};
+  int vm_line {0};
+  int jack_line {0};  // 0 unless the .vm file has "// line N" markers
+};
+
+// Maps the ROM addresses of a program translated by vmt back to the VM
+// code it was translated from, using the comments vmt writes:
+//
+//   // File: Main.vm           the .vm file of the code that follows
+//   // 12: push local 0        VM line of the code that follows
+//   // 12-15: array load       the same for a superinstruction
+//   // 20: function Main.f (0 nargs)
+//   (Main.f)                   entry of a function
+//
+// Code that vmt writes outside of any file or function, such as the
+// bootstrap and the shared $$CALL and $$RETURN routines, belongs to a
+// pseudo function named after its label or "(bootstrap)".
+//
+// The .vm files, when found beside the .asm, give the Jack lines: jfcl -g
+// writes a "// line N" comment ahead of the commands of each statement.
+//
+// The FILE.map of vmt -m gives the same without the .asm, one range of
+// addresses per line:
+//
+//   FIRST LAST Main.f Main.vm:12 Main.jack:7
+//
+// where the function is "-" outside of any, and the VM and Jack positions
+// are left out when unknown.
+class SourceMap {
+public:
+  // Read the comments of `asm_text`.  The .vm files are looked for in
+  // `vm_directory`.
+  SourceMap(std::string_view asm_text,
+            const std::filesystem::path& vm_directory);
+
+  // Read the FILE.map of `map_text`.  Throws std::invalid_argument on a
+  // malformed line.
+  static SourceMap parse_map(std::string_view map_text);
+
+  // Location of the instruction at `address`
+  const SourceLocation& at(uint16_t address) const;
+
+  // The function whose entry is `address`, or -1
+  int function_at_entry(uint16_t address) const;
+
+  const std::string& function_name(int function) const;
+  const std::string& file_name(int file) const;
+
+  size_t function_count() const { return function_names.size(); }
+  size_t file_count() const { return file_names.size(); }
+
+  // Did any .vm file have Jack line markers?
+  bool has_jack_lines() const { return jack_lines_found; }
+
+private:
+  SourceMap() = default;
+
+  int add_function(std::string_view name);
+  void read_jack_lines(int file, const std::filesystem::path& path);
+
+  std::vector<SourceLocation> locations;
+  std::unordered_map<uint16_t, int> entries;
+  std::vector<std::string> function_names;
+  std::vector<std::string> file_names;
+
+  // Jack line of each line of each .vm file
+  std::vector<std::vector<int>> jack_lines;
+  bool jack_lines_found {false};
+};
+
+}  // namespace hemu
@@ -0,0 +1,114 @@
+#include "output_column.h"
+
+#include <charconv>
+#include <stdexcept>
+
+using namespace hemu;
+
+namespace {
+
+int parse_number(std::string_view text, std::string_view spec)
+{
+  int value = 0;
+  auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(),
+                                   value);
+
+  if ((ec != std::errc()) || (end != text.data() + text.size()) || (value < 0))
+    throw std::invalid_argument("Invalid output format '" + std::string(spec) +
+                                "'");
+
+  return value;
+}
+
+// The low `length` digits of the 16-bit `value` in base 2^bits
+std::string low_digits(int64_t value, int bits, int length)
+{
+  static constexpr char digits[] = "0123456789ABCDEF";
+
+  int count = 16 / bits;
+  std::string text(static_cast<size_t>(count), '0');
+  auto word = static_cast<uint16_t>(value);
+
+  for (int i = count - 1; i >= 0; i--)
+  {
+    text[static_cast<size_t>(i)] = digits[word & ((1 << bits) - 1)];
+    word = static_cast<uint16_t>(word >> bits);
+  }
+
+  if (length < count)
+    return text.substr(static_cast<size_t>(count - length));
+
+  return std::string(static_cast<size_t>(length - count), ' ') + text;
+}
+
+}  // namespace
+
+OutputColumn OutputColumn::parse(std::string_view spec)
+{
+  OutputColumn column;
+  auto percent = spec.find('%');
+
+  column.name = spec.substr(0, percent);
+
+  if (percent == std::string_view::npos)
+    return column;
+
+  std::string_view format = spec.substr(percent + 1);
+  auto first_dot = format.find('.');
+  auto second_dot = format.find('.', first_dot + 1);
+
+  if (format.empty() || (first_dot == std::string_view::npos) ||
+      (second_dot == std::string_view::npos) ||
+      (std::string_view("BDSX").find(format[0]) == std::string_view::npos))
+    throw std::invalid_argument("Invalid output format '" + std::string(spec) +
+                                "'");
+
+  column.format = format[0];
+  column.pad_left = parse_number(format.substr(1, first_dot - 1), spec);
+  column.length = parse_number(
+      format.substr(first_dot + 1, second_dot - first_dot - 1), spec);
+  column.pad_right = parse_number(format.substr(second_dot + 1), spec);
+
+  return column;
+}
+
+std::string OutputColumn::header() const
+{
+  size_t width = static_cast<size_t>(pad_left + length + pad_right);
+  std::string text = name.substr(0, width);
+  size_t left = (width - text.size()) / 2;
+
+  return std::string(left, ' ') + text +
+         std::string(width - left - text.size(), ' ');
+}
+
+std::string OutputColumn::format_value(int64_t value) const
+{
+  std::string text;
+
+  switch (format)
+  {
+    case 'B':
+      text = low_digits(value, 1, length);
+      break;
+
+    case 'X':
+      text = low_digits(value, 4, length);
+      break;
+
+    case 'S':
+      text = std::to_string(value);
+      if (text.size() < static_cast<size_t>(length))
+        text.append(static_cast<size_t>(length) - text.size(), ' ');
+      break;
+
+    default:
+      text = std::to_string(value);
+      if (text.size() < static_cast<size_t>(length))
+        text.insert(0, static_cast<size_t>(length) - text.size(), ' ');
+      break;
+  }
+
+  return std::string(static_cast<size_t>(pad_left), ' ') + text +
+         std::string(static_cast<size_t>(pad_right), ' ');
+}
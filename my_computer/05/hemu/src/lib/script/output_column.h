@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace hemu {
+
+// One column of an output-list, e.g. "RAM[0]%D2.6.2": the variable, its
+// format (B binary, D decimal, S string, X hexadecimal) and the padding
+// left of, width of and padding right of the value.
+struct OutputColumn {
+  std::string name;
+  char format {'B'};
+  int pad_left {1};
+  int length {16};
+  int pad_right {1};
+
+  // Throws std::invalid_argument on a malformed specification
+  static OutputColumn parse(std::string_view spec);
+
+  // The name, truncated and centered in the width of the column
+  std::string header() const;
+
+  std::string format_value(int64_t value) const;
+};
+
+}  // namespace hemu
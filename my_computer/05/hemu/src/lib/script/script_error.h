@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+namespace hemu {
+
+// Invalid or unsupported test script.  The message includes the line.
+class ScriptError : public std::runtime_error {
+public:
+  ScriptError(const std::string& s, int line_number)
+      : std::runtime_error(s + " (line " + std::to_string(line_number) + ")"),
+        line(line_number)
+  {
+  }
+
+  const int line;
+};
+
+}  // namespace hemu
@@ -0,0 +1,492 @@
+#include "test_script.h"
+
+#include "emulator/program.h"
+#include "script/script_error.h"
+
+#include <charconv>
+#include <iostream>
+#include <stdexcept>
+
+using namespace hemu;
+
+namespace {
+
+bool is_space(char c)
+{
+  return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+// Characters that end a command or open and close a repeat body
+bool is_delimiter(char c)
+{
+  return (c == ',') || (c == ';') || (c == '!') || (c == '{') || (c == '}');
+}
+
+// A value of a set command: decimal, or %B, %D or %X followed by digits
+int64_t parse_value(std::string_view text, int line)
+{
+  int base = 10;
+
+  if ((text.size() > 2) && (text[0] == '%'))
+  {
+    switch (text[1])
+    {
+      case 'B': base = 2; break;
+      case 'D': base = 10; break;
+      case 'X': base = 16; break;
+      default:
+        throw ScriptError("Invalid value '" + std::string(text) + "'", line);
+    }
+
+    text.remove_prefix(2);
+  }
+
+  bool negative = !text.empty() && (text[0] == '-');
+
+  if (negative)
+    text.remove_prefix(1);
+
+  int64_t value = 0;
+  auto [end, ec] =
+      std::from_chars(text.data(), text.data() + text.size(), value, base);
+
+  if ((ec != std::errc()) || (end != text.data() + text.size()))
+    throw ScriptError("Invalid value '" + std::string(text) + "'", line);
+
+  // Binary and hexadecimal give the 16 bits of the word
+  if (base != 10)
+    value = static_cast<int16_t>(value);
+
+  return negative ? -value : value;
+}
+
+// The n of "RAM[n]" when `variable` names an element of `memory`
+bool parse_index(const std::string& variable, std::string_view memory,
+                 uint16_t& index)
+{
+  if ((variable.size() < memory.size() + 3) ||
+      (variable.compare(0, memory.size(), memory) != 0) ||
+      (variable[memory.size()] != '[') || (variable.back() != ']'))
+    return false;
+
+  const char* first = variable.data() + memory.size() + 1;
+  const char* last = variable.data() + variable.size() - 1;
+  unsigned value = 0;
+  auto [end, ec] = std::from_chars(first, last, value);
+
+  if ((ec != std::errc()) || (end != last) || (value > 0x7fff))
+    return false;
+
+  index = static_cast<uint16_t>(value);
+  return true;
+}
+
+std::vector<std::string> read_lines(const std::filesystem::path& path)
+{
+  std::ifstream file(path);
+
+  if (!file)
+    throw std::runtime_error("Unable to open " + path.string());
+
+  std::vector<std::string> lines;
+  std::string line;
+
+  while (std::getline(file, line))
+  {
+    if (!line.empty() && (line.back() == '\r'))
+      line.pop_back();
+
+    lines.push_back(std::move(line));
+  }
+
+  return lines;
+}
+
+// The .cmp files mark values that may be anything with '*'
+bool matches(const std::string& output, const std::string& expected)
+{
+  if (output.size() != expected.size())
+    return false;
+
+  for (size_t i = 0; i < output.size(); i++)
+  {
+    if ((expected[i] != '*') && (expected[i] != output[i]))
+      return false;
+  }
+
+  return true;
+}
+
+}  // namespace
+
+TestScript::TestScript(std::string_view text, std::filesystem::path directory)
+    : commands(parse(text)),
+      script_directory(directory),
+      output_directory(std::move(directory))
+{
+}
+
+void TestScript::set_output_directory(std::filesystem::path directory)
+{
+  output_directory = std::move(directory);
+}
+
+// Commands are lists of words ended by ',', ';' or '!'.  A repeat has its
+// count in its words and its commands in `body`.
+std::vector<TestScript::Command> TestScript::parse(std::string_view text)
+{
+  std::vector<std::vector<Command>> open_bodies(1);
+  Command command {{}, {}, 1};
+  int line = 1;
+  size_t i = 0;
+
+  auto end_command = [&]() {
+    if (!command.words.empty())
+      open_bodies.back().push_back(std::move(command));
+
+    command = Command {{}, {}, line};
+  };
+
+  while (i < text.size())
+  {
+    char c = text[i];
+
+    if (c == '\n')
+    {
+      line++;
+      i++;
+    }
+    else if (is_space(c))
+    {
+      i++;
+    }
+    else if (text.substr(i, 2) == "//")
+    {
+      i = text.find('\n', i);
+      if (i == std::string_view::npos)
+        i = text.size();
+    }
+    else if (text.substr(i, 2) == "/*")
+    {
+      size_t end = text.find("*/", i + 2);
+
+      if (end == std::string_view::npos)
+        throw ScriptError("Unterminated comment", line);
+
+      for (; i < end; i++)
+      {
+        if (text[i] == '\n')
+          line++;
+      }
+
+      i = end + 2;
+    }
+    else if (c == '{')
+    {
+      if (command.words.empty() || (command.words[0] != "repeat"))
+        throw ScriptError("'{' without repeat", line);
+
+      open_bodies.push_back({});
+      open_bodies[open_bodies.size() - 2].push_back(std::move(command));
+      command = Command {{}, {}, line};
+      i++;
+    }
+    else if (c == '}')
+    {
+      end_command();
+
+      if (open_bodies.size() == 1)
+        throw ScriptError("'}' without repeat", line);
+
+      auto body = std::move(open_bodies.back());
+      open_bodies.pop_back();
+      open_bodies.back().back().body = std::move(body);
+      i++;
+    }
+    else if (is_delimiter(c))
+    {
+      end_command();
+      i++;
+    }
+    else if (c == '"')
+    {
+      size_t end = text.find('"', i + 1);
+
+      if (end == std::string_view::npos)
+        throw ScriptError("Unterminated string", line);
+
+      if (command.words.empty())
+        command.line = line;
+
+      command.words.emplace_back(text.substr(i + 1, end - i - 1));
+      i = end + 1;
+    }
+    else
+    {
+      size_t start = i;
+
+      while ((i < text.size()) && !is_space(text[i]) && !is_delimiter(text[i]))
+        i++;
+
+      if (command.words.empty())
+        command.line = line;
+
+      command.words.emplace_back(text.substr(start, i - start));
+    }
+  }
+
+  end_command();
+
+  if (open_bodies.size() != 1)
+    throw ScriptError("Missing '}'", line);
+
+  return std::move(open_bodies[0]);
+}
+
+bool TestScript::run()
+{
+  bool passed = execute(commands);
+
+  if (output_file.is_open())
+    output_file.flush();
+
+  return passed;
+}
+
+bool TestScript::execute(const std::vector<Command>& list)
+{
+  for (const auto& command : list)
+  {
+    if (!execute(command))
+      return false;
+  }
+
+  return true;
+}
+
+int64_t TestScript::clock_cycles(const std::vector<Command>& list)
+{
+  int64_t cycles = 0;
+
+  for (const auto& command : list)
+  {
+    const std::string& name = command.words[0];
+
+    if ((name == "ticktock") || (name == "tick"))
+      cycles++;
+    else if (name != "tock")
+      return -1;
+  }
+
+  return cycles;
+}
+
+bool TestScript::execute(const Command& command)
+{
+  const auto& words = command.words;
+  const std::string& name = words[0];
+  int line = command.line;
+
+  auto require_arguments = [&](size_t count) {
+    if (words.size() != count + 1)
+      throw ScriptError("Expected " + std::to_string(count) +
+                            " argument(s) for " + name,
+                        line);
+  };
+
+  if (name == "load")
+  {
+    if (words.size() == 1)
+      throw ScriptError("load of a directory needs the VM emulator", line);
+
+    require_arguments(1);
+
+    if (!words[1].ends_with(".hack") && !words[1].ends_with(".asm"))
+      throw ScriptError("Only .hack and .asm programs can be loaded", line);
+
+    auto path = script_directory / words[1];
+
+    // The course scripts load X.hack; assemble X.asm when it is missing
+    if (!std::filesystem::exists(path) && words[1].ends_with(".hack"))
+    {
+      auto source = path;
+      source.replace_extension(".asm");
+
+      if (std::filesystem::exists(source))
+        path = source;
+    }
+
+    computer.load(load_program(path.string()));
+  }
+  else if (name == "output-file")
+  {
+    require_arguments(1);
+    output_file.open(output_directory / words[1]);
+
+    if (!output_file)
+      throw ScriptError("Unable to create " + words[1], line);
+  }
+  else if (name == "compare-to")
+  {
+    require_arguments(1);
+    compare_lines = read_lines(script_directory / words[1]);
+    comparing = true;
+  }
+  else if (name == "output-list")
+  {
+    output_list.clear();
+
+    for (size_t i = 1; i < words.size(); i++)
+    {
+      try
+      {
+        output_list.push_back(OutputColumn::parse(words[i]));
+      }
+      catch (const std::invalid_argument& e)
+      {
+        throw ScriptError(e.what(), line);
+      }
+
+      // Check the variable now rather than at the first output
+      get(output_list.back().name, line);
+    }
+
+    std::string header = "|";
+
+    for (const auto& column : output_list)
+    {
+      header += column.header() + "|";
+    }
+
+    return output_line(header);
+  }
+  else if (name == "output")
+  {
+    std::string text = "|";
+
+    for (const auto& column : output_list)
+    {
+      text += column.format_value(get(column.name, line)) + "|";
+    }
+
+    return output_line(text);
+  }
+  else if (name == "set")
+  {
+    require_arguments(2);
+    set(words[1], parse_value(words[2], line), line);
+  }
+  else if ((name == "ticktock") || (name == "tick"))
+  {
+    computer.run(1);
+  }
+  else if (name == "tock")
+  {
+  }
+  else if (name == "echo")
+  {
+    require_arguments(1);
+    std::cout << words[1] << std::endl;
+  }
+  else if (name == "clear-echo")
+  {
+  }
+  else if (name == "repeat")
+  {
+    int64_t count = 0;
+
+    if (words.size() == 2)
+      count = parse_value(words[1], line);
+
+    if (count <= 0)
+      throw ScriptError("repeat needs a positive count", line);
+
+    if (int64_t cycles = clock_cycles(command.body); cycles >= 0)
+    {
+      computer.run(static_cast<uint64_t>(count * cycles));
+      return true;
+    }
+
+    for (int64_t i = 0; i < count; i++)
+    {
+      if (!execute(command.body))
+        return false;
+    }
+  }
+  else
+  {
+    throw ScriptError("Unsupported command '" + name + "'", line);
+  }
+
+  return true;
+}
+
+// Write a line of output and compare it with the next line of the
+// compare-to file
+bool TestScript::output_line(const std::string& text)
+{
+  if (output_file.is_open())
+    output_file << text << '\n';
+
+  output_lines++;
+
+  if (!comparing)
+    return true;
+
+  if ((output_lines > compare_lines.size()) ||
+      !matches(text, compare_lines[output_lines - 1]))
+  {
+    failure_line = static_cast<int>(output_lines);
+    return false;
+  }
+
+  return true;
+}
+
+int64_t TestScript::get(const std::string& variable, int line)
+{
+  uint16_t index;
+
+  if (parse_index(variable, "RAM", index))
+    return computer.ram(index);
+
+  if (parse_index(variable, "ROM", index))
+    return static_cast<int16_t>(computer.rom(index));
+
+  if (variable == "A")
+    return computer.a;
+
+  if (variable == "D")
+    return computer.d;
+
+  if (variable == "PC")
+    return computer.pc;
+
+  if (variable == "time")
+    return static_cast<int64_t>(computer.time);
+
+  throw ScriptError("Unknown variable '" + variable + "'", line);
+}
+
+void TestScript::set(const std::string& variable, int64_t value, int line)
+{
+  uint16_t index;
+
+  if ((value < -32768) || (value > 65535))
+    throw ScriptError("Value out of range for " + variable, line);
+
+  auto word = static_cast<int16_t>(value);
+
+  if (parse_index(variable, "RAM", index))
+    computer.set_ram(index, word);
+  else if (parse_index(variable, "ROM", index))
+    computer.set_rom(index, static_cast<uint16_t>(word));
+  else if (variable == "A")
+    computer.a = word;
+  else if (variable == "D")
+    computer.d = word;
+  else if (variable == "PC")
+    computer.pc = static_cast<uint16_t>(word) & 0x7fff;
+  else
+    throw ScriptError("Unknown variable '" + variable + "'", line);
+}
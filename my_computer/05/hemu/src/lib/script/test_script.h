@@ -0,0 +1,82 @@
+#pragma once
+
+#include "emulator/cpu.h"
+#include "script/output_column.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hemu {
+
+// A CPU emulator test script (.tst) run without the GUI.
+//
+// Supported commands are load, output-file, compare-to, output-list, set,
+// output, echo, clear-echo, ticktock, tick, tock and repeat.  tick
+// executes an instruction and tock completes the cycle.  Variables are A,
+// D, PC, time, RAM[n] and ROM[n].
+//
+// A repeat whose body only advances the clock is executed as a single
+// Cpu::run(), so "repeat 1000000 { ticktock; }" costs no more than the
+// instructions themselves.
+class TestScript {
+public:
+  // Files named by the script are relative to `directory`
+  TestScript(std::string_view text, std::filesystem::path directory);
+
+  TestScript(const TestScript&) = delete;
+  TestScript& operator=(const TestScript&) = delete;
+
+  // Where the output-file is written, by default `directory`
+  void set_output_directory(std::filesystem::path);
+
+  // Runs the script to the end or to the first output line that differs
+  // from the compare-to file.  Returns false on a difference.  Throws
+  // ScriptError for a script that cannot run and std::runtime_error for
+  // a program that cannot be loaded.
+  bool run();
+
+  // Line of the compare-to file that differed
+  int failed_line() const { return failure_line; }
+
+  Cpu& cpu() { return computer; }
+
+private:
+  struct Command {
+    std::vector<std::string> words;
+    std::vector<Command> body;  // of a repeat
+    int line;
+  };
+
+  static std::vector<Command> parse(std::string_view text);
+
+  bool execute(const std::vector<Command>& commands);
+  bool execute(const Command& command);
+  bool output_line(const std::string& text);
+
+  // Cycles one pass of `commands` takes, or -1 if it does more than
+  // advance the clock
+  static int64_t clock_cycles(const std::vector<Command>& commands);
+
+  int64_t get(const std::string& variable, int line);
+  void set(const std::string& variable, int64_t value, int line);
+
+  std::vector<Command> commands;
+  std::filesystem::path script_directory;
+  std::filesystem::path output_directory;
+
+  Cpu computer;
+
+  std::ofstream output_file;
+  std::vector<OutputColumn> output_list;
+
+  std::vector<std::string> compare_lines;
+  bool comparing {false};
+  size_t output_lines {0};
+  int failure_line {0};
+};
+
+}  // namespace hemu
@@ -0,0 +1,13 @@
+#include "hemu.h"
+
+int main(int argc, const char* argv[])
+{
+  // check for funny business
+  if ((argc == 0) || (argv == nullptr) || (argv[0] == nullptr))
+  {
+    // no error for you
+    return 0;
+  }
+
+  return hemu_main(argc, argv);
+}
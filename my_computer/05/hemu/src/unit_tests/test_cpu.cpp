@@ -0,0 +1,158 @@
+#include "assembler/assembler.h"
+#include "emulator/cpu.h"
+#include "emulator/program.h"
+#include "catch.hpp"
+
+using namespace hemu;
+
+namespace {
+
+void load_source(Cpu& cpu, std::string_view source)
+{
+  hasm::Assembler assembler(source);
+  cpu.load(assembler.assemble());
+}
+
+}  // namespace
+
+SCENARIO("Instructions")
+{
+  Cpu cpu;
+
+  SECTION("A-instruction")
+  {
+    load_source(cpu, "@12345");
+    REQUIRE(cpu.run(1) == 1);
+    REQUIRE(cpu.a == 12345);
+    REQUIRE(cpu.pc == 1);
+    REQUIRE(cpu.time == 1);
+  }
+
+  SECTION("Computations and destinations")
+  {
+    load_source(cpu,
+                "@100\n"
+                "D=A\n"     // D = 100
+                "@7\n"
+                "M=D-A\n"   // RAM[7] = 93
+                "AM=M+1\n"  // RAM[7] = 94, A = 94
+                "D=-D\n"    // D = -100
+                "MD=D|A\n");  // RAM[94] = D = -100 | 94
+    cpu.run(7);
+
+    REQUIRE(cpu.ram(7) == 94);
+    REQUIRE(cpu.a == 94);
+    REQUIRE(cpu.d == (-100 | 94));
+    REQUIRE(cpu.ram(94) == (-100 | 94));
+  }
+
+  SECTION("Undocumented computations use the ALU")
+  {
+    // zx nx zy ny f no = 1 1 0 0 1 0: !0 + A = A - 1
+    cpu.load({5, 0b1110110010010000});
+    cpu.run(2);
+    REQUIRE(cpu.d == 4);
+
+    // zx = 1, f = 0: 0 & D
+    cpu.load({5, 0b1111100000010000});
+    cpu.d = 3;
+    cpu.run(2);
+    REQUIRE(cpu.d == 0);
+  }
+
+  SECTION("Arithmetic wraps at 16 bits")
+  {
+    load_source(cpu, "@32767\nD=A+1\n");
+    cpu.run(2);
+    REQUIRE(cpu.d == -32768);
+  }
+}
+
+SCENARIO("Jumps")
+{
+  Cpu cpu;
+
+  auto jumps = [&](std::string_view jump, int d) {
+    load_source(cpu, "@10\n" + std::string("D;") + std::string(jump));
+    cpu.d = static_cast<int16_t>(d);
+    cpu.run(2);
+    return cpu.pc == 10;
+  };
+
+  REQUIRE(jumps("JGT", 1));
+  REQUIRE_FALSE(jumps("JGT", 0));
+  REQUIRE(jumps("JEQ", 0));
+  REQUIRE_FALSE(jumps("JEQ", -1));
+  REQUIRE(jumps("JGE", 0));
+  REQUIRE(jumps("JLT", -1));
+  REQUIRE_FALSE(jumps("JLT", 1));
+  REQUIRE(jumps("JNE", -1));
+  REQUIRE_FALSE(jumps("JNE", 0));
+  REQUIRE(jumps("JLE", 0));
+  REQUIRE_FALSE(jumps("JLE", 1));
+  REQUIRE(jumps("JMP", 0));
+
+  SECTION("The target is A before the instruction")
+  {
+    load_source(cpu, "@20\nA=A+1;JMP\n");
+    cpu.run(2);
+    REQUIRE(cpu.pc == 20);
+    REQUIRE(cpu.a == 21);
+  }
+}
+
+SCENARIO("Halt loop")
+{
+  Cpu cpu;
+  load_source(cpu,
+              "@5\n"
+              "D=A\n"
+              "@0\n"
+              "M=D\n"
+              "(END)\n"
+              "@END\n"
+              "0;JMP\n");
+
+  SECTION("Stops at the loop")
+  {
+    REQUIRE(cpu.run(1000, true) == 4);
+    REQUIRE(cpu.halted());
+    REQUIRE(cpu.ram(0) == 5);
+  }
+
+  SECTION("Runs every cycle of the loop")
+  {
+    REQUIRE(cpu.run(1001) == 1001);
+    REQUIRE(cpu.time == 1001);
+    REQUIRE(cpu.pc == 5);
+    REQUIRE(cpu.run(1) == 1);
+    REQUIRE(cpu.pc == 4);
+    REQUIRE(cpu.a == 4);
+  }
+
+  SECTION("Changing the ROM removes the loop")
+  {
+    cpu.set_rom(5, 0b1110111111001000);  // M=1
+    REQUIRE(cpu.run(6, true) == 6);
+    REQUIRE(cpu.ram(4) == 1);
+  }
+}
+
+SCENARIO("Reset")
+{
+  Cpu cpu;
+  load_source(cpu, "@3\nD=A\n");
+  cpu.run(2);
+  cpu.reset();
+
+  REQUIRE(cpu.pc == 0);
+  REQUIRE(cpu.d == 3);
+}
+
+SCENARIO("Hack files")
+{
+  REQUIRE(parse_hack("0000000000000010\r\n1110110000010000\n") ==
+          std::vector<uint16_t> {2, 0b1110110000010000});
+  REQUIRE_THROWS(parse_hack("000000000000001\n"));
+  REQUIRE_THROWS(parse_hack("000000000000002X\n"));
+}
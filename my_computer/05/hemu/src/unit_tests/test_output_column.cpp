@@ -0,0 +1,54 @@
+#include "script/output_column.h"
+#include "catch.hpp"
+
+#include <stdexcept>
+
+using namespace hemu;
+
+SCENARIO("Output columns")
+{
+  SECTION("Decimal")
+  {
+    auto column = OutputColumn::parse("RAM[0]%D2.6.2");
+
+    REQUIRE(column.name == "RAM[0]");
+    REQUIRE(column.header() == "  RAM[0]  ");
+    REQUIRE(column.format_value(266) == "     266  ");
+    REQUIRE(column.format_value(-1) == "      -1  ");
+  }
+
+  SECTION("Long names are truncated")
+  {
+    auto column = OutputColumn::parse("ARegister[0]%D1.7.1");
+    REQUIRE(column.header() == "ARegister");
+  }
+
+  SECTION("Binary and hexadecimal show the low digits")
+  {
+    auto binary = OutputColumn::parse("reset%B2.1.2");
+    REQUIRE(binary.header() == "reset");
+    REQUIRE(binary.format_value(1) == "  1  ");
+
+    REQUIRE(OutputColumn::parse("x%B0.16.0").format_value(-2) ==
+            "1111111111111110");
+    REQUIRE(OutputColumn::parse("x%X1.4.1").format_value(0x7abc) ==
+            " 7ABC ");
+  }
+
+  SECTION("Strings are left aligned")
+  {
+    auto column = OutputColumn::parse("time%S1.4.1");
+    REQUIRE(column.header() == " time ");
+    REQUIRE(column.format_value(3) == " 3    ");
+  }
+
+  SECTION("Invalid")
+  {
+    REQUIRE_THROWS_AS(OutputColumn::parse("RAM[0]%Q1.2.3"),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(OutputColumn::parse("RAM[0]%D1.2"),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(OutputColumn::parse("RAM[0]%D1.x.1"),
+                      std::invalid_argument);
+  }
+}
@@ -0,0 +1,353 @@
+#include "assembler/assembler.h"
+#include "profile/profiler.h"
+#include "profile/source_map.h"
+#include "catch.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace hemu;
+
+namespace {
+
+// The comments and labels vmt writes, around code that is not a real
+// translation
+constexpr const char* TRANSLATION =
+    "// Bootstrap code to Sys.init function\n"
+    "@RET\n"              // 0: RAM[256] = return address
+    "D=A\n"
+    "@256\n"
+    "M=D\n"
+    "@261\n"              // 4: LCL = 261
+    "D=A\n"
+    "@LCL\n"
+    "M=D\n"
+    "@Main.f\n"           // 8: call Main.f
+    "0;JMP\n"
+    "(RET)\n"
+    "@RET\n"              // 10: halt
+    "0;JMP\n"
+    "// File: Main.vm\n"
+    "// 1: function Main.f (0 nargs)\n"
+    "(Main.f)\n"
+    "// 3: push constant 7\n"
+    "@7\n"                // 12
+    "D=A  // trailing comment\n"
+    "// 4-6: array load\n"
+    "@R5\n"               // 14
+    "M=D\n"
+    "// 7: return\n"
+    "@1000\n"             // 16: restore LCL and return
+    "D=A\n"
+    "@LCL\n"
+    "M=D\n"
+    "@256\n"
+    "A=M\n"
+    "0;JMP\n"
+    "($$RETURN)\n"
+    "@R14\n";             // 23
+
+// The FILE.map vmt -m writes for TRANSLATION, with the .vm file of
+// VmDirectory
+constexpr const char* TRANSLATION_MAP =
+    "0\t11\t-\n"
+    "12\t13\tMain.f\tMain.vm:3\tMain.jack:9\n"
+    "14\t15\tMain.f\tMain.vm:4\tMain.jack:9\n"
+    "16\t22\tMain.f\tMain.vm:7\n"
+    "23\t23\t$$RETURN\n";
+
+// The code vmt writes for a push of D
+std::string push_d()
+{
+  return "@SP\nAM=M+1\nA=A-1\nM=D\n";
+}
+
+// The code vmt writes for `call function nargs` at VM line `line`
+std::string call(const std::string& function, int nargs,
+                 const std::string& return_label, int line)
+{
+  std::string code = "// " + std::to_string(line) + ": call " + function +
+                     " (" + std::to_string(nargs) + " nargs)\n";
+
+  code += "@" + return_label + "\nD=A\n" + push_d();
+
+  for (const char* pointer : {"LCL", "ARG", "THIS", "THAT"})
+    code += std::string("@") + pointer + "\nD=M\n" + push_d();
+
+  code += "@SP\nD=M\n@LCL\nM=D\n@" + std::to_string(5 + nargs) +
+          "\nD=D-A\n@ARG\nM=D\n";
+
+  return code + "@" + function + "\n0;JMP\n(" + return_label + ")\n";
+}
+
+// The code vmt writes for `return` at VM line `line`
+std::string return_from(int line)
+{
+  std::string code = "// " + std::to_string(line) + ": return\n";
+
+  code += "@LCL\nD=M\n@R13\nM=D\n@5\nA=D-A\nD=M\n@R14\nM=D\n";
+  code += "@SP\nAM=M-1\nD=M\n@ARG\nA=M\nM=D\n";
+  code += "@ARG\nD=M+1\n@SP\nM=D\n";
+
+  for (const char* pointer : {"THAT", "THIS", "ARG", "LCL"})
+    code += std::string("@R13\nAM=M-1\nD=M\n@") + pointer + "\nM=D\n";
+
+  return code + "@R14\nA=M\n0;JMP\n";
+}
+
+// Sys.init calls Main.count(3), which calls itself down to 0.  As vmt
+// orders files by name, Main.count begins where the bootstrap's call of
+// Sys.init returns to.
+std::string recursive_translation()
+{
+  return "// Bootstrap code to Sys.init function\n"
+         "@256\nD=A\n@SP\nM=D\n" +
+         call("Sys.init", 0, "$bootstrap$ret.0", 0) +
+         "// File: Main.vm\n"
+         "// 1: function Main.count (0 nargs)\n"
+         "(Main.count)\n"
+         "// 2: push argument 0\n"
+         "@ARG\nA=M\nD=M\n" + push_d() +
+         "// 3: if-goto RECURSE\n"
+         "@SP\nAM=M-1\nD=M\n@Main.count$RECURSE\nD;JNE\n"
+         "// 4: push constant 0\n"
+         "@0\nD=A\n" + push_d() +
+         return_from(5) +
+         "// 6: label RECURSE\n"
+         "(Main.count$RECURSE)\n"
+         "// 7-9: argument 0 - 1\n"
+         "@ARG\nA=M\nD=M-1\n" + push_d() +
+         call("Main.count", 1, "Main.count$ret.0", 10) +
+         return_from(11) +
+         "// File: Sys.vm\n"
+         "// 1: function Sys.init (0 nargs)\n"
+         "(Sys.init)\n"
+         "// 2: push constant 3\n"
+         "@3\nD=A\n" + push_d() +
+         call("Main.count", 1, "Sys.init$ret.0", 3) +
+         "// 4: pop temp 0\n"
+         "@SP\nAM=M-1\nD=M\n@R5\nM=D\n"
+         "// 5: label WHILE\n"
+         "(Sys.init$WHILE)\n"
+         "// 6: goto WHILE\n"
+         "@Sys.init$WHILE\n0;JMP\n";
+}
+
+// Cycles of the report line ending in `row`
+uint64_t report_cycles(const std::string& report, const std::string& row)
+{
+  size_t end = report.find(row + "\n");
+  REQUIRE(end != std::string::npos);
+
+  size_t start = report.rfind('\n', end) + 1;
+
+  return std::stoull(report.substr(start, end - start));
+}
+
+// A directory of its own holding the .vm file of TRANSLATION
+class VmDirectory {
+public:
+  VmDirectory()
+      : path(std::filesystem::temp_directory_path() / "testhemu_profile")
+  {
+    std::filesystem::create_directories(path);
+    std::ofstream(path / "Main.vm") << "function Main.f 0\n"
+                                       "// line 9\n"
+                                       "push constant 7\n"
+                                       "pop temp 0\n";
+  }
+
+  ~VmDirectory() { std::filesystem::remove_all(path); }
+
+  std::filesystem::path path;
+};
+
+}  // namespace
+
+SCENARIO("Source map")
+{
+  VmDirectory directory;
+  SourceMap source(TRANSLATION, directory.path);
+
+  SECTION("Code outside of the files is the bootstrap")
+  {
+    REQUIRE(source.function_name(source.at(0).function) == "(bootstrap)");
+    REQUIRE(source.at(11).file == -1);
+  }
+
+  SECTION("Function entries")
+  {
+    int function = source.function_at_entry(12);
+
+    REQUIRE(function >= 0);
+    REQUIRE(source.function_name(function) == "Main.f");
+    REQUIRE(source.function_at_entry(13) == -1);
+    REQUIRE(source.function_at_entry(0) == -1);
+  }
+
+  SECTION("VM lines")
+  {
+    REQUIRE(source.file_name(source.at(12).file) == "Main.vm");
+    REQUIRE(source.at(12).vm_line == 3);
+    REQUIRE(source.at(13).vm_line == 3);
+    REQUIRE(source.at(14).vm_line == 4);
+    REQUIRE(source.at(16).vm_line == 7);
+  }
+
+  SECTION("Jack lines from the .vm file")
+  {
+    REQUIRE(source.has_jack_lines());
+    REQUIRE(source.at(12).jack_line == 9);
+    REQUIRE(source.at(16).jack_line == 0);
+  }
+
+  SECTION("Shared routines")
+  {
+    REQUIRE(source.function_name(source.at(23).function) == "$$RETURN");
+    REQUIRE(source.at(23).file == -1);
+  }
+
+  SECTION("Addresses beyond the program")
+  {
+    REQUIRE(source.at(24).function == -1);
+    REQUIRE(source.at(24).vm_line == 0);
+  }
+}
+
+SCENARIO("Source map of vmt -m")
+{
+  VmDirectory directory;
+  SourceMap comments(TRANSLATION, directory.path);
+  SourceMap map = SourceMap::parse_map(TRANSLATION_MAP);
+
+  SECTION("Agrees with the comments of the .asm")
+  {
+    REQUIRE(map.has_jack_lines() == comments.has_jack_lines());
+
+    for (uint16_t address = 0; address <= 24; address++)
+    {
+      const SourceLocation& expected = comments.at(address);
+      const SourceLocation& location = map.at(address);
+
+      INFO("address " << address);
+      REQUIRE(map.function_name(location.function) ==
+              comments.function_name(expected.function));
+      REQUIRE(map.file_name(location.file) ==
+              comments.file_name(expected.file));
+      REQUIRE(location.vm_line == expected.vm_line);
+      REQUIRE(location.jack_line == expected.jack_line);
+      REQUIRE(map.function_name(map.function_at_entry(address)) ==
+              comments.function_name(comments.function_at_entry(address)));
+    }
+  }
+
+  SECTION("Gives the same profile")
+  {
+    std::stringstream reports[2];
+    const SourceMap* sources[] = {&comments, &map};
+
+    for (int i = 0; i < 2; i++)
+    {
+      Cpu cpu;
+      hasm::Assembler assembler(TRANSLATION);
+
+      cpu.load(assembler.assemble());
+
+      Profiler profiler(cpu, *sources[i]);
+
+      profiler.run(1000);
+      profiler.report(reports[i], 10);
+    }
+
+    REQUIRE(reports[1].str() == reports[0].str());
+  }
+
+  SECTION("Code of no function is named after its file")
+  {
+    SourceMap stage1 = SourceMap::parse_map("0\t3\t-\tMain.vm:1\n");
+
+    REQUIRE(stage1.function_name(stage1.at(3).function) == "Main.vm");
+    REQUIRE(stage1.function_at_entry(0) == -1);
+  }
+
+  SECTION("Malformed lines")
+  {
+    REQUIRE_THROWS_AS(SourceMap::parse_map("0\t3\n"), std::invalid_argument);
+    REQUIRE_THROWS_AS(SourceMap::parse_map("3\t0\t-\n"),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(SourceMap::parse_map("0\t3\tMain.f\tMain.vm\n"),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(SourceMap::parse_map("0\t3\t-\n2\t4\t-\n"),
+                      std::invalid_argument);
+  }
+}
+
+SCENARIO("Profiler")
+{
+  VmDirectory directory;
+  SourceMap source(TRANSLATION, directory.path);
+  Cpu cpu;
+  hasm::Assembler assembler(TRANSLATION);
+
+  cpu.load(assembler.assemble());
+
+  Profiler profiler(cpu, source);
+
+  // 10 instructions of bootstrap, 11 of Main.f
+  REQUIRE(profiler.run(1000) == 21);
+  REQUIRE(cpu.halted());
+
+  std::stringstream report;
+  profiler.report(report, 10);
+
+  const std::string text = report.str();
+
+  REQUIRE(text.find("Flat profile: 21 cycles") != std::string::npos);
+  REQUIRE(text.find("          11   52.4%  Main.f\n") != std::string::npos);
+  REQUIRE(text.find("           2    9.5%  Main.vm:3\n") != std::string::npos);
+  REQUIRE(text.find("           4   19.0%  Main.jack:9\n") !=
+          std::string::npos);
+  REQUIRE(text.find("          11   52.4%  Main.f (1)\n") != std::string::npos);
+  REQUIRE(text.find("(bootstrap) -> Main.f (1)") != std::string::npos);
+}
+
+SCENARIO("Profiler of recursive calls")
+{
+  const std::string translation = recursive_translation();
+  SourceMap source(translation, std::filesystem::temp_directory_path());
+  Cpu cpu;
+  hasm::Assembler assembler(translation);
+
+  cpu.load(assembler.assemble());
+
+  Profiler profiler(cpu, source);
+  profiler.run(100000);
+
+  REQUIRE(cpu.halted());
+
+  std::stringstream report;
+  profiler.report(report, 10);
+
+  const std::string text = report.str();
+
+  SECTION("A call of the function after the bootstrap is not its return")
+  {
+    REQUIRE(text.find("(bootstrap) -> Sys.init (1)") != std::string::npos);
+    REQUIRE(text.find("Sys.init -> Main.count (1)") != std::string::npos);
+    REQUIRE(text.find("(bootstrap) -> Main.count") == std::string::npos);
+    REQUIRE(report_cycles(text, "Sys.init (1)") >
+            report_cycles(text, "Main.count (4)"));
+  }
+
+  SECTION("Nested frames of one edge are counted once")
+  {
+    uint64_t count = report_cycles(text, "Main.count (4)");
+    uint64_t outer = report_cycles(text, "Sys.init -> Main.count (1)");
+    uint64_t inner = report_cycles(text, "Main.count -> Main.count (3)");
+
+    REQUIRE(outer == count);
+    REQUIRE(inner < outer);
+  }
+}
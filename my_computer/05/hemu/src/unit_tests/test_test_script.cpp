@@ -0,0 +1,103 @@
+#include "script/script_error.h"
+#include "script/test_script.h"
+#include "catch.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace hemu;
+
+namespace {
+
+// A directory of its own holding a program and its compare file
+class ScriptDirectory {
+public:
+  ScriptDirectory()
+      : path(std::filesystem::temp_directory_path() / "testhemu_script")
+  {
+    std::filesystem::create_directories(path);
+
+    // RAM[2] = RAM[0] + RAM[1]
+    write("Add.asm",
+          "@0\nD=M\n@1\nD=D+M\n@2\nM=D\n(END)\n@END\n0;JMP\n");
+  }
+
+  ~ScriptDirectory() { std::filesystem::remove_all(path); }
+
+  void write(const std::string& name, const std::string& text)
+  {
+    std::ofstream(path / name) << text;
+  }
+
+  std::filesystem::path path;
+};
+
+}  // namespace
+
+SCENARIO("Test scripts")
+{
+  ScriptDirectory directory;
+
+  const char* script =
+      "load Add.hack,\n"  // assembled from Add.asm
+      "output-file Add.out,\n"
+      "compare-to Add.cmp,\n"
+      "output-list RAM[0]%D2.6.2 RAM[2]%D2.6.2;\n"
+      "/* the operands */\n"
+      "set RAM[0] 2, set RAM[1] %X0003;\n"
+      "repeat 10 { ticktock; }\n"
+      "output;\n"
+      "set PC 0, set RAM[1] -5;\n"
+      "repeat 3 { tick, tock; }  // only part way\n"
+      "output;\n";
+
+  SECTION("Matching output")
+  {
+    directory.write("Add.cmp",
+                    "|  RAM[0]  |  RAM[2]  |\n"
+                    "|       2  |       5  |\r\n"
+                    "|       2  |    ****  |\n");
+
+    TestScript test(script, directory.path);
+
+    REQUIRE(test.run());
+    REQUIRE(test.cpu().time == 13);
+
+    std::ifstream out(directory.path / "Add.out");
+    std::string line;
+    std::getline(out, line);
+    REQUIRE(line == "|  RAM[0]  |  RAM[2]  |");
+  }
+
+  SECTION("Different output")
+  {
+    directory.write("Add.cmp",
+                    "|  RAM[0]  |  RAM[2]  |\n"
+                    "|       2  |       6  |\n");
+
+    TestScript test(script, directory.path);
+
+    REQUIRE_FALSE(test.run());
+    REQUIRE(test.failed_line() == 2);
+  }
+
+  SECTION("Errors")
+  {
+    REQUIRE_THROWS_AS(TestScript("repeat 2 { ticktock;", directory.path),
+                      ScriptError);
+    REQUIRE_THROWS_AS(TestScript("load Computer.hdl;", directory.path).run(),
+                      ScriptError);
+    REQUIRE_THROWS_AS(TestScript("vmstep;", directory.path).run(), ScriptError);
+    REQUIRE_THROWS_AS(TestScript("output-list X%D1.6.1;", directory.path).run(),
+                      ScriptError);
+
+    try
+    {
+      TestScript("load Add.asm,\n\nset RAM[0] x;", directory.path).run();
+    }
+    catch (const ScriptError& e)
+    {
+      REQUIRE(e.line == 3);
+    }
+  }
+}
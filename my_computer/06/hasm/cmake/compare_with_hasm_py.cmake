@@ -0,0 +1,23 @@
+# Assemble PROGRAM with both hasm.py and hasm and fail if the outputs differ
+#
+#   cmake -DPYTHON=... -DHASM_PY=... -DHASM=... -DPROGRAM=... -P compare_with_hasm_py.cmake
+
+execute_process(COMMAND ${PYTHON} ${HASM_PY} ${PROGRAM}
+                OUTPUT_VARIABLE expected
+                RESULT_VARIABLE python_result)
+
+if (NOT python_result EQUAL 0)
+    message(FATAL_ERROR "hasm.py failed on ${PROGRAM}")
+endif()
+
+execute_process(COMMAND ${HASM} ${PROGRAM}
+                OUTPUT_VARIABLE actual
+                RESULT_VARIABLE hasm_result)
+
+if (NOT hasm_result EQUAL 0)
+    message(FATAL_ERROR "hasm failed on ${PROGRAM}")
+endif()
+
+if (NOT actual STREQUAL expected)
+    message(FATAL_ERROR "hasm and hasm.py differ on ${PROGRAM}")
+endif()
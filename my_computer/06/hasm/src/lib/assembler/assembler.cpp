@@ -0,0 +1,206 @@
+#include "assembler.h"
+
+#include "assembler/assembly_error.h"
+#include "assembler/instruction_table.h"
+
+#include <algorithm>
+
+using namespace hasm;
+
+namespace {
+
+bool is_blank(char c) { return (c == ' ') || (c == '\t') || (c == '\r'); }
+
+bool is_digit(char c) { return (c >= '0') && (c <= '9'); }
+
+// Letters, digits, and _.$: not starting with a digit
+bool valid_symbol(std::string_view symbol)
+{
+  if (symbol.empty() || is_digit(symbol[0]))
+    return false;
+
+  return std::all_of(symbol.begin(), symbol.end(), [](char c) {
+    return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) ||
+           is_digit(c) || (c == '_') || (c == '.') || (c == '$') ||
+           (c == ':');
+  });
+}
+
+// Strip the comment and surrounding white space from a line
+std::string_view trim(std::string_view line)
+{
+  auto comment = line.find("//");
+
+  if (comment != std::string_view::npos)
+    line = line.substr(0, comment);
+
+  while (!line.empty() && is_blank(line.front()))
+    line.remove_prefix(1);
+
+  while (!line.empty() && is_blank(line.back()))
+    line.remove_suffix(1);
+
+  return line;
+}
+
+}  // namespace
+
+Assembler::Assembler(std::string_view source_text) : source(source_text) {}
+
+const std::vector<uint16_t>& Assembler::assemble()
+{
+  first_pass();
+  second_pass();
+
+  return code;
+}
+
+void Assembler::first_pass()
+{
+  int line_number = 0;
+  size_t start = 0;
+
+  while (start < source.size())
+  {
+    size_t end = source.find('\n', start);
+
+    if (end == std::string_view::npos)
+      end = source.size();
+
+    std::string_view line = trim(source.substr(start, end - start));
+    start = end + 1;
+    line_number++;
+
+    if (line.empty())
+      continue;
+
+    if (line[0] == '(')
+    {
+      if (line.back() != ')')
+        throw AssemblyError("Malformed label '" + std::string(line) + "'",
+                            line_number);
+
+      std::string_view label = line.substr(1, line.size() - 2);
+
+      if (!valid_symbol(label))
+        throw AssemblyError("Invalid label '" + std::string(label) + "'",
+                            line_number);
+
+      if (!symbol_table.insert(label,
+                               static_cast<uint16_t>(instructions.size())))
+        throw AssemblyError("Duplicate label '" + std::string(label) + "'",
+                            line_number);
+
+      continue;
+    }
+
+    if (instructions.size() == ROM_SIZE)
+      throw AssemblyError("Program exceeds the 32K ROM", line_number);
+
+    // Embedded white space is allowed, as in "D = M"
+    if (std::any_of(line.begin(), line.end(), is_blank))
+    {
+      std::string compact(line);
+      compact.erase(std::remove_if(compact.begin(), compact.end(), is_blank),
+                    compact.end());
+      normalized.push_back(std::move(compact));
+      line = normalized.back();
+    }
+
+    instructions.push_back({line, line_number});
+  }
+}
+
+void Assembler::second_pass()
+{
+  code.clear();
+  code.reserve(instructions.size());
+
+  for (const auto& instruction : instructions)
+  {
+    if (instruction.text[0] == '@')
+      code.push_back(encode_a_instruction(instruction));
+    else
+      code.push_back(encode_c_instruction(instruction));
+  }
+}
+
+uint16_t Assembler::encode_a_instruction(const Instruction& instruction)
+{
+  std::string_view target = instruction.text.substr(1);
+
+  if (!target.empty() && std::all_of(target.begin(), target.end(), is_digit))
+  {
+    unsigned long value = 0;
+
+    for (char c : target)
+    {
+      value = value * 10 + static_cast<unsigned long>(c - '0');
+
+      if (value > 0x7fff)
+        throw AssemblyError("Constant too large '" + std::string(target) + "'",
+                            instruction.line_number);
+    }
+
+    return static_cast<uint16_t>(value);
+  }
+
+  if (auto value = symbol_table.find(target))
+    return *value;
+
+  if (!valid_symbol(target))
+    throw AssemblyError("Invalid symbol '" + std::string(target) + "'",
+                        instruction.line_number);
+
+  // First use of a variable
+  uint16_t address = next_variable++;
+  symbol_table.insert(target, address);
+
+  return address;
+}
+
+uint16_t Assembler::encode_c_instruction(const Instruction& instruction) const
+{
+  std::string_view text = instruction.text;
+  int dest = 0;
+  int jump = 0;
+
+  if (auto semicolon = text.find(';'); semicolon != std::string_view::npos)
+  {
+    jump = lookup_jump(text.substr(semicolon + 1));
+    text = text.substr(0, semicolon);
+  }
+
+  if (auto equals = text.find('='); equals != std::string_view::npos)
+  {
+    dest = lookup_dest(text.substr(0, equals));
+    text = text.substr(equals + 1);
+  }
+
+  int comp = lookup_comp(text);
+
+  if ((comp < 0) || (dest < 0) || (jump < 0))
+    throw AssemblyError("Invalid instruction '" +
+                            std::string(instruction.text) + "'",
+                        instruction.line_number);
+
+  return static_cast<uint16_t>(0xe000 | (comp << 6) | (dest << 3) | jump);
+}
+
+std::string Assembler::to_hack_text(const std::vector<uint16_t>& code)
+{
+  std::string text(code.size() * 17, '\n');
+  char* p = text.data();
+
+  for (uint16_t instruction : code)
+  {
+    for (int bit = 15; bit >= 0; bit--)
+    {
+      *p++ = ((instruction >> bit) & 1) ? '1' : '0';
+    }
+
+    p++;  // over the '\n'
+  }
+
+  return text;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "assembler/symbol_table.h"
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hasm {
+
+// Translates the text of a Hack assembly program into machine code.
+//
+// The first pass records the address of every label and keeps a view of
+// each instruction; the second pass encodes the instructions, allocating
+// variables from RAM[16] in the order they are first used.
+class Assembler {
+public:
+  // `source` must remain valid until assemble() returns
+  explicit Assembler(std::string_view source);
+
+  Assembler(const Assembler&) = delete;
+  Assembler& operator=(const Assembler&) = delete;
+
+  // Runs both passes.  Throws AssemblyError on invalid input.
+  const std::vector<uint16_t>& assemble();
+
+  // Symbols after assemble(): predefined, labels and variables
+  const SymbolTable& symbols() const { return symbol_table; }
+
+  // One line of 16 '0'/'1' characters per instruction, as in a .hack file
+  static std::string to_hack_text(const std::vector<uint16_t>& code);
+
+  static constexpr size_t ROM_SIZE = 32768;
+
+private:
+  struct Instruction {
+    std::string_view text;
+    int line_number;
+  };
+
+  void first_pass();
+  void second_pass();
+
+  uint16_t encode_a_instruction(const Instruction&);
+  uint16_t encode_c_instruction(const Instruction&) const;
+
+  std::string_view source;
+  std::vector<Instruction> instructions;
+
+  // Copies of instructions written with embedded white space, e.g. "D = M"
+  std::deque<std::string> normalized;
+
+  SymbolTable symbol_table;
+  std::vector<uint16_t> code;
+  uint16_t next_variable {16};
+};
+
+}  // namespace hasm
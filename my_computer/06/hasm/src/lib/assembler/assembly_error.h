@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+namespace hasm {
+
+// Invalid assembly input.  The message includes the source line number.
+class AssemblyError : public std::runtime_error {
+public:
+  AssemblyError(const std::string& s, int line_number)
+      : std::runtime_error(s + " (line " + std::to_string(line_number) + ")"),
+        line(line_number)
+  {
+  }
+
+  const int line;
+};
+
+}  // namespace hasm
@@ -0,0 +1,117 @@
+#include "instruction_table.h"
+
+#include <array>
+#include <initializer_list>
+#include <utility>
+
+using namespace hasm;
+
+namespace {
+
+// FNV-1a seeded with `seed` in place of the usual offset basis
+constexpr uint32_t hash(std::string_view s, uint32_t seed)
+{
+  uint32_t h = seed;
+
+  for (char c : s)
+  {
+    h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+  }
+
+  return h;
+}
+
+// Table of 2^Bits slots indexed by the top bits of the hash.  The seeds
+// below were searched for offline so that no two mnemonics of a field
+// share a slot; the static_asserts check that this still holds.
+template <unsigned Bits>
+class PerfectHash {
+public:
+  using Entry = std::pair<std::string_view, int>;
+
+  constexpr PerfectHash(uint32_t hash_seed, std::initializer_list<Entry> entries)
+      : seed(hash_seed)
+  {
+    for (const auto& entry : entries)
+    {
+      auto& slot = slots[index(entry.first)];
+
+      if (!slot.first.empty())
+        collision_free = false;
+
+      slot = entry;
+    }
+  }
+
+  constexpr int find(std::string_view key) const
+  {
+    const auto& slot = slots[index(key)];
+    return (!key.empty() && (slot.first == key)) ? slot.second : -1;
+  }
+
+  bool collision_free {true};
+
+private:
+  constexpr size_t index(std::string_view key) const
+  {
+    return hash(key, seed) >> (32 - Bits);
+  }
+
+  uint32_t seed;
+  std::array<Entry, 1 << Bits> slots {};
+};
+
+// See Figure 4.3 - a-bit and c1..c6
+constexpr PerfectHash<6> comp_table(1080294u, {
+    {"0",   0b0101010}, {"1",   0b0111111}, {"-1",  0b0111010},
+    {"D",   0b0001100}, {"A",   0b0110000}, {"M",   0b1110000},
+    {"!D",  0b0001101}, {"!A",  0b0110001}, {"!M",  0b1110001},
+    {"-D",  0b0001111}, {"-A",  0b0110011}, {"-M",  0b1110011},
+    {"D+1", 0b0011111}, {"A+1", 0b0110111}, {"M+1", 0b1110111},
+    {"D-1", 0b0001110}, {"A-1", 0b0110010}, {"M-1", 0b1110010},
+    {"D+A", 0b0000010}, {"A+D", 0b0000010},
+    {"D+M", 0b1000010}, {"M+D", 0b1000010},
+    {"D-A", 0b0010011}, {"D-M", 0b1010011},
+    {"A-D", 0b0000111}, {"M-D", 0b1000111},
+    {"D&A", 0b0000000}, {"A&D", 0b0000000},
+    {"D&M", 0b1000000}, {"M&D", 0b1000000},
+    {"D|A", 0b0010101}, {"A|D", 0b0010101},
+    {"D|M", 0b1010101}, {"M|D", 0b1010101},
+});
+
+// See Figure 4.4 - d1 (A), d2 (D), d3 (M)
+constexpr PerfectHash<5> dest_table(42475u, {
+    {"M",   0b001}, {"D",   0b010}, {"A",   0b100},
+    {"MD",  0b011}, {"DM",  0b011},
+    {"AM",  0b101}, {"MA",  0b101},
+    {"AD",  0b110}, {"DA",  0b110},
+    {"AMD", 0b111}, {"ADM", 0b111}, {"MAD", 0b111},
+    {"MDA", 0b111}, {"DAM", 0b111}, {"DMA", 0b111},
+});
+
+// See Figure 4.5
+constexpr PerfectHash<4> jump_table(10u, {
+    {"JGT", 0b001}, {"JEQ", 0b010}, {"JGE", 0b011}, {"JLT", 0b100},
+    {"JNE", 0b101}, {"JLE", 0b110}, {"JMP", 0b111},
+});
+
+static_assert(comp_table.collision_free);
+static_assert(dest_table.collision_free);
+static_assert(jump_table.collision_free);
+
+}  // namespace
+
+int hasm::lookup_comp(std::string_view mnemonic)
+{
+  return comp_table.find(mnemonic);
+}
+
+int hasm::lookup_dest(std::string_view mnemonic)
+{
+  return dest_table.find(mnemonic);
+}
+
+int hasm::lookup_jump(std::string_view mnemonic)
+{
+  return jump_table.find(mnemonic);
+}
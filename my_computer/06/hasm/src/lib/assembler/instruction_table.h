@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace hasm {
+
+// Fields of a C-instruction, `111a cccc ccdd djjj`.  Each lookup returns
+// the bits of the field in place, or -1 if the mnemonic is unknown.
+//
+// The mnemonics of each field are found with a perfect hash: every
+// mnemonic has a slot of its own, so a lookup is one hash and one compare.
+
+// a-bit and c-bits, e.g. "D+M"
+int lookup_comp(std::string_view);
+
+// d-bits, e.g. "AM".  The registers may be given in any order.
+int lookup_dest(std::string_view);
+
+// j-bits, e.g. "JGT"
+int lookup_jump(std::string_view);
+
+}  // namespace hasm
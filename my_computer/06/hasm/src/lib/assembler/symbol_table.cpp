@@ -0,0 +1,110 @@
+#include "symbol_table.h"
+
+using namespace hasm;
+
+namespace {
+
+constexpr size_t INITIAL_SLOTS = 1024;  // a power of two
+
+uint32_t hash_name(std::string_view name)
+{
+  uint32_t h = 2166136261u;
+
+  for (char c : name)
+  {
+    h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+  }
+
+  return h;
+}
+
+}  // namespace
+
+SymbolTable::SymbolTable() : slots(INITIAL_SLOTS)
+{
+  static constexpr const char* registers[] = {
+      "R0", "R1", "R2",  "R3",  "R4",  "R5",  "R6",  "R7",
+      "R8", "R9", "R10", "R11", "R12", "R13", "R14", "R15"};
+
+  for (uint16_t i = 0; i < 16; i++)
+  {
+    insert(registers[i], i);
+  }
+
+  insert("SP", 0);
+  insert("LCL", 1);
+  insert("ARG", 2);
+  insert("THIS", 3);
+  insert("THAT", 4);
+  insert("SCREEN", 16384);
+  insert("KBD", 24576);
+}
+
+// Index of the slot holding `name`, or of the empty slot where it belongs
+size_t SymbolTable::probe(std::string_view name, uint32_t hash) const
+{
+  size_t mask = slots.size() - 1;
+  size_t i = hash & mask;
+
+  while (slots[i].length > 0)
+  {
+    if ((slots[i].hash == hash) && (name_of(slots[i]) == name))
+      break;
+
+    i = (i + 1) & mask;
+  }
+
+  return i;
+}
+
+std::optional<uint16_t> SymbolTable::find(std::string_view name) const
+{
+  const Slot& slot = slots[probe(name, hash_name(name))];
+
+  if (slot.length == 0)
+    return std::nullopt;
+
+  return slot.value;
+}
+
+bool SymbolTable::insert(std::string_view name, uint16_t value)
+{
+  uint32_t hash = hash_name(name);
+  Slot& slot = slots[probe(name, hash)];
+
+  if (slot.length > 0)
+    return false;
+
+  slot.hash = hash;
+  slot.offset = static_cast<uint32_t>(names.size());
+  slot.length = static_cast<uint32_t>(name.size());
+  slot.value = value;
+  names.append(name);
+
+  // Keep the load factor under 3/4 so probe sequences stay short
+  if (++count * 4 > slots.size() * 3)
+    grow();
+
+  return true;
+}
+
+void SymbolTable::grow()
+{
+  std::vector<Slot> old_slots(slots.size() * 2);
+  old_slots.swap(slots);
+
+  size_t mask = slots.size() - 1;
+
+  for (const auto& slot : old_slots)
+  {
+    if (slot.length == 0)
+      continue;
+
+    size_t i = slot.hash & mask;
+
+    while (slots[i].length > 0)
+      i = (i + 1) & mask;
+
+    slots[i] = slot;
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hasm {
+
+// Symbols of a Hack program: the predefined symbols, labels and variables.
+//
+// A flat open addressing table with linear probing.  The slots hold the
+// hash and value of each symbol and the position of its name in one shared
+// string, so a lookup touches no memory other than the slot and the name.
+class SymbolTable {
+public:
+  // Starts with the predefined symbols, R0-R15, SP, ..., SCREEN and KBD
+  SymbolTable();
+
+  std::optional<uint16_t> find(std::string_view name) const;
+
+  // Add `name`, which must not be empty, unless it is already defined.
+  // Returns false if it was.
+  bool insert(std::string_view name, uint16_t value);
+
+  size_t size() const { return count; }
+
+  // Calls visit(name, value) for each symbol, in no particular order
+  template <typename F>
+  void for_each(F visit) const
+  {
+    for (const auto& slot : slots)
+    {
+      if (slot.length > 0)
+        visit(name_of(slot), slot.value);
+    }
+  }
+
+private:
+  struct Slot {
+    uint32_t hash {0};
+    uint32_t offset {0};  // of the name in `names`
+    uint32_t length {0};  // 0 for an empty slot
+    uint16_t value {0};
+  };
+
+  std::string_view name_of(const Slot& slot) const
+  {
+    return std::string_view(names).substr(slot.offset, slot.length);
+  }
+
+  size_t probe(std::string_view name, uint32_t hash) const;
+  void grow();
+
+  std::vector<Slot> slots;
+  std::string names;
+  size_t count {0};
+};
+
+}  // namespace hasm
@@ -0,0 +1,120 @@
+#include "hasm.h"
+
+#include "assembler/assembler.h"
+#include "assembler/assembly_error.h"
+#include "util/mapped_file.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace hasm;
+
+namespace {
+
+void show_usage()
+{
+  std::cout << "USAGE: hasm [-h] [-s] [-o FILE.hack] FILE.asm" << std::endl;
+}
+
+void show_help()
+{
+  show_usage();
+  std::cout << std::endl
+            << "Assembles FILE.asm and prints the machine code, one line of"
+            << std::endl
+            << "16 binary digits per instruction, as hasm.py does."
+            << std::endl
+            << std::endl
+            << "    -h          Display available options" << std::endl
+            << "    -s          Report the assembly time on stderr" << std::endl
+            << "    -o FILE     Write the machine code to FILE" << std::endl;
+}
+
+}  // namespace
+
+int hasm_main(int argc, const char* argv[])
+{
+  bool show_stats = false;
+  const char* output_filename = nullptr;
+  int argi = 1;
+
+  for (; argi < argc - 1; argi++)
+  {
+    if (strcmp(argv[argi], "-s") == 0)
+    {
+      show_stats = true;
+    }
+    else if ((strcmp(argv[argi], "-o") == 0) && (argi + 1 < argc - 1))
+    {
+      output_filename = argv[++argi];
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  if (argi != argc - 1)
+  {
+    show_usage();
+    return 1;
+  }
+
+  if ((strcmp(argv[argi], "--help") == 0) || (strcmp(argv[argi], "-h") == 0))
+  {
+    show_help();
+    return 1;
+  }
+
+  try
+  {
+    auto start_time = std::chrono::steady_clock::now();
+
+    MappedFile input(argv[argi]);
+    Assembler assembler(input.contents());
+    std::string text = Assembler::to_hack_text(assembler.assemble());
+
+    if (output_filename == nullptr)
+    {
+      std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+      std::cout.flush();
+    }
+    else
+    {
+      std::ofstream ofile(output_filename, std::ios::binary);
+
+      if (!ofile)
+      {
+        std::cout << "Failed to open output file, " << output_filename
+                  << std::endl;
+        return -1;
+      }
+
+      ofile.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+    if (show_stats)
+    {
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start_time;
+
+      std::cerr << "Assembled " << text.size() / 17 << " instructions in "
+                << elapsed.count() * 1000.0 << " ms" << std::endl;
+    }
+  }
+  catch (const AssemblyError& e)
+  {
+    std::cout << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  catch (const std::runtime_error& e)
+  {
+    std::cout << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace hasm;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& pathname)
+{
+  std::ifstream file(pathname, std::ios::binary);
+
+  if (!file)
+    throw std::runtime_error("Failed to open input file, " + pathname);
+
+  std::stringstream ss;
+  ss << file.rdbuf();
+  fallback = ss.str();
+
+  data = fallback.data();
+  length = fallback.size();
+}
+
+MappedFile::~MappedFile() {}
+
+#else
+
+MappedFile::MappedFile(const std::string& pathname)
+{
+  int fd = open(pathname.c_str(), O_RDONLY);
+
+  if (fd < 0)
+    throw std::runtime_error("Failed to open input file, " + pathname);
+
+  struct stat file_stat;
+
+  if (fstat(fd, &file_stat) != 0)
+  {
+    close(fd);
+    throw std::runtime_error("Failed to read input file, " + pathname);
+  }
+
+  length = static_cast<size_t>(file_stat.st_size);
+
+  // mmap() rejects zero length mappings; an empty file is an empty view
+  if (length > 0)
+  {
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (mapping == MAP_FAILED)
+    {
+      close(fd);
+      throw std::runtime_error("Failed to map input file, " + pathname);
+    }
+
+    data = static_cast<const char*>(mapping);
+  }
+
+  close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (data != nullptr)
+  {
+    munmap(const_cast<char*>(data), length);
+  }
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace hasm {
+
+// Read-only view of an entire file.  The file is memory mapped where the
+// platform allows it so that large inputs are never copied.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& pathname);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&&) = delete;
+  MappedFile& operator=(MappedFile&&) = delete;
+
+  std::string_view contents() const { return {data, length}; }
+
+private:
+  const char* data {nullptr};
+  size_t length {0};
+
+  // Holds the contents where mmap is unavailable
+  std::string fallback;
+};
+
+}  // namespace hasm
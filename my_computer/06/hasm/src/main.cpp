@@ -0,0 +1,13 @@
+#include "hasm.h"
+
+int main(int argc, const char* argv[])
+{
+  // check for funny business
+  if ((argc == 0) || (argv == nullptr) || (argv[0] == nullptr))
+  {
+    // no error for you
+    return 0;
+  }
+
+  return hasm_main(argc, argv);
+}
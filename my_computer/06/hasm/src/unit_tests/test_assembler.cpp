@@ -0,0 +1,86 @@
+#include "assembler/assembler.h"
+#include "assembler/assembly_error.h"
+#include "catch.hpp"
+
+#include <string>
+
+using namespace hasm;
+
+namespace {
+
+std::string assemble(std::string_view source)
+{
+  Assembler assembler(source);
+  return Assembler::to_hack_text(assembler.assemble());
+}
+
+}  // namespace
+
+SCENARIO("Instructions")
+{
+  SECTION("A-instructions")
+  {
+    REQUIRE(assemble("@0") == "0000000000000000\n");
+    REQUIRE(assemble("@24576") == "0110000000000000\n");
+    REQUIRE(assemble("@32767") == "0111111111111111\n");
+    REQUIRE(assemble("@KBD") == "0110000000000000\n");
+  }
+
+  SECTION("C-instructions")
+  {
+    REQUIRE(assemble("D=M") == "1111110000010000\n");
+    REQUIRE(assemble("D;JEQ") == "1110001100000010\n");
+    REQUIRE(assemble("0;JMP") == "1110101010000111\n");
+    REQUIRE(assemble("D=A+1;JLE") == "1110110111010110\n");
+    REQUIRE(assemble("AM=M-1") == "1111110010101000\n");
+  }
+
+  SECTION("White space and comments")
+  {
+    REQUIRE(assemble("  D = D - M   // subtract\r\n") == "1111010011010000\n");
+    REQUIRE(assemble("// comment only\n\n   \n") == "");
+  }
+}
+
+SCENARIO("Symbols")
+{
+  SECTION("Labels refer to the next instruction")
+  {
+    REQUIRE(assemble("@END\n"
+                     "0;JMP\n"
+                     "(END)\n"
+                     "@END\n") ==
+            "0000000000000010\n"
+            "1110101010000111\n"
+            "0000000000000010\n");
+  }
+
+  SECTION("Variables are allocated from 16 in order of first use")
+  {
+    Assembler assembler("@i\n@sum\n@i\n(LOOP)\n@LOOP\n");
+    auto code = assembler.assemble();
+
+    REQUIRE(code == std::vector<uint16_t> {16, 17, 16, 3});
+    REQUIRE(assembler.symbols().find("sum") == 17);
+    REQUIRE(assembler.symbols().find("LOOP") == 3);
+  }
+}
+
+SCENARIO("Invalid input")
+{
+  REQUIRE_THROWS_AS(assemble("@32768"), AssemblyError);
+  REQUIRE_THROWS_AS(assemble("D=D+D"), AssemblyError);
+  REQUIRE_THROWS_AS(assemble("D;JMX"), AssemblyError);
+  REQUIRE_THROWS_AS(assemble("(LOOP\n"), AssemblyError);
+  REQUIRE_THROWS_AS(assemble("(LOOP)\n(LOOP)\n"), AssemblyError);
+  REQUIRE_THROWS_AS(assemble("@1abc"), AssemblyError);
+
+  try
+  {
+    assemble("@1\n\nX=1\n");
+  }
+  catch (const AssemblyError& e)
+  {
+    REQUIRE(e.line == 3);
+  }
+}
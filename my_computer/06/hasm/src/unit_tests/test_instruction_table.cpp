@@ -0,0 +1,60 @@
+#include "assembler/instruction_table.h"
+#include "catch.hpp"
+
+using namespace hasm;
+
+SCENARIO("Computation mnemonics")
+{
+  SECTION("A register operand")
+  {
+    REQUIRE(lookup_comp("0") == 0b0101010);
+    REQUIRE(lookup_comp("D+A") == 0b0000010);
+    REQUIRE(lookup_comp("D-A") == 0b0010011);
+    REQUIRE(lookup_comp("A-D") == 0b0000111);
+    REQUIRE(lookup_comp("D|A") == 0b0010101);
+  }
+
+  SECTION("M operand sets the a-bit")
+  {
+    REQUIRE(lookup_comp("M") == 0b1110000);
+    REQUIRE(lookup_comp("D+M") == 0b1000010);
+    REQUIRE(lookup_comp("M-D") == 0b1000111);
+    REQUIRE(lookup_comp("-M") == 0b1110011);
+  }
+
+  SECTION("Commutative operations in either order")
+  {
+    REQUIRE(lookup_comp("A+D") == lookup_comp("D+A"));
+    REQUIRE(lookup_comp("M&D") == lookup_comp("D&M"));
+    REQUIRE(lookup_comp("M|D") == lookup_comp("D|M"));
+  }
+
+  SECTION("Unknown")
+  {
+    REQUIRE(lookup_comp("") == -1);
+    REQUIRE(lookup_comp("D+D") == -1);
+    REQUIRE(lookup_comp("A-M") == -1);
+    REQUIRE(lookup_comp("d+a") == -1);
+  }
+}
+
+SCENARIO("Destination mnemonics")
+{
+  REQUIRE(lookup_dest("M") == 0b001);
+  REQUIRE(lookup_dest("D") == 0b010);
+  REQUIRE(lookup_dest("MD") == 0b011);
+  REQUIRE(lookup_dest("DM") == 0b011);
+  REQUIRE(lookup_dest("AMD") == 0b111);
+  REQUIRE(lookup_dest("DAM") == 0b111);
+  REQUIRE(lookup_dest("") == -1);
+  REQUIRE(lookup_dest("MM") == -1);
+}
+
+SCENARIO("Jump mnemonics")
+{
+  REQUIRE(lookup_jump("JGT") == 0b001);
+  REQUIRE(lookup_jump("JNE") == 0b101);
+  REQUIRE(lookup_jump("JMP") == 0b111);
+  REQUIRE(lookup_jump("") == -1);
+  REQUIRE(lookup_jump("JMPX") == -1);
+}
@@ -0,0 +1,48 @@
+#include "assembler/symbol_table.h"
+#include "catch.hpp"
+
+#include <string>
+
+using namespace hasm;
+
+SCENARIO("Symbol table")
+{
+  SymbolTable symbols;
+
+  SECTION("Predefined symbols")
+  {
+    REQUIRE(symbols.find("R0") == 0);
+    REQUIRE(symbols.find("R15") == 15);
+    REQUIRE(symbols.find("THAT") == 4);
+    REQUIRE(symbols.find("SCREEN") == 16384);
+    REQUIRE(symbols.find("KBD") == 24576);
+    REQUIRE(symbols.size() == 23);
+  }
+
+  SECTION("Insert and find")
+  {
+    REQUIRE(symbols.find("LOOP") == std::nullopt);
+    REQUIRE(symbols.insert("LOOP", 10));
+    REQUIRE(symbols.find("LOOP") == 10);
+    REQUIRE_FALSE(symbols.insert("LOOP", 20));
+    REQUIRE(symbols.find("LOOP") == 10);
+    REQUIRE_FALSE(symbols.insert("SP", 20));
+  }
+
+  SECTION("Growth keeps every symbol")
+  {
+    for (int i = 0; i < 5000; i++)
+    {
+      REQUIRE(symbols.insert("Main.main$label" + std::to_string(i),
+                             static_cast<uint16_t>(i)));
+    }
+
+    for (int i = 0; i < 5000; i++)
+    {
+      REQUIRE(symbols.find("Main.main$label" + std::to_string(i)) == i);
+    }
+
+    REQUIRE(symbols.find("KBD") == 24576);
+    REQUIRE(symbols.size() == 5023);
+  }
+}
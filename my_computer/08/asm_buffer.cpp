@@ -0,0 +1,185 @@
+#include "asm_buffer.h"
+#include "hack_assembler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cstring>
+
+using namespace std;
+
+// Return space for `length` more characters of the current line.  A line
+// never spans two chunks so that it can be referred to by a string_view.
+char* AsmBuffer::reserve(size_t length)
+{
+  if (chunks.empty() || (chunks.back().size() + length > chunks.back().capacity()))
+  {
+    string partialLine;
+
+    if (!chunks.empty())
+    {
+      partialLine = chunks.back().substr(lineStart);
+      chunks.back().resize(lineStart);
+    }
+
+    chunks.emplace_back();
+    chunks.back().reserve(max(CHUNK_SIZE, partialLine.size() + length));
+    chunks.back() = partialLine;
+    lineStart = 0;
+  }
+
+  string& chunk = chunks.back();
+  size_t offset = chunk.size();
+
+  // Within the reserved capacity, so existing lines are not moved
+  chunk.resize(offset + length);
+
+  return &chunk[offset];
+}
+
+void AsmBuffer::append(const char* text, size_t length)
+{
+  if (length == 0)
+    return;
+
+  char* p = reserve(length);
+  memcpy(p, text, length);
+
+  if (text[length - 1] != '\n')
+    return;
+
+  // Complete the current line
+  string& chunk = chunks.back();
+  string_view line(chunk.data() + lineStart, chunk.size() - lineStart - 1);
+
+  assert(line.find('\n') == string_view::npos);
+
+  AsmLine_t type = L_INSTRUCTION;
+
+  if (line.empty() || (line[0] == '/'))
+    type = L_COMMENT;
+  else if (line[0] == '(')
+    type = L_LABEL;
+
+  lines.push_back(AsmLine{type, line, pendingSource});
+  pendingSource = -1;
+  lineStart = chunk.size();
+}
+
+AsmBuffer& AsmBuffer::operator<<(const char* text)
+{
+  append(text, strlen(text));
+  return *this;
+}
+
+AsmBuffer& AsmBuffer::operator<<(string_view text)
+{
+  append(text.data(), text.length());
+  return *this;
+}
+
+AsmBuffer& AsmBuffer::operator<<(char c)
+{
+  append(&c, 1);
+  return *this;
+}
+
+AsmBuffer& AsmBuffer::operator<<(int value)
+{
+  char digits[16];
+  auto result = to_chars(digits, digits + sizeof(digits), value);
+  append(digits, result.ptr - digits);
+  return *this;
+}
+
+AsmBuffer& AsmBuffer::operator<<(unsigned int value)
+{
+  char digits[16];
+  auto result = to_chars(digits, digits + sizeof(digits), value);
+  append(digits, result.ptr - digits);
+  return *this;
+}
+
+void AsmBuffer::markSource(const SourcePosition& position)
+{
+  pendingSource = static_cast<int>(sources.size());
+  sources.push_back(position);
+}
+
+size_t AsmBuffer::mapSources(SourceMap& map, size_t address) const
+{
+  for (const auto& line : lines)
+  {
+    if (line.source >= 0)
+      map.add(address, sources[line.source]);
+
+    if (line.type == L_INSTRUCTION)
+      address++;
+  }
+
+  return address;
+}
+
+size_t AsmBuffer::pendingInstructions() const
+{
+  return count_if(lines.begin(), lines.end(),
+      [](const AsmLine& line) { return line.type == L_INSTRUCTION; });
+}
+
+void AsmBuffer::replaceLines(vector<AsmLine>&& newLines)
+{
+  lines = move(newLines);
+  linesReplaced = true;
+}
+
+void AsmBuffer::flushTo(ofstream& outfile)
+{
+  assert(chunks.empty() || (lineStart == chunks.back().size()));
+
+  size_t bytes = 0;
+
+  if (!linesReplaced)
+  {
+    // The chunks hold exactly the lines in order
+    for (const auto& chunk : chunks)
+    {
+      outfile.write(chunk.data(), chunk.size());
+      bytes += chunk.size();
+    }
+  }
+  else
+  {
+    for (const auto& line : lines)
+    {
+      outfile.write(line.text.data(), line.text.size());
+      outfile.put('\n');
+      bytes += line.text.size() + 1;
+    }
+  }
+
+  outfile.flush();
+
+  totalBytes += bytes;
+  totalInstructions += pendingInstructions();
+
+  chunks.clear();
+  lines.clear();
+  sources.clear();
+  lineStart = 0;
+  linesReplaced = false;
+}
+
+void AsmBuffer::flushTo(HackAssembler& assembler)
+{
+  assert(chunks.empty() || (lineStart == chunks.back().size()));
+
+  assembler.add(lines);
+
+  totalInstructions += pendingInstructions();
+
+  chunks.clear();
+  lines.clear();
+  sources.clear();
+  lineStart = 0;
+  linesReplaced = false;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <fstream>
+#include <list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "source_map.h"
+
+class HackAssembler;
+
+typedef enum {
+  L_INSTRUCTION,
+  L_LABEL,
+  L_COMMENT,    // comments and blank lines
+} AsmLine_t;
+
+/* AsmLine - One line of generated assembly, without its line ending */
+struct AsmLine {
+  AsmLine_t type;
+  std::string_view text;
+  int source = -1;      // the position the line begins, see markSource()
+};
+
+/* AsmBuffer - Accumulates the generated assembly text in fixed size     */
+/*             chunks.  Nothing reaches the output file until flushTo()  */
+/*             is called, which the translator does once per input file. */
+/*                                                                       */
+/*             The buffer also keeps the list of lines written since the */
+/*             last flush.  Optimization passes may replace that list,   */
+/*             in which case the replacement is what gets written.       */
+class AsmBuffer {
+  static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+  std::list<std::string> chunks;
+  std::vector<AsmLine> lines;
+  std::vector<SourcePosition> sources;
+  int pendingSource = -1;
+  size_t lineStart = 0;           // offset of the current line in the last chunk
+  bool linesReplaced = false;
+  size_t totalBytes = 0;
+  size_t totalInstructions = 0;
+
+  char* reserve(size_t length);
+  void append(const char* text, size_t length);
+
+public:
+
+  AsmBuffer& operator<<(const char* text);
+  AsmBuffer& operator<<(std::string_view text);
+  AsmBuffer& operator<<(char c);
+  AsmBuffer& operator<<(int value);
+  AsmBuffer& operator<<(unsigned int value);
+
+  // The lines from the next one on come from `position`.  The next line
+  // keeps the mark through replaceLines() as long as the rewrite keeps it,
+  // as the peephole optimizer keeps comments.
+  void markSource(const SourcePosition& position);
+
+  // Add the positions marked since the last flush to `map`, the first
+  // instruction since then being at ROM address `address`.  Returns the
+  // address after the last instruction.
+  size_t mapSources(SourceMap& map, size_t address) const;
+
+  // Lines completed since the last flush
+  const std::vector<AsmLine>& getLines() const { return lines; }
+
+  // Number of instruction lines among getLines()
+  size_t pendingInstructions() const;
+
+  // Substitute the lines to be written by the next flush.  The text of each
+  // line must outlive the flush, e.g. a literal or a line of getLines().
+  void replaceLines(std::vector<AsmLine>&& newLines);
+
+  // Write all buffered lines to `outfile` and release them
+  void flushTo(std::ofstream& outfile);
+
+  // Pass all buffered lines to `assembler` and release them
+  void flushTo(HackAssembler& assembler);
+
+  // Totals of everything flushed so far
+  size_t bytes() const { return totalBytes; }
+  size_t instructions() const { return totalInstructions; }
+};
@@ -0,0 +1,80 @@
+#include "call_graph.h"
+
+#include <unordered_map>
+
+using namespace std;
+
+vector<string_view> removeUnreachableFunctions(vector<VmModule>& modules,
+    string_view root)
+{
+  vector<string_view> removed;
+  unordered_map<string_view, const VmFunction*> definitions;
+  unordered_map<const VmFunction*, bool> reachable;
+  vector<const VmFunction*> worklist;
+
+  for (const auto& module : modules)
+  {
+    for (const auto& function : module.functions)
+    {
+      if (function.entry.type == C_FUNCTION)
+      {
+        definitions.emplace(function.name(), &function);
+        reachable[&function] = false;
+      }
+      else
+      {
+        worklist.push_back(&function);
+      }
+    }
+  }
+
+  auto rootDefinition = definitions.find(root);
+
+  if (rootDefinition == definitions.end())
+    return removed;
+
+  worklist.push_back(rootDefinition->second);
+  reachable[rootDefinition->second] = true;
+
+  // Mark everything called from a reachable function.  Calls to functions
+  // that are not defined are left for the assembler to report.
+  while (!worklist.empty())
+  {
+    const VmFunction* function = worklist.back();
+    worklist.pop_back();
+
+    for (const auto& block : function->blocks)
+    {
+      for (const auto& cmd : block.commands)
+      {
+        if (cmd.type != C_CALL)
+          continue;
+
+        auto callee = definitions.find(cmd.name);
+
+        if ((callee != definitions.end()) && !reachable[callee->second])
+        {
+          reachable[callee->second] = true;
+          worklist.push_back(callee->second);
+        }
+      }
+    }
+  }
+
+  for (auto& module : modules)
+  {
+    vector<VmFunction> kept;
+
+    for (auto& function : module.functions)
+    {
+      if ((function.entry.type == C_FUNCTION) && !reachable[&function])
+        removed.push_back(function.name());
+      else
+        kept.push_back(move(function));
+    }
+
+    module.functions = move(kept);
+  }
+
+  return removed;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "vm_ir.h"
+
+// Remove every function of `modules` that cannot be reached by calls
+// starting from the function `root` or from code outside of a function.
+// Nothing is removed when `root` is not defined.  Returns the names of the
+// functions removed, in module order.
+std::vector<std::string_view> removeUnreachableFunctions(
+    std::vector<VmModule>& modules, std::string_view root);
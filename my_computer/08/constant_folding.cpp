@@ -0,0 +1,476 @@
+#include "constant_folding.h"
+
+#include <cstdint>
+
+using namespace std;
+
+namespace {
+
+const int TEMP_COUNT = 8;
+
+// Doublings that may replace a call of Math.multiply.  The call takes
+// several hundred cycles, each doubling about 20.
+const int MAX_DOUBLINGS = 6;
+
+const size_t NO_OPERAND = SIZE_MAX;
+
+bool isConstant(const VmCommand& cmd)
+{
+  return (cmd.type == C_PUSH) && (cmd.segment == S_CONSTANT);
+}
+
+bool isUnary(Arithmetic_t arithmetic)
+{
+  return (arithmetic == A_NEG) || (arithmetic == A_NOT);
+}
+
+// `value` as the signed 16-bit word the Hack machine holds
+int word(int value)
+{
+  return static_cast<int16_t>(value);
+}
+
+// Result of `arithmetic` on x and y (y alone for neg and not) as the
+// translated code computes it.  Comparisons test the sign of x - y.
+int evaluate(Arithmetic_t arithmetic, int x, int y)
+{
+  switch (arithmetic)
+  {
+    case A_ADD: return word(x + y);
+    case A_SUB: return word(x - y);
+    case A_NEG: return word(-y);
+    case A_NOT: return word(~y);
+    case A_AND: return x & y;
+    case A_OR: return x | y;
+    case A_EQ: return (x == y) ? -1 : 0;
+    case A_GT: return (word(x - y) > 0) ? -1 : 0;
+    case A_LT: return (word(x - y) < 0) ? -1 : 0;
+    default: return 0;
+  }
+}
+
+// Is `x op constant`, and for add, or and and `constant op x`, just x?
+bool isIdentity(Arithmetic_t arithmetic, int constant)
+{
+  if ((arithmetic == A_ADD) || (arithmetic == A_SUB) || (arithmetic == A_OR))
+    return constant == 0;
+
+  return (arithmetic == A_AND) && (constant == -1);
+}
+
+// log2 of `value` if it is a power of two, otherwise -1
+int powerOfTwo(int value)
+{
+  if ((value <= 0) || ((value & (value - 1)) != 0))
+    return -1;
+
+  int power = 0;
+
+  while (value > 1)
+  {
+    value >>= 1;
+    power++;
+  }
+
+  return power;
+}
+
+// Values `cmd` takes from and leaves on the stack.  False for commands
+// that do more than compute values.
+bool stackEffect(const VmCommand& cmd, int& pops, int& pushes)
+{
+  pushes = 1;
+
+  switch (cmd.type)
+  {
+    case C_PUSH:
+      pops = 0;
+      return true;
+    case C_POP:
+      pops = 1;
+      pushes = 0;
+      return true;
+    case C_ARITHMETIC:
+      pops = isUnary(cmd.arithmetic) ? 1 : 2;
+      return true;
+    case C_CALL:
+      pops = cmd.index;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Index of the first of the commands computing the value on top of the
+// stack after commands[0, end), or NO_OPERAND if it comes from another
+// block
+size_t operandStart(const vector<VmCommand>& commands, size_t end)
+{
+  int needed = 1;
+
+  for (size_t i = end; i-- > 0; )
+  {
+    int pops;
+    int pushes;
+
+    if (!stackEffect(commands[i], pops, pushes))
+      return NO_OPERAND;
+
+    needed += pops - pushes;
+
+    if (needed == 0)
+      return i;
+  }
+
+  return NO_OPERAND;
+}
+
+// Do commands[start, end) only compute a value, so that they may be
+// dropped?
+bool isPure(const vector<VmCommand>& commands, size_t start, size_t end)
+{
+  if (start == NO_OPERAND)
+    return false;
+
+  for (size_t i = start; i < end; i++)
+  {
+    if ((commands[i].type != C_PUSH) && (commands[i].type != C_ARITHMETIC))
+      return false;
+  }
+
+  return true;
+}
+
+/* BlockFolder - Simplifies the end of a block as each command is added */
+class BlockFolder {
+  vector<VmCommand>& commands;
+  FoldingStats& stats;
+  int spareTemp;
+
+  // Commands are numbered as the `origin` they replace
+  void add(Command_t type, Segment_t segment, int index,
+      const VmCommand& origin)
+  {
+    VmCommand cmd;
+    cmd.type = type;
+    cmd.segment = segment;
+    cmd.index = index;
+    cmd.lineNumber = origin.lineNumber;
+    cmd.sourceLine = origin.sourceLine;
+    commands.push_back(cmd);
+  }
+
+  void addArithmetic(Arithmetic_t arithmetic, const VmCommand& origin)
+  {
+    VmCommand cmd;
+    cmd.type = C_ARITHMETIC;
+    cmd.arithmetic = arithmetic;
+    cmd.lineNumber = origin.lineNumber;
+    cmd.sourceLine = origin.sourceLine;
+    commands.push_back(cmd);
+  }
+
+  bool foldArithmetic()
+  {
+    size_t n = commands.size();
+    Arithmetic_t arithmetic = commands[n - 1].arithmetic;
+
+    if (isUnary(arithmetic))
+    {
+      if ((n < 2) || !isConstant(commands[n - 2]))
+        return false;
+
+      commands.pop_back();
+      commands.back().index = evaluate(arithmetic, 0, commands.back().index);
+      stats.folded++;
+      return true;
+    }
+
+    size_t y = operandStart(commands, n - 1);
+
+    if (y == NO_OPERAND)
+      return false;
+
+    size_t x = operandStart(commands, y);
+    bool xConstant = (x != NO_OPERAND) && (x + 1 == y) &&
+                     isConstant(commands[x]);
+
+    if ((y + 2 == n) && isConstant(commands[y]))
+    {
+      int constant = commands[y].index;
+
+      if (xConstant)
+      {
+        commands.resize(n - 2);
+        commands.back().index =
+            evaluate(arithmetic, commands.back().index, constant);
+        stats.folded++;
+        return true;
+      }
+
+      if (isIdentity(arithmetic, constant))
+      {
+        commands.resize(n - 2);
+        stats.folded++;
+        return true;
+      }
+
+      // Keep constants within what a .vm file could say
+      if (((arithmetic == A_ADD) || (arithmetic == A_SUB)) &&
+          (constant < 0) && (constant > INT16_MIN))
+      {
+        commands[y].index = -constant;
+        commands[n - 1].arithmetic = (arithmetic == A_ADD) ? A_SUB : A_ADD;
+        return true;
+      }
+    }
+
+    if (xConstant && (arithmetic != A_SUB) &&
+        isIdentity(arithmetic, commands[x].index))
+    {
+      commands.pop_back();
+      commands.erase(commands.begin() + x);
+      stats.folded++;
+      return true;
+    }
+
+    return false;
+  }
+
+  // Can the operand commands[start, end) be multiplied by `constant`
+  // without a call?
+  bool canMultiply(int constant, size_t start, size_t end)
+  {
+    if (constant == 1)
+      return true;
+
+    if (constant == 0)
+      return isPure(commands, start, end);
+
+    int power = powerOfTwo(constant);
+
+    if ((power < 0) || (power > MAX_DOUBLINGS))
+      return false;
+
+    bool singlePush = (start != NO_OPERAND) && (start + 1 == end) &&
+                      (commands[start].type == C_PUSH);
+
+    return (spareTemp >= 0) || ((power == 1) && singlePush);
+  }
+
+  // Multiply the operand beginning at commands[start], the last on the
+  // stack, by `constant`
+  void multiplyTop(int constant, size_t start, const VmCommand& origin)
+  {
+    if (constant == 1)
+      return;
+
+    if (constant == 0)
+    {
+      commands.resize(start);
+      add(C_PUSH, S_CONSTANT, 0, origin);
+      return;
+    }
+
+    int doublings = powerOfTwo(constant);
+
+    // A variable can be pushed again
+    if ((start != NO_OPERAND) && (start + 1 == commands.size()) &&
+        (commands[start].type == C_PUSH))
+    {
+      VmCommand operand = commands[start];
+      commands.push_back(operand);
+      addArithmetic(A_ADD, origin);
+      doublings--;
+    }
+
+    for (; doublings > 0; doublings--)
+    {
+      add(C_POP, S_TEMP, spareTemp, origin);
+      add(C_PUSH, S_TEMP, spareTemp, origin);
+      add(C_PUSH, S_TEMP, spareTemp, origin);
+      addArithmetic(A_ADD, origin);
+    }
+  }
+
+  bool foldCall()
+  {
+    size_t n = commands.size();
+    const VmCommand call = commands[n - 1];
+    bool multiply = (call.name == "Math.multiply");
+
+    size_t y = operandStart(commands, n - 1);
+
+    if (y == NO_OPERAND)
+      return false;
+
+    size_t x = operandStart(commands, y);
+    bool xConstant = (x != NO_OPERAND) && (x + 1 == y) &&
+                     isConstant(commands[x]);
+    bool yConstant = (y + 2 == n) && isConstant(commands[y]);
+
+    if (xConstant && yConstant)
+    {
+      int dividend = commands[x].index;
+      int divisor = commands[y].index;
+      int value;
+
+      if (multiply)
+        value = word(dividend * divisor);
+      else if ((dividend >= 0) && (divisor > 0))
+        value = dividend / divisor;
+      else
+        return false;
+
+      commands.resize(n - 2);
+      commands.back().index = value;
+    }
+    else if (multiply && yConstant &&
+             canMultiply(commands[y].index, x, y))
+    {
+      int constant = commands[y].index;
+      commands.resize(n - 2);
+      multiplyTop(constant, x, call);
+    }
+    else if (multiply && xConstant &&
+             canMultiply(commands[x].index, y, n - 1))
+    {
+      int constant = commands[x].index;
+      commands.pop_back();
+      commands.erase(commands.begin() + x);
+      multiplyTop(constant, x, call);
+    }
+    else if (!multiply && yConstant && (commands[y].index == 1))
+    {
+      commands.resize(n - 2);
+    }
+    else
+    {
+      return false;
+    }
+
+    stats.folded++;
+    stats.callsReplaced++;
+    return true;
+  }
+
+  bool foldBranch()
+  {
+    size_t n = commands.size();
+
+    if ((n < 2) || !isConstant(commands[n - 2]))
+      return false;
+
+    VmCommand branch = commands[n - 1];
+    bool taken = (commands[n - 2].index != 0);
+
+    commands.resize(n - 2);
+
+    if (taken)
+    {
+      branch.type = C_GOTO;
+      commands.push_back(branch);
+    }
+
+    stats.folded++;
+    return true;
+  }
+
+  // Simplify the last command with those before it
+  bool simplify()
+  {
+    if (commands.empty())
+      return false;
+
+    const VmCommand& last = commands.back();
+
+    if (last.type == C_ARITHMETIC)
+      return foldArithmetic();
+
+    if ((last.type == C_CALL) && (last.index == 2) &&
+        ((last.name == "Math.multiply") || (last.name == "Math.divide")))
+    {
+      return foldCall();
+    }
+
+    if (last.type == C_IF_GOTO)
+      return foldBranch();
+
+    return false;
+  }
+
+public:
+
+  BlockFolder(vector<VmCommand>& blockCommands, FoldingStats& foldingStats,
+      int spareTempIndex) :
+    commands(blockCommands),
+    stats(foldingStats),
+    spareTemp(spareTempIndex)
+  {
+  }
+
+  void append(const VmCommand& cmd)
+  {
+    commands.push_back(cmd);
+
+    while (simplify())
+    {
+    }
+  }
+};
+
+}  // namespace
+
+int findSpareTemp(const vector<VmModule>& modules)
+{
+  bool used[TEMP_COUNT] = {};
+
+  for (const auto& module : modules)
+  {
+    for (const auto& function : module.functions)
+    {
+      for (const auto& block : function.blocks)
+      {
+        for (const auto& cmd : block.commands)
+        {
+          if (((cmd.type == C_PUSH) || (cmd.type == C_POP)) &&
+              (cmd.segment == S_TEMP) && (cmd.index < TEMP_COUNT))
+          {
+            used[cmd.index] = true;
+          }
+        }
+      }
+    }
+  }
+
+  for (int i = TEMP_COUNT - 1; i >= 0; i--)
+  {
+    if (!used[i])
+      return i;
+  }
+
+  return -1;
+}
+
+FoldingStats foldConstants(VmModule& module, int spareTemp)
+{
+  FoldingStats stats;
+
+  for (auto& function : module.functions)
+  {
+    for (auto& block : function.blocks)
+    {
+      vector<VmCommand> commands;
+      commands.reserve(block.commands.size());
+
+      BlockFolder folder(commands, stats, spareTemp);
+
+      for (const auto& cmd : block.commands)
+        folder.append(cmd);
+
+      block.commands = move(commands);
+    }
+  }
+
+  return stats;
+}
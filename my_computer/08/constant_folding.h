@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "vm_ir.h"
+
+/* FoldingStats - What foldConstants() changed in a module */
+struct FoldingStats {
+  size_t folded = 0;          // operations evaluated during translation
+  size_t callsReplaced = 0;   // calls of Math.multiply and Math.divide
+};
+
+// Evaluate within each block of `module` what can be known from constants:
+//   - arithmetic on constants, e.g. `push constant 0; not` becomes
+//     `push constant -1`,
+//   - additions of 0 and the like,
+//   - Math.multiply and Math.divide of constants, and Math.multiply by a
+//     power of two as repeated doubling through `spareTemp`, which is
+//     left as a call when -1,
+//   - and if-goto on a constant, which becomes a goto or nothing.
+// Constants may then lie outside of the 0-32767 a .vm file allows; the
+// writer loads those as any 16-bit value.  Math.multiply and Math.divide
+// are assumed to be those of the JackOS.
+FoldingStats foldConstants(VmModule& module, int spareTemp);
+
+// A temp register that no function of `modules` uses, or -1.  A temp
+// one function leaves alone may still hold a value of its callers.
+int findSpareTemp(const std::vector<VmModule>& modules);
@@ -0,0 +1,254 @@
+#include "hack_assembler.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+const struct {
+  string_view text;
+  int value;
+} predefinedSymbols[] = {
+  {"SP", 0}, {"LCL", 1}, {"ARG", 2}, {"THIS", 3}, {"THAT", 4},
+  {"R0", 0}, {"R1", 1}, {"R2", 2}, {"R3", 3},
+  {"R4", 4}, {"R5", 5}, {"R6", 6}, {"R7", 7},
+  {"R8", 8}, {"R9", 9}, {"R10", 10}, {"R11", 11},
+  {"R12", 12}, {"R13", 13}, {"R14", 14}, {"R15", 15},
+  {"SCREEN", 16384}, {"KBD", 24576},
+};
+
+// The a-bit and c1..c6 bits of each computation (Figure 4.3)
+const struct {
+  string_view text;
+  uint16_t bits;
+} computations[] = {
+  {"0",   0b0101010}, {"1",   0b0111111}, {"-1",  0b0111010},
+  {"D",   0b0001100}, {"A",   0b0110000}, {"M",   0b1110000},
+  {"!D",  0b0001101}, {"!A",  0b0110001}, {"!M",  0b1110001},
+  {"-D",  0b0001111}, {"-A",  0b0110011}, {"-M",  0b1110011},
+  {"D+1", 0b0011111}, {"A+1", 0b0110111}, {"M+1", 0b1110111},
+  {"D-1", 0b0001110}, {"A-1", 0b0110010}, {"M-1", 0b1110010},
+  {"D+A", 0b0000010}, {"A+D", 0b0000010}, {"D+M", 0b1000010}, {"M+D", 0b1000010},
+  {"D-A", 0b0010011}, {"D-M", 0b1010011},
+  {"A-D", 0b0000111}, {"M-D", 0b1000111},
+  {"D&A", 0b0000000}, {"A&D", 0b0000000}, {"D&M", 0b1000000}, {"M&D", 0b1000000},
+  {"D|A", 0b0010101}, {"A|D", 0b0010101}, {"D|M", 0b1010101}, {"M|D", 0b1010101},
+};
+
+const string_view jumps[] = {
+  "", "JGT", "JEQ", "JGE", "JLT", "JNE", "JLE", "JMP",
+};
+
+// Remove white space and any trailing comment
+string_view trim(string_view text)
+{
+  auto comment = text.find("//");
+
+  if (comment != string_view::npos)
+    text = text.substr(0, comment);
+
+  while (!text.empty() && ((text.back() == ' ') || (text.back() == '\t') ||
+                           (text.back() == '\r')))
+    text.remove_suffix(1);
+
+  while (!text.empty() && ((text.front() == ' ') || (text.front() == '\t')))
+    text.remove_prefix(1);
+
+  return text;
+}
+
+}  // namespace
+
+HackAssembler::HackAssembler()
+{
+  for (const auto& symbol : predefinedSymbols)
+  {
+    symbolValues[intern(symbol.text)] = symbol.value;
+  }
+}
+
+void HackAssembler::error(const char* what, string_view text) const
+{
+  cerr << "Assembler: " << what << ": " << text << endl;
+  exit(-1);
+}
+
+// Return the index of `name` in the symbol table, adding it if needed
+size_t HackAssembler::intern(string_view name)
+{
+  auto entry = symbolIndex.find(name);
+
+  if (entry != symbolIndex.end())
+    return entry->second;
+
+  // Names are kept in a deque so that the keys never move
+  symbolNames.emplace_back(name);
+  size_t index = symbolValues.size();
+  symbolIndex.emplace(symbolNames.back(), index);
+  symbolValues.push_back(UNDEFINED);
+
+  return index;
+}
+
+uint16_t HackAssembler::encodeCInstruction(string_view text) const
+{
+  uint16_t dest = 0;
+  uint16_t jump = 0;
+
+  auto semicolon = text.find(';');
+
+  if (semicolon != string_view::npos)
+  {
+    string_view mnemonic = text.substr(semicolon + 1);
+
+    while ((jump < 8) && (jumps[jump] != mnemonic))
+      jump++;
+
+    if ((jump == 0) || (jump == 8))
+      error("Unknown jump", text);
+
+    text = text.substr(0, semicolon);
+  }
+
+  auto equals = text.find('=');
+
+  if (equals != string_view::npos)
+  {
+    for (char c : text.substr(0, equals))
+    {
+      if (c == 'A')
+        dest |= 4;
+      else if (c == 'D')
+        dest |= 2;
+      else if (c == 'M')
+        dest |= 1;
+      else
+        error("Unknown destination", text);
+    }
+
+    text = text.substr(equals + 1);
+  }
+
+  for (const auto& computation : computations)
+  {
+    if (computation.text == text)
+      return 0xe000 | (computation.bits << 6) | (dest << 3) | jump;
+  }
+
+  error("Unknown computation", text);
+}
+
+void HackAssembler::add(const vector<AsmLine>& lines)
+{
+  for (const auto& line : lines)
+  {
+    if (line.type == L_COMMENT)
+      continue;
+
+    string_view text = trim(line.text);
+
+    if (text.empty())
+      continue;
+
+    if (line.type == L_LABEL)
+    {
+      if (text.back() != ')')
+        error("Malformed label", text);
+
+      int& value = symbolValues[intern(text.substr(1, text.size() - 2))];
+
+      if (value != UNDEFINED)
+        error("Duplicate label", text);
+
+      value = static_cast<int>(code.size());
+    }
+    else if (text[0] == '@')
+    {
+      string_view target = text.substr(1);
+
+      if ((target.size() > 0) && isdigit(static_cast<unsigned char>(target[0])))
+      {
+        unsigned long value = strtoul(string(target).c_str(), nullptr, 10);
+
+        if (value > 0x7fff)
+          error("Constant too large", text);
+
+        code.push_back(static_cast<uint16_t>(value));
+      }
+      else
+      {
+        size_t symbol = intern(target);
+
+        // Labels seen so far are known; the rest wait for resolve()
+        if (symbolValues[symbol] == UNDEFINED)
+          fixups.push_back(Fixup{code.size(), symbol});
+
+        code.push_back(static_cast<uint16_t>(symbolValues[symbol] & 0x7fff));
+      }
+    }
+    else
+    {
+      code.push_back(encodeCInstruction(text));
+    }
+  }
+}
+
+void HackAssembler::resolve()
+{
+  int nextVariable = FIRST_VARIABLE;
+
+  for (const auto& fixup : fixups)
+  {
+    int& value = symbolValues[fixup.symbol];
+
+    if (value == UNDEFINED)
+      value = nextVariable++;
+
+    code[fixup.address] = static_cast<uint16_t>(value);
+  }
+
+  if (code.size() > 0x8000)
+  {
+    cerr << "Warning: program of " << code.size()
+         << " instructions exceeds the 32K ROM" << endl;
+  }
+}
+
+size_t HackAssembler::writeHack(ofstream& outfile) const
+{
+  string text;
+  text.reserve(code.size() * 17);
+
+  for (uint16_t instruction : code)
+  {
+    for (int bit = 15; bit >= 0; bit--)
+      text += (instruction & (1 << bit)) ? '1' : '0';
+
+    text += '\n';
+  }
+
+  outfile.write(text.data(), text.size());
+  outfile.flush();
+
+  return text.size();
+}
+
+size_t HackAssembler::writeImage(ofstream& outfile) const
+{
+  string image;
+  image.reserve(code.size() * 2);
+
+  for (uint16_t instruction : code)
+  {
+    image += static_cast<char>(instruction >> 8);
+    image += static_cast<char>(instruction & 0xff);
+  }
+
+  outfile.write(image.data(), image.size());
+  outfile.flush();
+
+  return image.size();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "asm_buffer.h"
+
+/* HackAssembler - Encodes generated assembly into Hack machine code     */
+/*                 without an intermediate .asm file.                    */
+/*                                                                       */
+/*                 First pass: add() encodes each instruction as it is   */
+/*                 flushed from the AsmBuffer and records the address of */
+/*                 each label.  A-instructions naming a symbol are left  */
+/*                 as fixups.                                            */
+/*                                                                       */
+/*                 Second pass: resolve() patches the fixups with label  */
+/*                 addresses, allocating variables from RAM[16] in the   */
+/*                 order they are first used, as the assembler does.     */
+class HackAssembler {
+  static constexpr int UNDEFINED = -1;
+  static constexpr int FIRST_VARIABLE = 16;
+
+  struct Fixup {
+    size_t address;               // in `code`
+    size_t symbol;                // index in `symbolValues`
+  };
+
+  std::vector<uint16_t> code;
+  std::vector<Fixup> fixups;
+  std::deque<std::string> symbolNames;
+  std::unordered_map<std::string_view, size_t> symbolIndex;
+  std::vector<int> symbolValues;
+
+  size_t intern(std::string_view name);
+  uint16_t encodeCInstruction(std::string_view text) const;
+  [[noreturn]] void error(const char* what, std::string_view text) const;
+
+public:
+
+  HackAssembler();
+
+  // First pass over `lines`, which follow those of any earlier call
+  void add(const std::vector<AsmLine>& lines);
+
+  // Second pass: resolve all symbols.  Called once after the last add().
+  void resolve();
+
+  const std::vector<uint16_t>& machineCode() const { return code; }
+
+  // Write each instruction as a line of 16 '0'/'1' characters.  Returns
+  // the number of bytes written.
+  size_t writeHack(std::ofstream& outfile) const;
+
+  // Write the raw 16-bit image, most significant byte first.  Returns the
+  // number of bytes written.
+  size_t writeImage(std::ofstream& outfile) const;
+};
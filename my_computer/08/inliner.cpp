@@ -0,0 +1,465 @@
+#include "inliner.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+const int TEMP_COUNT = 8;
+
+// A function that may be inlined and what its call sites need to know
+struct Candidate {
+  string_view name;
+  const VmModule* module;
+  int localCount = 0;
+  vector<VmCommand> body;       // the commands of every block in order
+  bool setsPointer[2] = {};
+  int argumentCount = 0;        // highest argument used + 1
+};
+
+vector<VmCommand> flatten(const VmFunction& function)
+{
+  vector<VmCommand> commands;
+
+  for (const auto& block : function.blocks)
+    commands.insert(commands.end(), block.commands.begin(), block.commands.end());
+
+  return commands;
+}
+
+// Does every path through `body` stay above the stack it was given and
+// return with exactly one value on it?  Jumps must stay within the body
+// and go forward: the call of a loop costs little next to the loop, and
+// a function that may never return, such as Sys.halt, is best left where
+// tools look for it.
+bool hasBalancedStack(const vector<VmCommand>& body)
+{
+  bool returns = false;
+
+  unordered_map<string_view, size_t> labels;
+
+  for (size_t i = 0; i < body.size(); i++)
+  {
+    if (body[i].type == C_LABEL)
+      labels[body[i].name] = i;
+  }
+
+  // Depth of the stack before each command, -1 until reached
+  vector<int> depth(body.size(), -1);
+  vector<size_t> worklist;
+
+  auto reach = [&](size_t i, int d) {
+    // Running off the end of the function
+    if (i >= body.size())
+      return false;
+
+    if (depth[i] < 0)
+    {
+      depth[i] = d;
+      worklist.push_back(i);
+      return true;
+    }
+
+    return depth[i] == d;
+  };
+
+  if (!reach(0, 0))
+    return false;
+
+  while (!worklist.empty())
+  {
+    size_t i = worklist.back();
+    worklist.pop_back();
+
+    const VmCommand& cmd = body[i];
+    int d = depth[i];
+    int needed = 0;
+    int change = 0;
+
+    switch (cmd.type)
+    {
+      case C_PUSH:
+        change = 1;
+        break;
+      case C_POP:
+      case C_IF_GOTO:
+        needed = 1;
+        change = -1;
+        break;
+      case C_ARITHMETIC:
+        if ((cmd.arithmetic == A_NEG) || (cmd.arithmetic == A_NOT))
+        {
+          needed = 1;
+        }
+        else
+        {
+          needed = 2;
+          change = -1;
+        }
+        break;
+      case C_LABEL:
+      case C_GOTO:
+        break;
+      case C_RETURN:
+        if (d != 1)
+          return false;
+        returns = true;
+        continue;
+      default:
+        return false;
+    }
+
+    if (d < needed)
+      return false;
+
+    if ((cmd.type == C_GOTO) || (cmd.type == C_IF_GOTO))
+    {
+      auto target = labels.find(cmd.name);
+
+      if ((target == labels.end()) || (target->second < i) ||
+          !reach(target->second, d + change))
+      {
+        return false;
+      }
+    }
+
+    if ((cmd.type != C_GOTO) && !reach(i + 1, d + change))
+      return false;
+  }
+
+  return returns;
+}
+
+bool findCandidate(const VmModule& module, const VmFunction& function,
+    size_t maxCommands, Candidate& candidate)
+{
+  candidate.name = function.name();
+  candidate.module = &module;
+  candidate.localCount = function.localCount();
+  candidate.body = flatten(function);
+
+  if (candidate.body.empty() || (candidate.body.size() > maxCommands))
+    return false;
+
+  for (const auto& cmd : candidate.body)
+  {
+    if (cmd.type == C_CALL)
+      return false;
+
+    if ((cmd.type != C_PUSH) && (cmd.type != C_POP))
+      continue;
+
+    if (cmd.segment == S_ARGUMENT)
+      candidate.argumentCount = max(candidate.argumentCount, cmd.index + 1);
+    else if ((cmd.segment == S_LOCAL) && (cmd.index >= candidate.localCount))
+      return false;
+    else if ((cmd.segment == S_POINTER) && (cmd.type == C_POP))
+      candidate.setsPointer[cmd.index != 0] = true;
+  }
+
+  return hasBalancedStack(candidate.body);
+}
+
+// Mark the temp registers any function of `modules` uses in `used`.  A
+// temp may hold a value across a call, so one that a function leaves
+// alone can still be live in a function further up the call chain.
+void findUsedTemps(const vector<VmModule>& modules, bool used[TEMP_COUNT])
+{
+  for (const auto& module : modules)
+  {
+    for (const auto& function : module.functions)
+    {
+      for (const auto& block : function.blocks)
+      {
+        for (const auto& cmd : block.commands)
+        {
+          if (((cmd.type == C_PUSH) || (cmd.type == C_POP)) &&
+              (cmd.segment == S_TEMP) && (cmd.index < TEMP_COUNT))
+          {
+            used[cmd.index] = true;
+          }
+        }
+      }
+    }
+  }
+}
+
+// Temp registers for the arguments, locals and saved pointers of a call
+// with `nargs` arguments, in that order, from those no function of the
+// program uses (`usedTemps`).  Empty if there are too few.
+vector<int> allocateTemps(const Candidate& candidate, int nargs,
+    const bool usedTemps[TEMP_COUNT])
+{
+  size_t needed = nargs + candidate.localCount + candidate.setsPointer[0] +
+                  candidate.setsPointer[1];
+  vector<int> temps;
+
+  for (int i = 0; (i < TEMP_COUNT) && (temps.size() < needed); i++)
+  {
+    if (!usedTemps[i])
+      temps.push_back(i);
+  }
+
+  if (temps.size() < needed)
+    temps.clear();
+
+  return temps;
+}
+
+bool canInline(const Candidate& candidate, const VmCommand& call,
+    const bool usedTemps[TEMP_COUNT])
+{
+  if (call.index < candidate.argumentCount)
+    return false;
+
+  size_t needed = call.index + candidate.localCount +
+                  candidate.setsPointer[0] + candidate.setsPointer[1];
+
+  return (needed == 0) ||
+         !allocateTemps(candidate, call.index, usedTemps).empty();
+}
+
+// Append the body of `candidate` in place of `call` in `caller`, taking
+// temps outside of `usedTemps`.  `site` makes its labels unique.
+void expandCall(const Candidate& candidate, const VmCommand& call, size_t site,
+    VmModule& caller, const bool usedTemps[TEMP_COUNT],
+    vector<VmCommand>& commands)
+{
+  deque<string>& names = caller.names;
+
+  vector<int> temps = allocateTemps(candidate, call.index, usedTemps);
+  size_t nextTemp = 0;
+  int argumentTemps[TEMP_COUNT];
+  int localTemps[TEMP_COUNT];
+  int pointerTemps[2] = {-1, -1};
+
+  for (int i = 0; i < call.index; i++)
+    argumentTemps[i] = temps[nextTemp++];
+
+  for (int i = 0; i < candidate.localCount; i++)
+    localTemps[i] = temps[nextTemp++];
+
+  for (int i = 0; i < 2; i++)
+  {
+    if (candidate.setsPointer[i])
+      pointerTemps[i] = temps[nextTemp++];
+  }
+
+  auto add = [&](Command_t type, Segment_t segment, int index) {
+    VmCommand cmd;
+    cmd.type = type;
+    cmd.segment = segment;
+    cmd.index = index;
+    cmd.lineNumber = call.lineNumber;
+    cmd.sourceLine = call.sourceLine;
+    commands.push_back(cmd);
+  };
+
+  // "Callee$3" ends the body and "Callee$3$LABEL" replaces each label
+  string prefix = string(candidate.name) + "$" + to_string(site);
+  string_view endLabel = names.emplace_back(prefix);
+  bool endLabelUsed = false;
+
+  for (int i = 0; i < 2; i++)
+  {
+    if (candidate.setsPointer[i])
+    {
+      add(C_PUSH, S_POINTER, i);
+      add(C_POP, S_TEMP, pointerTemps[i]);
+    }
+  }
+
+  for (int i = call.index - 1; i >= 0; i--)
+    add(C_POP, S_TEMP, argumentTemps[i]);
+
+  for (int i = 0; i < candidate.localCount; i++)
+  {
+    add(C_PUSH, S_CONSTANT, 0);
+    add(C_POP, S_TEMP, localTemps[i]);
+  }
+
+  for (size_t i = 0; i < candidate.body.size(); i++)
+  {
+    VmCommand cmd = candidate.body[i];
+    cmd.lineNumber = call.lineNumber;
+    cmd.sourceLine = call.sourceLine;
+
+    if ((cmd.type == C_PUSH) || (cmd.type == C_POP))
+    {
+      if (cmd.segment == S_ARGUMENT)
+      {
+        cmd.segment = S_TEMP;
+        cmd.index = argumentTemps[cmd.index];
+      }
+      else if (cmd.segment == S_LOCAL)
+      {
+        cmd.segment = S_TEMP;
+        cmd.index = localTemps[cmd.index];
+      }
+      else if ((cmd.segment == S_STATIC) && (&caller != candidate.module) &&
+               cmd.file.empty())
+      {
+        // Still the variable of the function's own file
+        cmd.file = candidate.module->stem;
+      }
+    }
+    else if ((cmd.type == C_LABEL) || (cmd.type == C_GOTO) ||
+             (cmd.type == C_IF_GOTO))
+    {
+      cmd.name = names.emplace_back(prefix + "$" + string(cmd.name));
+    }
+    else if (cmd.type == C_RETURN)
+    {
+      // The last return falls through to the end
+      if (i + 1 == candidate.body.size())
+        continue;
+
+      cmd.type = C_GOTO;
+      cmd.name = endLabel;
+      endLabelUsed = true;
+    }
+
+    commands.push_back(cmd);
+  }
+
+  if (endLabelUsed || (candidate.body.back().type != C_RETURN))
+  {
+    VmCommand label;
+    label.type = C_LABEL;
+    label.name = endLabel;
+    label.lineNumber = call.lineNumber;
+    label.sourceLine = call.sourceLine;
+    commands.push_back(label);
+  }
+
+  for (int i = 0; i < 2; i++)
+  {
+    if (candidate.setsPointer[i])
+    {
+      add(C_PUSH, S_TEMP, pointerTemps[i]);
+      add(C_POP, S_POINTER, i);
+    }
+  }
+}
+
+// Commands a call with `nargs` arguments grows to when inlined
+size_t expandedSize(const Candidate& candidate, int nargs)
+{
+  int saved = candidate.setsPointer[0] + candidate.setsPointer[1];
+
+  return nargs + 2 * candidate.localCount + 4 * saved +
+         candidate.body.size();
+}
+
+}  // namespace
+
+vector<InlinedFunction> inlineLeafFunctions(vector<VmModule>& modules,
+    size_t maxCommands, size_t budget)
+{
+  vector<Candidate> candidates;
+
+  for (const auto& module : modules)
+  {
+    for (const auto& function : module.functions)
+    {
+      Candidate candidate;
+
+      if ((function.entry.type == C_FUNCTION) &&
+          findCandidate(module, function, maxCommands, candidate))
+      {
+        candidates.push_back(move(candidate));
+      }
+    }
+  }
+
+  // The smallest bodies save the most per command added
+  stable_sort(candidates.begin(), candidates.end(),
+      [](const Candidate& a, const Candidate& b) {
+        return a.body.size() < b.body.size();
+      });
+
+  // The temps of the program as written.  Those an expansion takes are
+  // dead outside of it, the body making no calls, so every expansion
+  // may share them.
+  bool usedTemps[TEMP_COUNT] = {};
+  findUsedTemps(modules, usedTemps);
+
+  vector<InlinedFunction> inlined;
+  size_t added = 0;
+
+  // Sites are numbered per module, so that a module's translation depends
+  // only on the functions inlined into it
+  vector<size_t> sitesInModule(modules.size(), 0);
+
+  for (const auto& candidate : candidates)
+  {
+    size_t sites = 0;
+    size_t growth = 0;
+
+    for (const auto& module : modules)
+    {
+      for (const auto& function : module.functions)
+      {
+        for (const auto& block : function.blocks)
+        {
+          for (const auto& cmd : block.commands)
+          {
+            if ((cmd.type == C_CALL) && (cmd.name == candidate.name) &&
+                canInline(candidate, cmd, usedTemps))
+            {
+              sites++;
+              growth += expandedSize(candidate, cmd.index) - 1;
+            }
+          }
+        }
+      }
+    }
+
+    if ((sites == 0) || (added + growth > budget))
+      continue;
+
+    added += growth;
+
+    for (size_t m = 0; m < modules.size(); m++)
+    {
+      VmModule& module = modules[m];
+
+      for (auto& function : module.functions)
+      {
+        vector<VmBlock> blocks;
+        bool changed = false;
+
+        for (const auto& cmd : flatten(function))
+        {
+          if ((cmd.type == C_CALL) && (cmd.name == candidate.name) &&
+              canInline(candidate, cmd, usedTemps))
+          {
+            vector<VmCommand> body;
+            expandCall(candidate, cmd, sitesInModule[m]++, module,
+                       usedTemps, body);
+
+            for (const auto& inlinedCmd : body)
+              appendCommand(blocks, inlinedCmd);
+
+            changed = true;
+          }
+          else
+          {
+            appendCommand(blocks, cmd);
+          }
+        }
+
+        if (changed)
+          function.blocks = move(blocks);
+      }
+    }
+
+    inlined.push_back(
+        {candidate.name, candidate.module->stem, candidate.body, sites});
+  }
+
+  return inlined;
+}
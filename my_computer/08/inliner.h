@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "vm_ir.h"
+
+/* InlinedFunction - One function whose body replaced its calls */
+struct InlinedFunction {
+  std::string_view name;
+  std::string_view file;      // stem of the .vm file defining it
+  std::vector<VmCommand> body;
+  size_t sites = 0;           // calls replaced
+};
+
+// Replace the calls of small leaf functions with their bodies.  A function
+// is inlined when it
+//   - makes no calls and has at most `maxCommands` commands,
+//   - and leaves exactly its return value on the stack at every return.
+// Its arguments and locals move to temp registers that no function of
+// the program uses, the call being skipped when too few are left, and the pointers it sets are saved and restored as a return
+// would.  Its statics remain those of its own file.
+//
+// Functions are taken smallest first while the commands they add to the
+// program stay within `budget`.  Returns the functions inlined, in that
+// order.  The functions themselves are kept; dead function elimination
+// removes those left without a call.
+std::vector<InlinedFunction> inlineLeafFunctions(
+    std::vector<VmModule>& modules, size_t maxCommands, size_t budget);
@@ -1,14 +1,21 @@
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
-#include <list>
 #include <libgen.h>
+#include <memory>
 #include <set>
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #ifdef CPP17_LATER
 # include <filesystem>
@@ -16,6 +23,20 @@
 # include <dirent.h>
 #endif
 
+#include "asm_buffer.h"
+#include "call_graph.h"
+#include "constant_folding.h"
+#include "hack_assembler.h"
+#include "inliner.h"
+#include "ngram_profile.h"
+#include "parser.h"
+#include "peephole.h"
+#include "source_map.h"
+#include "static_layout.h"
+#include "superinstructions.h"
+#include "translation_cache.h"
+#include "vm_ir.h"
+
 #ifndef NDEBUG
 # define ASSERT(condition, message) \
     do { \
@@ -29,509 +50,569 @@
 # define ASSERT(condition, message) do { } while (false)
 #endif
 
-
-// TODO: Add metrics.
-
 // R13-R15 GP registers
 
 using namespace std;
 
-typedef enum {
-  C_NONE,
-  C_ARITHMETIC,
-  C_PUSH,
-  C_POP,
-  C_LABEL,
-  C_GOTO,
-  C_IF_GOTO,
-  C_FUNCTION,
-  C_CALL,
-  C_RETURN,
-} Command_t;
-
-/* Parser - Handles the parsing of a single .vm file     */
-/*          Reads VM cmmands, parses them, and provides  */
-/*          access to their components.  All white space */
-/*          and comments are removed.                    */
-class Parser {
-  string currentLine;
-  list<string> allLinesInFile;
-  list<int> allLineNumbers;
-  list<string> commandAndArguments; // list: cmd type, arg1, arg2
-  int commandLineNumber;
-
-public:
-
-  // Open the input file and get ready to parse it
-  Parser(string pathname) : commandLineNumber(0)
-  {
-    ifstream infile;
-
-    infile.open(pathname, ios::in);
-
-    if (!infile.is_open())
-    {
-      cerr << "Failed to open input file, " << pathname << endl;
-      exit(-2);
-    }
+// Command line selectable behavior of the translator
+struct TranslatorOptions {
+  bool showStats = false;         // -s: report output throughput
+  unsigned int jobs = 1;          // -j: number of translation threads
+  bool sharedCallReturn = false;  // -fshared-calls: use $$CALL/$$RETURN
+  bool peephole = false;          // -fpeephole: rewrite instruction patterns
+  bool deadFunctions = false;     // -fdce: drop functions Sys.init never calls
+  bool superinstructions = false; // -fsuperinstructions: fuse common idioms
+  bool cacheTop = false;          // -fcache-top: keep the stack top in D
+  bool sharedCompare = false;     // -fshared-compare: use $$EQ/$$LT/$$GT
+  size_t inlineLimit = 0;         // -finline[=N]: inline leaf functions
+  bool foldConstants = false;     // -ffold-constants: evaluate constant code
+  bool shortOffsets = false;      // -fshort-offsets: address small indexes by A=M+1
+  bool compactFrames = false;     // -fcompact-frames: shorter call and function entry
+  bool packStatics = false;       // -fpack-statics: place statics in RAM here
+  bool tailCalls = false;         // -ftail-calls: reuse the frame for call; return
+  bool machineCode = false;       // -b: write .hack and .bin, not .asm
+  bool sourceMap = false;         // -m: write the ROM addresses of each line
+  size_t profileTop = 0;          // -p N: report frequent command sequences
+  string cacheDirectory;          // -c DIR: reuse unchanged translations
+};
 
-    int currentLineNumber = 0;
+// Default -finline limit on the commands of a function
+const size_t INLINE_LIMIT = 12;
 
-    // Read the entire file into the list `allLinesInFile` to make
-    // detection of EOF a little less cumbersome.
-    while (!infile.eof())
-    {
-      string line;
+// VM commands that -finline may add to a program
+const size_t INLINE_BUDGET = 1000;
 
-      getline(infile, line);
-      currentLineNumber++;
+// Largest local/argument/this/that index that -fshort-offsets reaches by
+// incrementing A.  Index 3 takes as many instructions as adding it to the
+// base in D, but leaves D free.
+const int MAX_SHORT_OFFSET = 3;
 
-      // trim all leading whitespace
-      const auto start = line.find_first_not_of(" \t");
+/* CodeWriter - Translates VM commands into Hack assembly code. */
+/*            Output accumulates in memory until flushTo() so that */
+/*            each input file may be translated by its own writer. */
+class CodeWriter {
+  AsmBuffer out;
+  TranslatorOptions options;
+  unsigned int branchNumber = 0;
+  string currentInputFilenameStem = "unset";
+  string_view staticStem;    // names the statics of the command being written
+  const StaticLayout* staticLayout = nullptr;   // with options.packStatics
+  string currentFunction = "anonymous";
+  string_view sourceFunction;   // of the commands written, for the source map
+  bool inFunction = false;
+  bool sharedRoutinesUsed = false;
 
-      if (start == string::npos)
-        continue;
+  // With options.cacheTop, the top of the stack may be held in D instead
+  // of RAM[SP-1].  SP then counts only the values below it.
+  bool topInD = false;
 
-      // ignore line if first two characters are '//'
-      if (line.substr(0, 2) == "//")
-        continue;
+  set<string> fileLabels;
+  int anonymousLabelCounter = 0;
+  int returnLabelCounter = 0;
 
-      // drop ending CRLF character
-      if (line.substr(line.length() - 1, 1) == "\r")
-        line = line.substr(start, line.length() - 1);
+  // Use for branching labels.  Labels are scoped to the function that
+  // declares them (see section 8.2.1), written as `function$label`.
+  // Labels of commands outside of any function are left unchanged.
+  struct ScopedLabel {
+    string_view function;
+    string_view label;
+  };
 
-      // ignore empty lines
-      if (line.substr(0, 1) == "")
-        continue;
+  ScopedLabel getLabel(string_view label)
+  {
+      assert(!label.empty());
 
-      allLinesInFile.push_back(line);
-      allLineNumbers.push_back(currentLineNumber);
-    }
+      if (!inFunction)
+        return ScopedLabel{string_view(), label};
 
-    infile.close();
+      return ScopedLabel{currentFunction, label};
   }
 
-  // Are there more commands in the input?
-  bool hasMoreCommands()
+  friend AsmBuffer& operator<<(AsmBuffer& buffer, const ScopedLabel& label)
   {
-    return !allLinesInFile.empty();
+    if (!label.function.empty())
+      buffer << label.function << "$";
+
+    return buffer << label.label;
   }
 
-  // Reads the next command from the input file and makes it the
-  // current command.  Should be called only if hasMoreCommands() is true.
-  // Initially there is no current command.
-  void advance()
+  string newLabel(string_view label)
   {
-    assert(hasMoreCommands());
+      ScopedLabel scopedLabel = getLabel(label);
+      string newLabel(scopedLabel.function);
 
-    auto currentLine = allLinesInFile.front();
-    commandLineNumber = allLineNumbers.front();
+      if (!newLabel.empty())
+        newLabel += "$";
 
-#ifdef NONO
-    // TODO: make smarter - don't transform labels of function names
-    transform(currentLine.begin(), currentLine.end(), currentLine.begin(),
-        ::tolower);
-#endif
-
-    // Process and tokenize the line into the
-    commandAndArguments.clear();
+      newLabel += scopedLabel.label;
 
-    // For each space separated word, accumulate the word into `acc`.
-    // Once a word is identified, add it to the list `commandAndArguments`
-    string acc = "";
-    for (const char& c : currentLine)
-    {
-      if (c == ' ')
-      {
-        commandAndArguments.push_back(acc);
-        acc = "";
-      }
-      else
+      if (fileLabels.find(newLabel) != fileLabels.end())
       {
-        acc = acc + c;
+          cerr << "Duplicate label: " << newLabel << endl;
+          exit(-1);
       }
-    }
 
-    commandAndArguments.push_back(acc);
+      fileLabels.insert(newLabel);
 
-    allLinesInFile.pop_front();
-    allLineNumbers.pop_front();
+      return newLabel;
   }
 
-  // Returns the type of the current VM command.  C_ARITHMETIC is returned
-  // for all the arithmetic commands.
-  Command_t commandType()
+  // Use for call return labels.  The label is written in pieces to
+  // avoid building a string per call.
+  struct ReturnLabel {
+    string_view function;
+    int number;
+  };
+
+  ReturnLabel createReturnLabel()
   {
-    string command = commandAndArguments.front();
-  
-    if (command == "push")     return C_PUSH;
-    if (command == "pop")      return C_POP;
-    if (command == "eq")       return C_ARITHMETIC;
-    if (command == "lt")       return C_ARITHMETIC;
-    if (command == "gt")       return C_ARITHMETIC;
-    if (command == "add")      return C_ARITHMETIC;
-    if (command == "sub")      return C_ARITHMETIC;
-    if (command == "neg")      return C_ARITHMETIC;
-    if (command == "and")      return C_ARITHMETIC;
-    if (command == "or")       return C_ARITHMETIC;
-    if (command == "not")      return C_ARITHMETIC;
-    if (command == "label")    return C_LABEL;
-    if (command == "if-goto")  return C_IF_GOTO;
-    if (command == "goto")     return C_GOTO;
-    if (command == "function") return C_FUNCTION;
-    if (command == "return")   return C_RETURN;
-    if (command == "call")     return C_CALL;
-
-    ASSERT(0, string("Unsupported command: ") + command);
-
-    return C_NONE;
+    return ReturnLabel{currentFunction, returnLabelCounter++};
   }
 
-  // Returns the first argument of the current command.  In case of
-  // C_ARITHMETIC, the command itself (add, sub, etc.) is returned.
-  // Should not be called if the current command is C_RETURN.
-  string arg1()
+  friend AsmBuffer& operator<<(AsmBuffer& buffer, const ReturnLabel& label)
   {
-    Command_t cmdType = commandType();
-
-    assert(cmdType != C_RETURN);
-
-    auto itr = commandAndArguments.begin();
-
-    if (cmdType == C_ARITHMETIC)
-    {
-      string command = *itr;
-
-      return command;
-    }
-
-    itr++;
-
-    if ((cmdType == C_LABEL) || (cmdType == C_IF_GOTO) || (cmdType == C_GOTO) ||
-        (cmdType == C_FUNCTION) || (cmdType == C_CALL))
-    {
-      string label = *itr;
-
-#ifdef NONO
-      // Make all labels upper case
-      transform(label.begin(), label.end(), label.begin(), ::toupper);
-#endif
-
-      return label;
-    }
-
-    if ((cmdType == C_PUSH) || (cmdType == C_POP))
-    {
-      string argument = *itr;
-
-      return argument;
-    }
-
-    assert(0);
-
-    return "";
+    return buffer << label.function << "$ret." << label.number;
   }
 
-  // Returns the second argument of the current command.  Should be called
-  // only if the current command is C_PUSH, C_POP, C_FUNCTION,
-  // or C_CALL.
-  int args()
+  // Push LCL, ARG, THIS and THAT of the caller
+  void writeSaveFrame()
   {
-    Command_t cmdType = commandType();
-
-    assert((cmdType == C_PUSH) || (cmdType == C_POP) ||
-        (cmdType == C_FUNCTION) || (cmdType == C_CALL));
-
-    auto itr = commandAndArguments.begin();
-    itr++;
-    itr++;
-
-    string argument = *itr;
-    int value;
-
-    value = stoi(argument, nullptr);
-
-    return value;
+    // push LCL
+    out << "@LCL" << '\n';
+    out << "D=M" << '\n';
+    out << "@SP" << '\n';
+    out << "AM=M+1" << '\n';
+    out << "A=A-1" << '\n';
+    out << "M=D" << '\n';
+
+    // push ARG
+    out << "@ARG" << '\n';
+    out << "D=M" << '\n';
+    out << "@SP" << '\n';
+    out << "AM=M+1" << '\n';
+    out << "A=A-1" << '\n';
+    out << "M=D" << '\n';
+
+    // push THIS
+    out << "@THIS" << '\n';
+    out << "D=M" << '\n';
+    out << "@SP" << '\n';
+    out << "AM=M+1" << '\n';
+    out << "A=A-1" << '\n';
+    out << "M=D" << '\n';
+
+    // push THAT
+    out << "@THAT" << '\n';
+    out << "D=M" << '\n';
+    out << "@SP" << '\n';
+    out << "AM=M+1" << '\n';
+    out << "A=A-1" << '\n';
+    out << "M=D" << '\n';
   }
 
-  int lineNumber()
+  // Restore the caller's frame and jump to the return address
+  void writeReturnSequence(int lineNumber)
   {
-    return commandLineNumber;
+    // R13 - LCL
+    // R14 - Return Address
+
+    // R13 = LCL - Save LCL (endFrame) to temporary register
+    out << "// " << lineNumber << ": R13 = FRAME = LCL" << '\n';
+    out << "@LCL" << '\n';
+    out << "D=M" << '\n';
+    out << "@R13" << '\n';
+    out << "M=D" << '\n';
+    // R14 = *(endFrame - 5) = *(R13 - 5) - Save return address in R14
+    out << "// " << lineNumber << ": R14 = RET = *(FRAME-5)" << '\n';
+    out << "@R13" << '\n';
+    out << "D=M" << '\n';
+    out << "@5" << '\n';
+    out << "A=D-A" << '\n';
+    out << "D=M" << '\n';
+    out << "@R14" << '\n';
+    out << "M=D" << '\n';
+    // *ARG = pop() - Reposition the return value for caller
+    out << "// " << lineNumber << ": *ARG = pop()" << '\n';
+    writePushPop(lineNumber, C_POP, S_ARGUMENT, 0); // trashes R15
+    // SP = ARG+1 - Restore SP of caller
+    out << "// " << lineNumber << ": SP = ARG+1" << '\n';
+    out << "@ARG" << '\n';
+    out << "AD=M+1" << '\n';
+    out << "@SP" << '\n';
+    out << "M=D" << '\n';
+    // THAT = *(R13 - 1) - Restore THAT of caller
+    out << "// " << lineNumber << ": THAT = *(FRAME-1)" << '\n';
+    out << "@R13" << '\n';
+    out << "A=M" << '\n';
+    out << "A=A-1" << '\n';
+    out << "D=M" << '\n';
+    out << "@THAT" << '\n';
+    out << "M=D" << '\n';
+    // THIS = *(R13 - 2) - Restore THIS of caller
+    out << "// " << lineNumber << ": THIS = *(FRAME-2)" << '\n';
+    out << "@R13" << '\n';
+    out << "A=M" << '\n';
+    out << "A=A-1" << '\n';
+    out << "A=A-1" << '\n';
+    out << "D=M" << '\n';
+    out << "@THIS" << '\n';
+    out << "M=D" << '\n';
+    // ARG = *(R13 - 3) - Restore ARG of caller
+    out << "// " << lineNumber << ": ARG = *(FRAME-3)" << '\n';
+    out << "@R13" << '\n';
+    out << "D=M" << '\n';
+    out << "@3" << '\n';
+    out << "A=D-A" << '\n';
+    out << "D=M" << '\n';
+    out << "@ARG" << '\n';
+    out << "M=D" << '\n';
+    // LCL = *(R13 - 4) - Restore LCL of caller
+    out << "// " << lineNumber << ": LCL = *(FRAME-4)" << '\n';
+    out << "@R13" << '\n';
+    out << "D=M" << '\n';
+    out << "@4" << '\n';
+    out << "A=D-A" << '\n';
+    out << "D=M" << '\n';
+    out << "@LCL" << '\n';
+    out << "M=D" << '\n';
+    // goto RET (R14)
+    out << "// " << lineNumber << ": goto RET/R14" << '\n';
+    out << "@R14" << '\n';
+    out << "A=M" << '\n';
+    out << "0;JMP" << '\n';
   }
-};
 
-/* CodeWriter - Translates VM commands into Hack assembly code. */
-class CodeWriter {
-  ofstream outfile;
-  unsigned int branchNumber = 0;
-  const string outputFilenameStem = "unknown";
-  const string outputFilename = "unknown";
-  string currentInputFilenameStem = "unset";
-  string currentFunction = "anonymous";
-  set<string> fileLabels;
-  int anonymousLabelCounter = 0;
-  int returnLabelCounter = 0;
+public:
 
-  string getLabel(string label)
+  CodeWriter(const TranslatorOptions& translatorOptions) :
+    options(translatorOptions)
   {
-      string newLabel;
+  }
 
-      // Use for call return labels
-      if (label == "")
-      {
-          anonymousLabelCounter++;
-          assert(0);
-          newLabel = string(currentFunction) + "$ret." + to_string(anonymousLabelCounter);
-      }
-      // Use for branching labels
-      else
-      {
-          newLabel = label;
-      }
+  // Write everything translated so far to the output file.  Called at
+  // input file boundaries rather than per instruction.
+  void flushTo(ofstream& outfile)
+  {
+    out.flushTo(outfile);
+  }
 
-      return newLabel;
+  void flushTo(HackAssembler& assembler)
+  {
+    out.flushTo(assembler);
   }
 
-  string newLabel(string label)
+  // Add where the code translated since the last flush comes from to
+  // `map`, its first instruction being at ROM address `address`.  Returns
+  // the address after it.
+  size_t mapSources(SourceMap& map, size_t address) const
   {
-      string newLabel = getLabel(label);
+    return out.mapSources(map, address);
+  }
 
-      if (fileLabels.find(newLabel) != fileLabels.end())
-      {
-          cerr << "Duplicate label: " << newLabel << endl;
-          exit(-1);
-      }
+  // Address statics as `layout` places them, which must outlive the writer
+  void useStaticLayout(const StaticLayout* layout)
+  {
+    staticLayout = layout;
+  }
 
-      fileLabels.insert(newLabel);
+  size_t bytesWritten() const { return out.bytes(); }
+  size_t instructionsWritten() const { return out.instructions(); }
 
-      return newLabel;
-  }
+  // Instructions translated since the last flush
+  size_t instructionsPending() const { return out.pendingInstructions(); }
 
-  string createReturnLabel()
+  // Apply the peephole optimizer to everything translated since the last
+  // flush.  Returns the number of instructions removed.
+  size_t optimizePeephole()
   {
-    string newLabel = string(currentFunction) + "$ret." + to_string(returnLabelCounter);
-    returnLabelCounter++;
-
-    return newLabel;
+    return ::optimizePeephole(out);
   }
 
-public:
-
-  CodeWriter(string filenameStem) : outputFilenameStem(filenameStem),
-                                    outputFilename(filenameStem + ".asm")
+  // Everything translated since the last flush, one line per instruction,
+  // label or comment
+  string pendingText() const
   {
-    outfile.open(outputFilename, ofstream::out);
+    string text;
 
-    if (!outfile.is_open())
+    for (const auto& line : out.getLines())
     {
-      cerr << "Failed to open output file, " << outputFilename << endl;
-      exit(-2);
+      text += line.text;
+      text += '\n';
     }
+
+    return text;
   }
 
-  ~CodeWriter()
+  // Append assembly translated by an earlier run, as pendingText()
+  // returned it
+  void writeFragment(string_view fragment)
   {
-    outfile.close();
+    while (!fragment.empty())
+    {
+      size_t end = fragment.find('\n');
+      string_view line = fragment.substr(0, end);
+
+      // A call or return site of the fragment needs the shared routines
+      if (line.substr(0, 3) == "@$$")
+        sharedRoutinesUsed = true;
+
+      out << line << '\n';
+      fragment.remove_prefix(min(end + 1, fragment.size()));
+    }
   }
 
+  // Begin a new input file.  Comparison labels are numbered per file and
+  // qualified by its stem, as are the return labels of calls outside of
+  // any function, so a file translates the same regardless of which files
+  // precede it.
   void setInputFilenameStem(string inputFilenameStem)
   {
     currentInputFilenameStem = inputFilenameStem;
-    outfile << "// File: " << currentInputFilenameStem + ".vm" << endl;
+    currentFunction = currentInputFilenameStem;
+    inFunction = false;
+    branchNumber = 0;
+    returnLabelCounter = 0;
+    out << "// File: " << currentInputFilenameStem + ".vm" << '\n';
   }
 
   void writeInit()
   {
-    outfile << "// Bootstrap code to Sys.init function" << endl << endl;
+    markSource(SourcePosition());
 
-    outfile << "@" << 256 << endl;
-    outfile << "D=A" << endl;
-    outfile << "@SP" << endl;
-    outfile << "M=D" << endl;
+    out << "// Bootstrap code to Sys.init function" << '\n' << '\n';
 
-    outfile << "// For debug, set LCL=-1, ARG=-2, THIS=-3, THAT=-4" << endl;
-    outfile << "D=-1" << endl;
-    outfile << "@LCL" << endl;
-    outfile << "M=D" << endl;
+    out << "@" << 256 << '\n';
+    out << "D=A" << '\n';
+    out << "@SP" << '\n';
+    out << "M=D" << '\n';
 
-    outfile << "D=D-1" << endl;
-    outfile << "@ARG" << endl;
-    outfile << "M=D" << endl;
+    out << "// For debug, set LCL=-1, ARG=-2, THIS=-3, THAT=-4" << '\n';
+    out << "D=-1" << '\n';
+    out << "@LCL" << '\n';
+    out << "M=D" << '\n';
 
-    outfile << "D=D-1" << endl;
-    outfile << "@THIS" << endl;
-    outfile << "M=D" << endl;
+    out << "D=D-1" << '\n';
+    out << "@ARG" << '\n';
+    out << "M=D" << '\n';
 
-    outfile << "D=D-1" << endl;
-    outfile << "@THAT" << endl;
-    outfile << "M=D" << endl;
+    out << "D=D-1" << '\n';
+    out << "@THIS" << '\n';
+    out << "M=D" << '\n';
 
+    out << "D=D-1" << '\n';
+    out << "@THAT" << '\n';
+    out << "M=D" << '\n';
+
+    // A return label of its own, $bootstrap$ret.0, as Jack class and
+    // function names cannot begin with $
+    currentFunction = "$bootstrap";
+    returnLabelCounter = 0;
     writeCall(0, C_CALL, "Sys.init", 0);
   }
 
   // See section 7.2.3 - Memory Access Commands
-  void writeArithmetic(int lineNumber, string command)
+  void writeArithmetic(int lineNumber, Arithmetic_t command)
   {
-    outfile << "// " << lineNumber << ": " << command << endl;
+    out << "// " << lineNumber << ": " << arithmeticName(command) << '\n';
 
     // add/sub - binary
-    if ((command == "add") || (command == "sub") ||
-        (command == "and") || (command == "or"))
+    if ((command == A_ADD) || (command == A_SUB) ||
+        (command == A_AND) || (command == A_OR))
     {
-      string operation;
+      const char* operation = "";
 
-      outfile << "@SP" << endl;
-      outfile << "AM=M-1" << endl;
-      outfile << "D=M" << endl;
-      outfile << "A=A-1" << endl;
+      out << "@SP" << '\n';
+      out << "AM=M-1" << '\n';
+      out << "D=M" << '\n';
+      out << "A=A-1" << '\n';
 
-      if      (command == "add") operation = "M=D+M";
-      else if (command == "sub") operation = "M=M-D";
-      else if (command == "and") operation = "M=D&M";
-      else if (command == "or" ) operation = "M=D|M";
+      if      (command == A_ADD) operation = "M=D+M";
+      else if (command == A_SUB) operation = "M=M-D";
+      else if (command == A_AND) operation = "M=D&M";
+      else if (command == A_OR ) operation = "M=D|M";
 
-      outfile << operation << endl;
+      out << operation << '\n';
     }
 
     // eq/gt/lt - binary
     // output true(-1) if condition true
     // output false(0) if not
-    else if ((command == "eq") || (command == "lt") || (command == "gt"))
+    else if (((command == A_EQ) || (command == A_LT) || (command == A_GT)) &&
+             options.sharedCompare)
     {
       branchNumber++;
 
-      outfile << "@SP" << endl;   // SP' = SP
-      outfile << "AM=M-1" << endl;// SP  = SP'-1
-      outfile << "D=M" << endl;   // D   = *[SP'-1] = *[SP'-2]
-      outfile << "A=A-1" << endl; // A   = SP'-2
-      outfile << "D=M-D" << endl; // D   = *[SP'-2] - *[SP'-1]
-
-      outfile << "@CMP_" << branchNumber << endl;
+      // D = return address
+      out << "@" << currentInputFilenameStem << "$CMP_" << branchNumber << '\n';
+      out << "D=A" << '\n';
 
-      if (command == "eq")
-        outfile << "D;JEQ" << endl;
-      else if (command == "lt")
-        outfile << "D;JLT" << endl;
+      if (command == A_EQ)
+        out << "@$$EQ" << '\n';
+      else if (command == A_LT)
+        out << "@$$LT" << '\n';
       else
-        outfile << "D;JGT" << endl;
+        out << "@$$GT" << '\n';
+
+      out << "0;JMP" << '\n';
+      out << "(" << currentInputFilenameStem << "$CMP_" << branchNumber << ")" << '\n';
+      sharedRoutinesUsed = true;
+    }
+
+    else if ((command == A_EQ) || (command == A_LT) || (command == A_GT))
+    {
+      branchNumber++;
+
+      out << "@SP" << '\n';   // SP' = SP
+      out << "AM=M-1" << '\n';// SP  = SP'-1
+      out << "D=M" << '\n';   // D   = *[SP'-1] = *[SP'-2]
+      out << "A=A-1" << '\n'; // A   = SP'-2
+      out << "D=M-D" << '\n'; // D   = *[SP'-2] - *[SP'-1]
 
-      outfile << "D=0" << endl;
-      outfile << "@JOIN_CMP_" << branchNumber << endl;
-      outfile << "0;JMP" << endl;
-      outfile << "(CMP_" << branchNumber << ")" << endl;
-      outfile << "D=-1" << endl;
-      outfile << "(JOIN_CMP_" << branchNumber << ")" << endl;
+      out << "@" << currentInputFilenameStem << "$CMP_" << branchNumber << '\n';
 
-      outfile << "@SP" << endl;
-      outfile << "A=M-1" << endl; // A = SP-1 = SP'-1-1 = SP'-2
-      outfile << "M=D" << endl;   // *[SP'-2] = D
+      if (command == A_EQ)
+        out << "D;JEQ" << '\n';
+      else if (command == A_LT)
+        out << "D;JLT" << '\n';
+      else
+        out << "D;JGT" << '\n';
+
+      out << "D=0" << '\n';
+      out << "@" << currentInputFilenameStem << "$JOIN_CMP_" << branchNumber << '\n';
+      out << "0;JMP" << '\n';
+      out << "(" << currentInputFilenameStem << "$CMP_" << branchNumber << ")" << '\n';
+      out << "D=-1" << '\n';
+      out << "(" << currentInputFilenameStem << "$JOIN_CMP_" << branchNumber << ")" << '\n';
+
+      out << "@SP" << '\n';
+      out << "A=M-1" << '\n'; // A = SP-1 = SP'-1-1 = SP'-2
+      out << "M=D" << '\n';   // *[SP'-2] = D
     }
 
-    else if ((command == "neg") || (command == "not"))
+    else if ((command == A_NEG) || (command == A_NOT))
     {
-      outfile << "@SP" << endl;
-      outfile << "A=M-1" << endl;
-      outfile << "D=M" << endl;
-      outfile << ((command == "neg") ? "M=-D" : "M=!D") << endl;
+      out << "@SP" << '\n';
+      out << "A=M-1" << '\n';
+      out << "D=M" << '\n';
+      out << ((command == A_NEG) ? "M=-D" : "M=!D") << '\n';
     }
 
     else
     {
-      cerr << command << endl;
+      cerr << arithmeticName(command) << endl;
       assert(0);
     }
   }
 
   // See section 7.2.3 - Memory Access Commands
-  void writePushPop(int lineNumber, Command_t command, string segment,
+  void writePushPop(int lineNumber, Command_t command, Segment_t segment,
       int index)
   {
     if (command == C_PUSH)
     {
-      outfile << "// " << lineNumber << ": push " << segment << " " << index << endl;
+      out << "// " << lineNumber << ": push " << segmentName(segment) << " " << index << '\n';
+
+      if (isShortOffset(segment, index))
+      {
+        // D <-- *(*segment_base + index), the address built in A
+        writeAddress(segment, index);
+        out << "D=M" << '\n';
 
-      if ((segment == "local") || (segment == "argument") ||
-          (segment == "this") || (segment == "that"))
+        // push D onto stack
+        out << "@SP" << '\n';
+        out << "AM=M+1" << '\n';
+        out << "A=A-1" << '\n';
+        out << "M=D" << '\n';
+      }
+      else if ((segment == S_LOCAL) || (segment == S_ARGUMENT) ||
+               (segment == S_THIS) || (segment == S_THAT))
       {
         // D <-- *segment_base + index
-        if (segment == "local")
+        if (segment == S_LOCAL)
         {
-          outfile << "@" << "LCL" << endl;
+          out << "@" << "LCL" << '\n';
         }
-        else if (segment == "argument")
+        else if (segment == S_ARGUMENT)
         {
-          outfile << "@" << "ARG" << endl;
+          out << "@" << "ARG" << '\n';
         }
-        else if (segment == "this")
+        else if (segment == S_THIS)
         {
-          outfile << "@" << "THIS" << endl;
+          out << "@" << "THIS" << '\n';
         }
-        else if (segment == "that")
+        else if (segment == S_THAT)
         {
-          outfile << "@" << "THAT" << endl;
+          out << "@" << "THAT" << '\n';
         }
 
-        outfile << "D=M" << endl;
-        outfile << "@" << index << endl;
-        outfile << "AD=D+A" << endl;
-        outfile << "D=M" << endl;
+        out << "D=M" << '\n';
+        out << "@" << index << '\n';
+        out << "AD=D+A" << '\n';
+        out << "D=M" << '\n';
 
         // push D onto stack
-        outfile << "@SP" << endl;
-        outfile << "AM=M+1" << endl;
-        outfile << "A=A-1" << endl;
-        outfile << "M=D" << endl;
+        out << "@SP" << '\n';
+        out << "AM=M+1" << '\n';
+        out << "A=A-1" << '\n';
+        out << "M=D" << '\n';
+      }
+      else if ((segment == S_CONSTANT) && (index == -1))
+      {
+        // true, as folded from `push constant 0; not`
+        out << "@SP" << '\n';
+        out << "AM=M+1" << '\n';
+        out << "A=A-1" << '\n';
+        out << "M=-1" << '\n';
       }
-      else if (segment == "constant")
+      else if (segment == S_CONSTANT)
       {
-        outfile << "@" << index << endl;
-        outfile << "D=A" << endl;
+        writeConstant(index);
 
         // push D onto stack
-        outfile << "@SP" << endl;
-        outfile << "AM=M+1" << endl;
-        outfile << "A=A-1" << endl;
-        outfile << "M=D" << endl;
+        out << "@SP" << '\n';
+        out << "AM=M+1" << '\n';
+        out << "A=A-1" << '\n';
+        out << "M=D" << '\n';
       }
-      else if (segment == "temp")
+      else if (segment == S_TEMP)
       {
         assert(index <= 8);
 
-        outfile << "@" << "R" << 5 + index << endl;
-        outfile << "D=M" << endl;
+        out << "@" << "R" << 5 + index << '\n';
+        out << "D=M" << '\n';
 
         // push D onto stack
-        outfile << "@SP" << endl;
-        outfile << "AM=M+1" << endl;
-        outfile << "A=A-1" << endl;
-        outfile << "M=D" << endl;
+        out << "@SP" << '\n';
+        out << "AM=M+1" << '\n';
+        out << "A=A-1" << '\n';
+        out << "M=D" << '\n';
       }
-      else if (segment == "static")
+      else if (segment == S_STATIC)
       {
-        outfile << "@" << currentInputFilenameStem << "." << index << endl;
-        outfile << "D=M" << endl;
+        writeStaticAddress(index);
+        out << "D=M" << '\n';
 
         // push D onto stack
-        outfile << "@SP" << endl;
-        outfile << "AM=M+1" << endl;
-        outfile << "A=A-1" << endl;
-        outfile << "M=D" << endl;
+        out << "@SP" << '\n';
+        out << "AM=M+1" << '\n';
+        out << "A=A-1" << '\n';
+        out << "M=D" << '\n';
       }
-      else if (segment == "pointer")
+      else if (segment == S_POINTER)
       {
         assert(index <= 2);
 
-        string selectedRegister = (index == 0) ? "@THIS" : "@THAT";
+        const char* selectedRegister = (index == 0) ? "@THIS" : "@THAT";
 
-        outfile << selectedRegister << endl;
+        out << selectedRegister << '\n';
 
-        outfile << "D=M" << endl;
+        out << "D=M" << '\n';
 
         // push D onto stack
-        outfile << "@SP" << endl;
-        outfile << "AM=M+1" << endl;
-        outfile << "A=A-1" << endl;
-        outfile << "M=D" << endl;
+        out << "@SP" << '\n';
+        out << "AM=M+1" << '\n';
+        out << "A=A-1" << '\n';
+        out << "M=D" << '\n';
       }
       else
       {
@@ -540,82 +621,91 @@ public:
     }
     else if (command == C_POP)
     {
-      outfile << "// " << lineNumber << ": pop " << segment << " " << index << endl;
+      out << "// " << lineNumber << ": pop " << segmentName(segment) << " " << index << '\n';
 
-      if ((segment == "local") || (segment == "argument") ||
-          (segment == "this") || (segment == "that"))
+      if (isShortOffset(segment, index))
+      {
+        // The address is built after popping, so R15 is not needed
+        out << "@SP" << '\n';
+        out << "AM=M-1" << '\n';
+        out << "D=M" << '\n';
+        writeAddress(segment, index);
+        out << "M=D" << '\n';
+      }
+      else if ((segment == S_LOCAL) || (segment == S_ARGUMENT) ||
+               (segment == S_THIS) || (segment == S_THAT))
       {
         // D <-- *segment_base + index
-        if (segment == "local")
+        if (segment == S_LOCAL)
         {
-          outfile << "@" << "LCL" << endl;
+          out << "@" << "LCL" << '\n';
         }
-        else if (segment == "argument")
+        else if (segment == S_ARGUMENT)
         {
-          outfile << "@" << "ARG" << endl;
+          out << "@" << "ARG" << '\n';
         }
-        else if (segment == "this")
+        else if (segment == S_THIS)
         {
-          outfile << "@" << "THIS" << endl;
+          out << "@" << "THIS" << '\n';
         }
-        else if (segment == "that")
+        else if (segment == S_THAT)
         {
-          outfile << "@" << "THAT" << endl;
+          out << "@" << "THAT" << '\n';
         }
 
-        outfile << "AD=M" << endl;
-        outfile << "@" << index << endl;
-        outfile << "D=D+A" << endl;
+        out << "AD=M" << '\n';
+        out << "@" << index << '\n';
+        out << "D=D+A" << '\n';
 
         // Spill *segment_base + index to R15
-        outfile << "@" << "R15" << endl;
-        outfile << "M=D" << endl;
+        out << "@" << "R15" << '\n';
+        out << "M=D" << '\n';
 
         // update stack
-        outfile << "@SP" << endl;
-        outfile << "AM=M-1" << endl;
-        outfile << "D=M" << endl;
+        out << "@SP" << '\n';
+        out << "AM=M-1" << '\n';
+        out << "D=M" << '\n';
 
         // Store in *segment_base + index
-        outfile << "@" << "R15" << endl;
-        outfile << "A=M" << endl;
-        outfile << "M=D" << endl;
+        out << "@" << "R15" << '\n';
+        out << "A=M" << '\n';
+        out << "M=D" << '\n';
       }
 
       // See section 7.3.1 - Standard VM Mapping on the Hack Platform, Part 1
-      else if (segment == "temp")
+      else if (segment == S_TEMP)
       {
         assert(index <= 8);
 
-        outfile << "@SP" << endl;
-        outfile << "AM=M-1" << endl;
-        outfile << "D=M" << endl;
-        outfile << "@" << "R" << 5 + index << endl;
-        outfile << "M=D" << endl;
+        out << "@SP" << '\n';
+        out << "AM=M-1" << '\n';
+        out << "D=M" << '\n';
+        out << "@" << "R" << 5 + index << '\n';
+        out << "M=D" << '\n';
       }
-      else if (segment == "static")
+      else if (segment == S_STATIC)
       {
-        outfile << "@SP" << endl;
-        outfile << "AM=M-1" << endl;
-        outfile << "D=M" << endl;
-        outfile << "@" << currentInputFilenameStem << "." << index << endl;
-        outfile << "M=D" << endl;
+        out << "@SP" << '\n';
+        out << "AM=M-1" << '\n';
+        out << "D=M" << '\n';
+        writeStaticAddress(index);
+        out << "M=D" << '\n';
       }
-      else if (segment == "pointer")
+      else if (segment == S_POINTER)
       {
         assert(index <= 2);
 
-        string selectedRegister = (index == 0) ? "@THIS" : "@THAT";
+        const char* selectedRegister = (index == 0) ? "@THIS" : "@THAT";
 
-        outfile << "@SP" << endl;
-        outfile << "AM=M-1" << endl;
-        outfile << "D=M" << endl;
-        outfile << selectedRegister << endl;
-        outfile << "M=D" << endl;
+        out << "@SP" << '\n';
+        out << "AM=M-1" << '\n';
+        out << "D=M" << '\n';
+        out << selectedRegister << '\n';
+        out << "M=D" << '\n';
       }
       else
       {
-        cerr << "pop " << segment << index;
+        cerr << "pop " << segmentName(segment) << index;
         assert(0);
       }
     }
@@ -625,18 +715,18 @@ public:
   // if != zero, goto label
   // otherwise continue with next command
   void writeIfGoto(int lineNumber, Command_t command,
-      string label)
+      string_view label)
   {
     if (command == C_IF_GOTO)
     {
-      outfile << "// " << lineNumber << ": if-goto " << " " << label << endl;
-
-      outfile << "@SP" << endl;
-      outfile << "M=M-1" << endl;
-      outfile << "A=M" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@" << getLabel(label) << endl;
-      outfile << "D;JNE" << endl;
+      out << "// " << lineNumber << ": if-goto " << " " << label << '\n';
+
+      out << "@SP" << '\n';
+      out << "M=M-1" << '\n';
+      out << "A=M" << '\n';
+      out << "D=M" << '\n';
+      out << "@" << getLabel(label) << '\n';
+      out << "D;JNE" << '\n';
     }
     else
     {
@@ -645,15 +735,13 @@ public:
   }
 
   void writeLabel(int lineNumber, Command_t command,
-      string label)
+      string_view label)
   {
     if (command == C_LABEL)
     {
-      string newLabel = getLabel(label);
+      out << "// " << lineNumber << ": label " << label << '\n';
 
-      outfile << "// " << lineNumber << ": label " << newLabel << endl;
-
-      outfile << "(" << newLabel << ")" << endl;
+      out << "(" << getLabel(label) << ")" << '\n';
     }
     else
     {
@@ -662,16 +750,14 @@ public:
   }
 
   void writeGoto(int lineNumber, Command_t command,
-      string label)
+      string_view label)
   {
     if (command == C_GOTO)
     {
-      string gotoLabel = label;
-
-      outfile << "// " << lineNumber << ": goto " << gotoLabel << endl;
+      out << "// " << lineNumber << ": goto " << label << '\n';
 
-      outfile << "@" << gotoLabel << endl;
-      outfile << "0;JMP" << endl;
+      out << "@" << getLabel(label) << '\n';
+      out << "0;JMP" << '\n';
     }
     else
     {
@@ -686,25 +772,33 @@ public:
   // On exit:
   //   Return value is pushed onto stack.
   void writeFunction(int lineNumber, Command_t command,
-      string label, int nargs)
+      string_view label, int nargs)
   {
     if (command == C_FUNCTION)
     {
       anonymousLabelCounter = 0;
       returnLabelCounter = 0;
       currentFunction = label;
+      inFunction = true;
 
       // TODO: Validate function name (pg. 160)
       // dot, letters, digits, underscores, color; can not start with digit
-      outfile << "// " << lineNumber << ": function" << " " << label;
-      outfile << " (" << nargs << " nargs)" << endl;
+      out << "// " << lineNumber << ": function" << " " << label;
+      out << " (" << nargs << " nargs)" << '\n';
 
-      outfile << "(" << label << ")" << endl;
+      out << "(" << label << ")" << '\n';
 
       // Build local variables
-      for (int i = 0; i < nargs; i++)
+      if (options.compactFrames)
+      {
+        writeZeroLocals(nargs);
+      }
+      else
       {
-        writePushPop(lineNumber, C_PUSH, "constant", 0);
+        for (int i = 0; i < nargs; i++)
+        {
+          writePushPop(lineNumber, C_PUSH, S_CONSTANT, 0);
+        }
       }
     }
     else
@@ -713,82 +807,123 @@ public:
     }
   }
 
+  // Push `count` zeros, the locals of a function, storing each one at
+  // the next address and updating SP once
+  void writeZeroLocals(int count)
+  {
+    if (count == 0)
+      return;
+
+    if (count == 1)
+    {
+      out << "@SP" << '\n';
+      out << "AM=M+1" << '\n';
+      out << "A=A-1" << '\n';
+      out << "M=0" << '\n';
+      return;
+    }
+
+    out << "@SP" << '\n';
+    out << "A=M" << '\n';
+    out << "M=0" << '\n';
+
+    for (int i = 1; i < count; i++)
+    {
+      out << "A=A+1" << '\n';
+      out << "M=0" << '\n';
+    }
+
+    out << "D=A+1" << '\n';
+    out << "@SP" << '\n';
+    out << "M=D" << '\n';
+  }
+
   void writeCall(int lineNumber, Command_t command,
-      string label, int nargs)
+      string_view label, int nargs)
   {
     if (command == C_CALL)
     {
       // TODO: Validate function name (pg. 160)
       // dot, letters, digits, underscores, color; can not start with digit
-      outfile << "// " << lineNumber << ": call" << " " << label;
-      outfile << " (" << nargs << " nargs)" << endl;
+      out << "// " << lineNumber << ": call" << " " << label;
+      out << " (" << nargs << " nargs)" << '\n';
 
       // create label for the return goto
-      string returnAddressLabel = createReturnLabel();
+      ReturnLabel returnAddressLabel = createReturnLabel();
+
+      if (options.sharedCallReturn)
+      {
+        // R13 = target, R14 = 5 + nargs, D = return address
+        out << "@" << label << '\n';
+        out << "D=A" << '\n';
+        out << "@R13" << '\n';
+        out << "M=D" << '\n';
+        out << "@" << 5 + nargs << '\n';
+        out << "D=A" << '\n';
+        out << "@R14" << '\n';
+        out << "M=D" << '\n';
+        out << "@" << returnAddressLabel << '\n';
+        out << "D=A" << '\n';
+        out << "@$$CALL" << '\n';
+        out << "0;JMP" << '\n';
+        sharedRoutinesUsed = true;
+
+        out << "(" << returnAddressLabel << ")" << '\n';
+        return;
+      }
 
       // load address of returnAddressLabel
-      outfile << "@" << returnAddressLabel << endl;
-      outfile << "D=A" << endl;
+      out << "@" << returnAddressLabel << '\n';
+      out << "D=A" << '\n';
 
       // push address of returnAddressLabel onto stack
-      outfile << "@SP" << endl;
-      outfile << "AM=M+1" << endl;
-      outfile << "A=A-1" << endl;
-      outfile << "M=D" << endl;
-
-      // push LCL
-      outfile << "@LCL" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@SP" << endl;
-      outfile << "AM=M+1" << endl;
-      outfile << "A=A-1" << endl;
-      outfile << "M=D" << endl;
-
-      // push ARG
-      outfile << "@ARG" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@SP" << endl;
-      outfile << "AM=M+1" << endl;
-      outfile << "A=A-1" << endl;
-      outfile << "M=D" << endl;
-
-      // push THIS
-      outfile << "@THIS" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@SP" << endl;
-      outfile << "AM=M+1" << endl;
-      outfile << "A=A-1" << endl;
-      outfile << "M=D" << endl;
-
-      // push THAT
-      outfile << "@THAT" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@SP" << endl;
-      outfile << "AM=M+1" << endl;
-      outfile << "A=A-1" << endl;
-      outfile << "M=D" << endl;
-
-      // point ARG to arg0
-      // ARG = SP - 5 - nargs  // point to arg0
-      outfile << "@SP" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@5" << endl;
-      outfile << "D=D-A" << endl;
-      outfile << "@" << nargs << endl;
-      outfile << "D=D-A" << endl;
-      outfile << "@ARG" << endl;
-      outfile << "M=D" << endl;
-
-      // reposition LCL
-      // LCL = SP
-      outfile << "@SP" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@LCL" << endl;
-      outfile << "M=D" << endl;
+      out << "@SP" << '\n';
+      out << "AM=M+1" << '\n';
+      out << "A=A-1" << '\n';
+      out << "M=D" << '\n';
+
+      writeSaveFrame();
+
+      if (options.compactFrames)
+      {
+        // LCL = SP, then ARG = SP - (5 + nargs) from the same load
+        out << "@SP" << '\n';
+        out << "D=M" << '\n';
+        out << "@LCL" << '\n';
+        out << "M=D" << '\n';
+        out << "@" << 5 + nargs << '\n';
+        out << "D=D-A" << '\n';
+        out << "@ARG" << '\n';
+        out << "M=D" << '\n';
+      }
+      else
+      {
+        // point ARG to arg0
+        // ARG = SP - 5 - nargs  // point to arg0
+        out << "@SP" << '\n';
+        out << "D=M" << '\n';
+        out << "@5" << '\n';
+        out << "D=D-A" << '\n';
+        out << "@" << nargs << '\n';
+        out << "D=D-A" << '\n';
+        out << "@ARG" << '\n';
+        out << "M=D" << '\n';
+
+        // reposition LCL
+        // LCL = SP
+        out << "@SP" << '\n';
+        out << "D=M" << '\n';
+        out << "@LCL" << '\n';
+        out << "M=D" << '\n';
+      }
+
 
-      writeGoto(lineNumber, C_GOTO, label);
+      // goto function
+      out << "// " << lineNumber << ": goto " << label << '\n';
+      out << "@" << label << '\n';
+      out << "0;JMP" << '\n';
 
-      outfile << "(" << returnAddressLabel << ")" << endl;
+      out << "(" << returnAddressLabel << ")" << '\n';
     }
     else
     {
@@ -800,199 +935,1014 @@ public:
   {
     if (command == C_RETURN)
     {
-      outfile << "// " << lineNumber << ": return" << endl;
-
-      // R13 - LCL
-      // R14 - Return Address
-
-      // R13 = LCL - Save LCL (endFrame) to temporary register
-      outfile << "// " << lineNumber << ": R13 = FRAME = LCL" << endl;
-      outfile << "@LCL" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@R13" << endl;
-      outfile << "M=D" << endl;
-      // R14 = *(endFrame - 5) = *(R13 - 5) - Save return address in R14
-      outfile << "// " << lineNumber << ": R14 = RET = *(FRAME-5)" << endl;
-      outfile << "@R13" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@5" << endl;
-      outfile << "A=D-A" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@R14" << endl;
-      outfile << "M=D" << endl;
-      // *ARG = pop() - Reposition the return value for caller
-      outfile << "// " << lineNumber << ": *ARG = pop()" << endl;
-      writePushPop(lineNumber, C_POP, "argument", 0); // trashes R15
-      // SP = ARG+1 - Restore SP of caller
-      outfile << "// " << lineNumber << ": SP = ARG+1" << endl;
-      outfile << "@ARG" << endl;
-      outfile << "AD=M+1" << endl;
-      outfile << "@SP" << endl;
-      outfile << "M=D" << endl;
-      // THAT = *(R13 - 1) - Restore THAT of caller
-      outfile << "// " << lineNumber << ": THAT = *(FRAME-1)" << endl;
-      outfile << "@R13" << endl;
-      outfile << "A=M" << endl;
-      outfile << "A=A-1" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@THAT" << endl;
-      outfile << "M=D" << endl;
-      // THIS = *(R13 - 2) - Restore THIS of caller
-      outfile << "// " << lineNumber << ": THIS = *(FRAME-2)" << endl;
-      outfile << "@R13" << endl;
-      outfile << "A=M" << endl;
-      outfile << "A=A-1" << endl;
-      outfile << "A=A-1" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@THIS" << endl;
-      outfile << "M=D" << endl;
-      // ARG = *(R13 - 3) - Restore ARG of caller
-      outfile << "// " << lineNumber << ": ARG = *(FRAME-3)" << endl;
-      outfile << "@R13" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@3" << endl;
-      outfile << "A=D-A" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@ARG" << endl;
-      outfile << "M=D" << endl;
-      // LCL = *(R13 - 4) - Restore LCL of caller
-      outfile << "// " << lineNumber << ": LCL = *(FRAME-4)" << endl;
-      outfile << "@R13" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@4" << endl;
-      outfile << "A=D-A" << endl;
-      outfile << "D=M" << endl;
-      outfile << "@LCL" << endl;
-      outfile << "M=D" << endl;
-      // goto RET (R14)
-      outfile << "// " << lineNumber << ": goto RET/R14" << endl;
-      outfile << "@R14" << endl;
-      outfile << "A=M" << endl;
-      outfile << "0;JMP" << endl;
+      out << "// " << lineNumber << ": return" << '\n';
+
+      if (options.sharedCallReturn)
+      {
+        out << "@$$RETURN" << '\n';
+        out << "0;JMP" << '\n';
+        sharedRoutinesUsed = true;
+        return;
+      }
+
+      writeReturnSequence(lineNumber);
     }
     else
     {
       assert(0);
     }
   }
-};
-
-class VMTranslator
-{
-  list<string> fileNameStemList;  // list .vm files with ".vm" dropped
-  string directoryName;
-  string outputFilenameStem;
-  bool bootstrapRequired = false;
-
-  public:
 
-  // VMTranslator - Populates `fileNameStemList` with one or more files
-  // to be parsed and converted.
-  VMTranslator(string argv)
+  // Translate `call label nargs` followed by `return` as a jump to label
+  // in place of the current frame.  The arguments move down over those of
+  // the current function and the frame saved by its caller is rebuilt
+  // above them, so label returns straight to that caller.  label starts
+  // with the caller's THIS and THAT rather than the current ones, which
+  // compiled Jack never reads before setting.
+  void writeTailCall(int lineNumber, string_view label, int nargs)
   {
-    struct stat argStat;
-    bool isFile = false;
-    char argvDirtyCopy[PATH_MAX + 1];
-
-    // Determine if specified argument is a directory of filename
-
-    int rvalue = stat(argv.c_str(), &argStat);
+    out << "// " << lineNumber << ": call " << label << " (" << nargs
+        << " nargs), return" << '\n';
 
-    if (rvalue == 0)
-    {
-      if ((argStat.st_mode & S_IFDIR) == 0)
-      {
-        FILE* infile = fopen(argv.c_str(), "r");
+    // R13-R15 = return address, LCL and ARG of the caller, from FRAME-5
+    // to FRAME-3, which the arguments may overwrite
+    out << "// " << lineNumber << ": R13-R15 = *(FRAME-5) to *(FRAME-3)" << '\n';
 
-        if (infile != nullptr)
-        {
-          isFile = true;
-          fclose(infile);
-        }
-        else
-        {
-          cerr << "Error opening file." << endl;
-          exit(-1);
-        }
-      }
-    }
-    else
+    for (int offset = 5; offset >= 3; offset--)
     {
-      cerr << "File or directory not found." << endl;
-      exit(-1);
+      out << "@LCL" << '\n';
+      out << "D=M" << '\n';
+      out << "@" << offset << '\n';
+      out << "A=D-A" << '\n';
+      out << "D=M" << '\n';
+      out << "@R" << 18 - offset << '\n';
+      out << "M=D" << '\n';
     }
 
-    char* rvalue_s;
-
-    strcpy(argvDirtyCopy, argv.c_str());
-    char* pDirname = dirname(argvDirtyCopy);
-
-    if (isFile)
+    // THIS = *(FRAME-2), THAT = *(FRAME-1) - Restore the caller's pointers
+    out << "// " << lineNumber << ": THIS = *(FRAME-2), THAT = *(FRAME-1)" << '\n';
+    out << "@LCL" << '\n';
+    out << "A=M-1" << '\n';
+    out << "D=M" << '\n';
+    out << "@THAT" << '\n';
+    out << "M=D" << '\n';
+    out << "@LCL" << '\n';
+    out << "A=M-1" << '\n';
+    out << "A=A-1" << '\n';
+    out << "D=M" << '\n';
+    out << "@THIS" << '\n';
+    out << "M=D" << '\n';
+
+    // ARG[i] = the i-th argument, in increasing order as each lies below
+    // the arguments still to be moved
+    for (int i = 0; i < nargs; i++)
     {
-      directoryName = string(pDirname);
-
-      // Extract the output filename from provided path
-      strcpy(argvDirtyCopy, argv.c_str());
-      char* pBasename = basename(argvDirtyCopy);
-
-      string fileBasename(pBasename);
+      out << "// " << lineNumber << ": ARG[" << i << "] = *(SP-" << nargs - i
+          << ")" << '\n';
+      out << "@SP" << '\n';
 
-      if ((fileBasename.length() <= 3) ||
-          (fileBasename.substr(fileBasename.length() - 3) != ".vm"))
+      if (nargs - i <= 2)
       {
-        cerr << "Input filename required to end with .vm extension." << endl;
-        exit(-1);
-      }
-
-      outputFilenameStem = fileBasename.substr(0, fileBasename.length() - 3);
-    }
-    else
-    {
-      char resolvedDirPath[PATH_MAX + 1];
+        out << "A=M-1" << '\n';
 
-      // Expand given directory into full path
-      rvalue_s = realpath(argv.c_str(), resolvedDirPath);
-
-      if (rvalue_s == nullptr)
+        if (nargs - i == 2)
+          out << "A=A-1" << '\n';
+      }
+      else
       {
-        puts("Failed to resolve directory path");
-        exit(1);
+        out << "D=M" << '\n';
+        out << "@" << nargs - i << '\n';
+        out << "A=D-A" << '\n';
       }
 
-      directoryName = string(resolvedDirPath);
+      out << "D=M" << '\n';
+      out << "@ARG" << '\n';
+      out << "A=M" << '\n';
 
-      // Derive output filename from directory
-      char* pDirBasename = basename(resolvedDirPath);
+      for (int step = 0; step < i; step++)
+        out << "A=A+1" << '\n';
 
-      outputFilenameStem = string(pDirBasename);
+      out << "M=D" << '\n';
     }
 
-    //
-    // Add file(s) to be processed to fileNameStemList
-    //
+    // SP = ARG + nargs, then push the saved frame as the caller's call did
+    out << "// " << lineNumber << ": SP = ARG+" << nargs << '\n';
+    out << "@ARG" << '\n';
+    out << "D=M" << '\n';
 
-    if (isFile)
+    if (nargs > 0)
     {
-      fileNameStemList.push_back(outputFilenameStem);
+      out << "@" << nargs << '\n';
+      out << "D=D+A" << '\n';
     }
-    else
+
+    out << "@SP" << '\n';
+    out << "M=D" << '\n';
+
+    for (string_view reg : {"R13", "R14", "R15", "THIS", "THAT"})
     {
-      // Directories are assumed to require bootstrap code
-      bootstrapRequired = true;
+      out << "@" << reg << '\n';
+      out << "D=M" << '\n';
+      out << "@SP" << '\n';
+      out << "AM=M+1" << '\n';
+      out << "A=A-1" << '\n';
+      out << "M=D" << '\n';
+    }
 
-      DIR* dir = opendir(directoryName.c_str());
+    // LCL = SP, with A still at SP-1
+    out << "D=A+1" << '\n';
+    out << "@LCL" << '\n';
+    out << "M=D" << '\n';
 
-      if (dir == NULL)
-      {
-        cerr << "Unable to read files in directory." << endl;
-        exit(-1);
-      }
+    out << "// " << lineNumber << ": goto " << label << '\n';
+    out << "@" << label << '\n';
+    out << "0;JMP" << '\n';
+  }
 
-      while(true)
-      {
-        struct dirent* dirEntry;
-       
-        dirEntry = readdir(dir);
+  // Name statics after the file `cmd` takes them from
+  void useStaticsOf(const VmCommand& cmd)
+  {
+    staticStem = cmd.file.empty() ? string_view(currentInputFilenameStem)
+                                  : cmd.file;
+  }
+
+  // Translate a single command
+  void writeCommand(const VmCommand& cmd)
+  {
+    auto cmdType = cmd.type;
+
+    useStaticsOf(cmd);
+
+    if (cmdType == C_ARITHMETIC)
+    {
+      writeArithmetic(cmd.lineNumber, cmd.arithmetic);
+    }
+    else if ((cmdType == C_PUSH) || (cmdType == C_POP))
+    {
+      writePushPop(cmd.lineNumber, cmdType, cmd.segment, cmd.index);
+    }
+    else if (cmdType == C_IF_GOTO)
+    {
+      writeIfGoto(cmd.lineNumber, cmdType, cmd.name);
+    }
+    else if (cmdType == C_LABEL)
+    {
+      writeLabel(cmd.lineNumber, cmdType, cmd.name);
+    }
+    else if (cmdType == C_GOTO)
+    {
+      writeGoto(cmd.lineNumber, cmdType, cmd.name);
+    }
+    else if (cmdType == C_FUNCTION)
+    {
+      writeFunction(cmd.lineNumber, cmdType, cmd.name, cmd.index);
+    }
+    else if (cmdType == C_CALL)
+    {
+      writeCall(cmd.lineNumber, cmdType, cmd.name, cmd.index);
+    }
+    else if (cmdType == C_RETURN)
+    {
+      writeReturn(cmd.lineNumber, cmdType);
+    }
+    else
+    {
+      ASSERT(0, string("Unsupported cmdType."));
+    }
+  }
+
+  // Name of the register holding the base of local, argument, this or
+  // that
+  static const char* baseRegister(Segment_t segment)
+  {
+    switch (segment)
+    {
+      case S_LOCAL: return "LCL";
+      case S_ARGUMENT: return "ARG";
+      case S_THIS: return "THIS";
+      default: return "THAT";
+    }
+  }
+
+  static bool isDirectSegment(Segment_t segment)
+  {
+    return (segment == S_STATIC) || (segment == S_TEMP) ||
+           (segment == S_POINTER);
+  }
+
+  // Select static `index` of the file staticStem names in A: its address
+  // in the layout, or a symbol for the assembler to allocate
+  void writeStaticAddress(int index)
+  {
+    int address = staticLayout ? staticLayout->address(staticStem, index) : -1;
+
+    if (address >= 0)
+      out << "@" << address << '\n';
+    else
+      out << "@" << staticStem << "." << index << '\n';
+  }
+
+  // Is segment[index] of local, argument, this or that reached by
+  // incrementing A with -fshort-offsets?
+  bool isShortOffset(Segment_t segment, int index) const
+  {
+    return options.shortOffsets && !isDirectSegment(segment) &&
+           (segment != S_CONSTANT) && (index <= MAX_SHORT_OFFSET);
+  }
+
+  // Does writeAddress() leave D as it is for segment[index]?
+  bool addressKeepsD(Segment_t segment, int index) const
+  {
+    return isDirectSegment(segment) || (index <= 1) ||
+           isShortOffset(segment, index);
+  }
+
+  // Select the variable segment[index] in A.  Only an index of local,
+  // argument, this or that above 1, or above MAX_SHORT_OFFSET with
+  // -fshort-offsets, uses D.
+  void writeAddress(Segment_t segment, int index)
+  {
+    if (segment == S_STATIC)
+    {
+      writeStaticAddress(index);
+    }
+    else if (segment == S_TEMP)
+    {
+      out << "@" << "R" << 5 + index << '\n';
+    }
+    else if (segment == S_POINTER)
+    {
+      out << ((index == 0) ? "@THIS" : "@THAT") << '\n';
+    }
+    else
+    {
+      out << "@" << baseRegister(segment) << '\n';
+
+      if (index == 0)
+      {
+        out << "A=M" << '\n';
+      }
+      else if (addressKeepsD(segment, index))
+      {
+        out << "A=M+1" << '\n';
+
+        for (int i = 1; i < index; i++)
+          out << "A=A+1" << '\n';
+      }
+      else
+      {
+        out << "D=M" << '\n';
+        out << "@" << index << '\n';
+        out << "A=D+A" << '\n';
+      }
+    }
+  }
+
+  // D = the value `push segment index` would push
+  void writeLoad(Segment_t segment, int index)
+  {
+    if (segment != S_CONSTANT)
+    {
+      writeAddress(segment, index);
+      out << "D=M" << '\n';
+    }
+    else if ((index >= -1) && (index <= 1))
+    {
+      out << "D=" << index << '\n';
+    }
+    else
+    {
+      writeConstant(index);
+    }
+  }
+
+  // D = `value`.  Only folded constants are negative.
+  void writeConstant(int value)
+  {
+    if (value >= 0)
+    {
+      out << "@" << value << '\n';
+      out << "D=A" << '\n';
+    }
+    else if (value > -32768)
+    {
+      out << "@" << -value << '\n';
+      out << "D=-A" << '\n';
+    }
+    else
+    {
+      out << "@" << 32767 << '\n';
+      out << "D=-A" << '\n';
+      out << "D=D-1" << '\n';
+    }
+  }
+
+  // Translate the `si.length` commands at `cmd` as one unit.  The stack
+  // above SP is left as it is, so only the VM state the commands define
+  // is the same as their separate translation.
+  void writeSuperinstruction(Superinstruction si, const VmCommand* cmd)
+  {
+    out << "// " << cmd[0].lineNumber << "-" << cmd[si.length - 1].lineNumber
+        << ": " << superinstructionName(si.type) << '\n';
+
+    // Only the array accesses and compare branches take their operand from
+    // a cached top
+    if ((si.type != SI_ARRAY_LOAD) && (si.type != SI_ARRAY_STORE) &&
+        (si.type != SI_COMPARE_BRANCH))
+    {
+      flushTop();
+    }
+
+    if (si.type == SI_INCREMENT)
+    {
+      // x = x + c or x - c in place
+      Segment_t segment = cmd[0].segment;
+      int index = cmd[0].index;
+      int constant = cmd[1].index;
+      bool add = (cmd[2].arithmetic == A_ADD);
+
+      if (constant == 0)
+        return;
+
+      useStaticsOf(cmd[0]);
+
+      if (constant == 1)
+      {
+        writeAddress(segment, index);
+        out << (add ? "M=M+1" : "M=M-1") << '\n';
+      }
+      else if (addressKeepsD(segment, index))
+      {
+        out << "@" << constant << '\n';
+        out << "D=A" << '\n';
+        writeAddress(segment, index);
+        out << (add ? "M=D+M" : "M=M-D") << '\n';
+      }
+      else
+      {
+        writeAddress(segment, index);
+        out << "D=A" << '\n';
+        out << "@" << "R15" << '\n';
+        out << "M=D" << '\n';
+        out << "@" << constant << '\n';
+        out << "D=A" << '\n';
+        out << "@" << "R15" << '\n';
+        out << "A=M" << '\n';
+        out << (add ? "M=D+M" : "M=M-D") << '\n';
+      }
+    }
+    else if ((si.type == SI_ARRAY_LOAD) || (si.type == SI_ARRAY_STORE))
+    {
+      int index = cmd[2].index;
+
+      // THAT = base + subscript
+      if (options.cacheTop)
+      {
+        // Both are popped, leaving SP at the base
+        loadTop();
+        out << "@SP" << '\n';
+        out << "AM=M-1" << '\n';
+        out << "D=D+M" << '\n';
+        topInD = false;
+      }
+      else
+      {
+        out << "@SP" << '\n';
+        out << "AM=M-1" << '\n';
+        out << "D=M" << '\n';
+        out << "A=A-1" << '\n';
+        out << "D=D+M" << '\n';
+      }
+
+      out << "@THAT" << '\n';
+      out << "M=D" << '\n';
+
+      if (si.type == SI_ARRAY_LOAD)
+      {
+        // Replace the base with that[index]
+        if (index == 0)
+        {
+          out << "A=D" << '\n';
+        }
+        else if (index == 1)
+        {
+          out << "A=D+1" << '\n';
+        }
+        else
+        {
+          out << "@" << index << '\n';
+          out << "A=D+A" << '\n';
+        }
+
+        out << "D=M" << '\n';
+
+        if (options.cacheTop)
+        {
+          topInD = true;
+        }
+        else
+        {
+          out << "@SP" << '\n';
+          out << "A=M-1" << '\n';
+          out << "M=D" << '\n';
+        }
+      }
+      else
+      {
+        // Pop the value below the base into that[index]
+        if (index == 1)
+        {
+          out << "D=D+1" << '\n';
+        }
+        else if (index > 1)
+        {
+          out << "@" << index << '\n';
+          out << "D=D+A" << '\n';
+        }
+
+        out << "@" << "R15" << '\n';
+        out << "M=D" << '\n';
+        out << "@SP" << '\n';
+
+        if (!options.cacheTop)
+          out << "M=M-1" << '\n';
+
+        out << "AM=M-1" << '\n';
+        out << "D=M" << '\n';
+        out << "@" << "R15" << '\n';
+        out << "A=M" << '\n';
+        out << "M=D" << '\n';
+      }
+    }
+    else if (si.type == SI_MOVE)
+    {
+      // y = x without visiting the stack
+      useStaticsOf(cmd[0]);
+      writeLoad(cmd[0].segment, cmd[0].index);
+      useStaticsOf(cmd[1]);
+      writeAddress(cmd[1].segment, cmd[1].index);
+      out << "M=D" << '\n';
+    }
+    else if (si.type == SI_PUSH_CONSTANTS)
+    {
+      // Store each constant directly and update SP once
+      out << "@SP" << '\n';
+      out << "A=M" << '\n';
+
+      for (size_t i = 0; i < si.length; i++)
+      {
+        if (i > 0)
+          out << "A=A+1" << '\n';
+
+        out << "M=" << cmd[i].index << '\n';
+      }
+
+      out << "D=A+1" << '\n';
+      out << "@SP" << '\n';
+      out << "M=D" << '\n';
+    }
+    else if (si.type == SI_COMPARE_BRANCH)
+    {
+      // Jump on the condition itself rather than on a boolean pushed for
+      // the if-goto to pop
+      Arithmetic_t command = cmd[0].arithmetic;
+      bool negated = (si.length == 3);
+      const char* jump;
+
+      if (command == A_EQ)
+        jump = negated ? "D;JNE" : "D;JEQ";
+      else if (command == A_LT)
+        jump = negated ? "D;JGE" : "D;JLT";
+      else
+        jump = negated ? "D;JLE" : "D;JGT";
+
+      // D = x - y
+      if (options.cacheTop)
+      {
+        loadTop();
+        out << "@SP" << '\n';
+        out << "AM=M-1" << '\n';
+        out << "D=M-D" << '\n';
+        topInD = false;
+      }
+      else
+      {
+        out << "@SP" << '\n';
+        out << "M=M-1" << '\n';
+        out << "AM=M-1" << '\n';
+        out << "D=M" << '\n';
+        out << "A=A+1" << '\n';
+        out << "D=D-M" << '\n';
+      }
+
+      out << "@" << getLabel(cmd[si.length - 1].name) << '\n';
+      out << jump << '\n';
+    }
+    else
+    {
+      ASSERT(0, string("Unsupported superinstruction."));
+    }
+  }
+
+  // Store a top of stack held in D to RAM
+  void flushTop()
+  {
+    if (!topInD)
+      return;
+
+    out << "@SP" << '\n';
+    out << "AM=M+1" << '\n';
+    out << "A=A-1" << '\n';
+    out << "M=D" << '\n';
+    topInD = false;
+  }
+
+  // Bring the top of stack into D
+  void loadTop()
+  {
+    if (topInD)
+      return;
+
+    out << "@SP" << '\n';
+    out << "AM=M-1" << '\n';
+    out << "D=M" << '\n';
+    topInD = true;
+  }
+
+  // Translate a single command keeping the top of stack in D where the
+  // command allows it.  Only pushes, pops, arithmetic and if-goto work
+  // on a cached top; every other command sees the stack in RAM.
+  void writeCachedCommand(const VmCommand& cmd)
+  {
+    int lineNumber = cmd.lineNumber;
+
+    useStaticsOf(cmd);
+
+    if (cmd.type == C_PUSH)
+    {
+      out << "// " << lineNumber << ": push " << segmentName(cmd.segment)
+          << " " << cmd.index << '\n';
+
+      flushTop();
+      writeLoad(cmd.segment, cmd.index);
+      topInD = true;
+    }
+    else if (cmd.type == C_POP)
+    {
+      out << "// " << lineNumber << ": pop " << segmentName(cmd.segment)
+          << " " << cmd.index << '\n';
+
+      loadTop();
+
+      if (addressKeepsD(cmd.segment, cmd.index))
+      {
+        writeAddress(cmd.segment, cmd.index);
+        out << "M=D" << '\n';
+      }
+      else
+      {
+        // D = value + address, from which R15 (the value) recovers both
+        out << "@" << "R15" << '\n';
+        out << "M=D" << '\n';
+        out << "@" << baseRegister(cmd.segment) << '\n';
+        out << "D=D+M" << '\n';
+        out << "@" << cmd.index << '\n';
+        out << "D=D+A" << '\n';
+        out << "@" << "R15" << '\n';
+        out << "A=D-M" << '\n';
+        out << "D=D-A" << '\n';
+        out << "M=D" << '\n';
+      }
+
+      topInD = false;
+    }
+    else if (cmd.type == C_ARITHMETIC)
+    {
+      Arithmetic_t command = cmd.arithmetic;
+
+      out << "// " << lineNumber << ": " << arithmeticName(command) << '\n';
+
+      if ((command == A_NEG) || (command == A_NOT))
+      {
+        if (topInD)
+        {
+          out << ((command == A_NEG) ? "D=-D" : "D=!D") << '\n';
+        }
+        else
+        {
+          out << "@SP" << '\n';
+          out << "AM=M-1" << '\n';
+          out << ((command == A_NEG) ? "D=-M" : "D=!M") << '\n';
+          topInD = true;
+        }
+
+        return;
+      }
+
+      // D = y, then combine it with x popped from RAM
+      loadTop();
+
+      out << "@SP" << '\n';
+      out << "AM=M-1" << '\n';
+
+      if      (command == A_ADD) out << "D=D+M" << '\n';
+      else if (command == A_SUB) out << "D=M-D" << '\n';
+      else if (command == A_AND) out << "D=D&M" << '\n';
+      else if (command == A_OR ) out << "D=D|M" << '\n';
+      else
+      {
+        branchNumber++;
+
+        out << "D=M-D" << '\n';
+        out << "@" << currentInputFilenameStem << "$CMP_" << branchNumber << '\n';
+
+        if (command == A_EQ)
+          out << "D;JEQ" << '\n';
+        else if (command == A_LT)
+          out << "D;JLT" << '\n';
+        else
+          out << "D;JGT" << '\n';
+
+        out << "D=0" << '\n';
+        out << "@" << currentInputFilenameStem << "$JOIN_CMP_" << branchNumber << '\n';
+        out << "0;JMP" << '\n';
+        out << "(" << currentInputFilenameStem << "$CMP_" << branchNumber << ")" << '\n';
+        out << "D=-1" << '\n';
+        out << "(" << currentInputFilenameStem << "$JOIN_CMP_" << branchNumber << ")" << '\n';
+      }
+    }
+    else if ((cmd.type == C_IF_GOTO) && topInD)
+    {
+      out << "// " << lineNumber << ": if-goto " << " " << cmd.name << '\n';
+
+      out << "@" << getLabel(cmd.name) << '\n';
+      out << "D;JNE" << '\n';
+      topInD = false;
+    }
+    else
+    {
+      flushTop();
+      writeCommand(cmd);
+    }
+  }
+
+  // With options.sourceMap, note that the code written next comes from
+  // `position`
+  void markSource(const SourcePosition& position)
+  {
+    if (options.sourceMap)
+      out.markSource(position);
+  }
+
+  void markSource(const VmCommand& cmd)
+  {
+    markSource(SourcePosition{currentInputFilenameStem, cmd.lineNumber,
+                              cmd.sourceLine, sourceFunction});
+  }
+
+  // Write the label starting the shared routine `label`
+  void writeRoutineLabel(string_view label)
+  {
+    markSource(SourcePosition{string_view(), 0, 0, label});
+    out << "(" << label << ")" << '\n';
+  }
+
+  // Translate the commands of `block`, fused into superinstructions when
+  // enabled
+  void writeBlock(const VmBlock& block)
+  {
+    const auto& commands = block.commands;
+
+    for (size_t i = 0; i < commands.size(); )
+    {
+      Superinstruction si;
+
+      markSource(commands[i]);
+
+      if (options.tailCalls && (commands[i].type == C_CALL) &&
+          (i + 1 < commands.size()) && (commands[i + 1].type == C_RETURN))
+      {
+        // The arguments are read from RAM
+        flushTop();
+        writeTailCall(commands[i].lineNumber, commands[i].name,
+                      commands[i].index);
+        i += 2;
+        continue;
+      }
+
+      if (options.superinstructions)
+        si = matchSuperinstruction(commands, i);
+
+      if (si.type != SI_NONE)
+      {
+        writeSuperinstruction(si, &commands[i]);
+      }
+      else if (options.cacheTop)
+      {
+        writeCachedCommand(commands[i]);
+      }
+      else
+      {
+        writeCommand(commands[i]);
+      }
+
+      i += si.length;
+    }
+
+    // The next block may be entered from a jump, which expects the stack
+    // in RAM
+    flushTop();
+  }
+
+  // Translate every function of `module` in order
+  void writeModule(const VmModule& module)
+  {
+    setInputFilenameStem(module.stem);
+
+    for (const auto& function : module.functions)
+    {
+      sourceFunction = (function.entry.type == C_FUNCTION) ?
+          string_view(function.entry.name) : string_view();
+
+      if (function.entry.type == C_FUNCTION)
+      {
+        markSource(function.entry);
+        writeCommand(function.entry);
+      }
+
+      for (const auto& block : function.blocks)
+        writeBlock(block);
+    }
+  }
+
+  // Did any call or return site jump to the shared routines?
+  bool usesSharedRoutines() const { return sharedRoutinesUsed; }
+
+  // Emit the shared $$CALL and $$RETURN routines used by every call and
+  // return site when options.sharedCallReturn is set, and the $$EQ, $$LT
+  // and $$GT routines of options.sharedCompare.  They are placed after all
+  // translated code where they can only be reached by a jump.
+  //
+  // $$CALL expects: D = return address, R13 = function address,
+  //                 R14 = 5 + nargs
+  // $$EQ/$$LT/$$GT expect: D = return address, x and y on the stack
+  void writeSharedRoutines()
+  {
+    // Stop a program without a bootstrap from running into the routines
+    out << "// Halt" << '\n';
+    writeRoutineLabel("$$HALT");
+    out << "@$$HALT" << '\n';
+    out << "0;JMP" << '\n';
+
+    if (options.sharedCompare)
+    {
+      static const char* const comparisons[][2] = {
+        {"$$EQ", "D;JEQ"}, {"$$LT", "D;JLT"}, {"$$GT", "D;JGT"}
+      };
+
+      out << "// Shared comparison routines" << '\n';
+
+      for (const auto& comparison : comparisons)
+      {
+        writeRoutineLabel(comparison[0]);
+        out << "@R14" << '\n';
+        out << "M=D" << '\n';
+        out << "@SP" << '\n';
+        out << "AM=M-1" << '\n';
+        out << "D=M" << '\n';
+        out << "A=A-1" << '\n';
+        out << "D=M-D" << '\n';
+        out << "@$$CMP_TRUE" << '\n';
+        out << comparison[1] << '\n';
+        out << "@$$CMP_FALSE" << '\n';
+        out << "0;JMP" << '\n';
+      }
+
+      writeRoutineLabel("$$CMP_FALSE");
+      out << "@SP" << '\n';
+      out << "A=M-1" << '\n';
+      out << "M=0" << '\n';
+      out << "@R14" << '\n';
+      out << "A=M" << '\n';
+      out << "0;JMP" << '\n';
+      writeRoutineLabel("$$CMP_TRUE");
+      out << "@SP" << '\n';
+      out << "A=M-1" << '\n';
+      out << "M=-1" << '\n';
+      out << "@R14" << '\n';
+      out << "A=M" << '\n';
+      out << "0;JMP" << '\n';
+    }
+
+    if (!options.sharedCallReturn)
+      return;
+
+    out << "// Shared call routine" << '\n';
+    writeRoutineLabel("$$CALL");
+
+    // push return address
+    out << "@SP" << '\n';
+    out << "AM=M+1" << '\n';
+    out << "A=A-1" << '\n';
+    out << "M=D" << '\n';
+
+    writeSaveFrame();
+
+    if (options.compactFrames)
+    {
+      // LCL = SP, then ARG = SP - (5 + nargs) from the same load
+      out << "@SP" << '\n';
+      out << "D=M" << '\n';
+      out << "@LCL" << '\n';
+      out << "M=D" << '\n';
+      out << "@R14" << '\n';
+      out << "D=D-M" << '\n';
+      out << "@ARG" << '\n';
+      out << "M=D" << '\n';
+    }
+    else
+    {
+      // ARG = SP - (5 + nargs)
+      out << "@R14" << '\n';
+      out << "D=M" << '\n';
+      out << "@SP" << '\n';
+      out << "D=M-D" << '\n';
+      out << "@ARG" << '\n';
+      out << "M=D" << '\n';
+
+      // LCL = SP
+      out << "@SP" << '\n';
+      out << "D=M" << '\n';
+      out << "@LCL" << '\n';
+      out << "M=D" << '\n';
+    }
+
+    // goto function (R13)
+    out << "@R13" << '\n';
+    out << "A=M" << '\n';
+    out << "0;JMP" << '\n';
+
+    out << "// Shared return routine" << '\n';
+    writeRoutineLabel("$$RETURN");
+    writeReturnSequence(0);
+  }
+};
+
+class VMTranslator
+{
+  vector<string> fileNameStemList;  // list .vm files with ".vm" dropped
+
+  // Instruction counts before and after optimization, per file
+  struct FileStats {
+    size_t before = 0;
+    size_t after = 0;
+    bool cached = false;          // reused from the translation cache
+    FoldingStats folding;
+  };
+
+  vector<FileStats> fileStats;
+
+  // Seconds spent in each phase of process(), for -s
+  struct PhaseTimes {
+    double parse = 0.0;           // reading and parsing the files
+    double passes = 0.0;          // whole program passes, cache lookups
+    double codegen = 0.0;         // translation and peephole optimization
+    double output = 0.0;          // writing the assembly or machine code
+  };
+
+  PhaseTimes phaseTimes;
+  size_t commandsParsed = 0;
+
+  vector<VmModule> modules;                 // parsed files, one per stem
+  vector<string_view> removedFunctions;     // by dead function elimination
+  vector<InlinedFunction> inlinedFunctions; // by -finline
+  StaticLayout staticLayout;                // by -fpack-statics
+  int spareTemp = -1;                       // for -ffold-constants
+
+  unique_ptr<TranslationCache> cache;       // -c
+  vector<uint64_t> cacheKeys;               // per file
+  vector<string> cachedFragments;           // per file, empty unless cached
+
+  ofstream outfile;                         // .asm output
+  HackAssembler assembler;                  // -b output
+  SourceMap sourceMap;                      // -m output
+  size_t romAddress = 0;                    // of the next code flushed
+  string directoryName;
+  string outputFilenameStem;
+  bool bootstrapRequired = false;
+  const TranslatorOptions options;
+
+  public:
+
+  // VMTranslator - Populates `fileNameStemList` with one or more files
+  // to be parsed and converted.
+  VMTranslator(string argv, const TranslatorOptions& translatorOptions) :
+    options(translatorOptions)
+  {
+    struct stat argStat;
+    bool isFile = false;
+    char argvDirtyCopy[PATH_MAX + 1];
+
+    // Determine if specified argument is a directory of filename
+
+    int rvalue = stat(argv.c_str(), &argStat);
+
+    if (rvalue == 0)
+    {
+      if ((argStat.st_mode & S_IFDIR) == 0)
+      {
+        FILE* infile = fopen(argv.c_str(), "r");
+
+        if (infile != nullptr)
+        {
+          isFile = true;
+          fclose(infile);
+        }
+        else
+        {
+          cerr << "Error opening file." << endl;
+          exit(-1);
+        }
+      }
+    }
+    else
+    {
+      cerr << "File or directory not found." << endl;
+      exit(-1);
+    }
+
+    char* rvalue_s;
+
+    strcpy(argvDirtyCopy, argv.c_str());
+    char* pDirname = dirname(argvDirtyCopy);
+
+    if (isFile)
+    {
+      directoryName = string(pDirname);
+
+      // Extract the output filename from provided path
+      strcpy(argvDirtyCopy, argv.c_str());
+      char* pBasename = basename(argvDirtyCopy);
+
+      string fileBasename(pBasename);
+
+      if ((fileBasename.length() <= 3) ||
+          (fileBasename.substr(fileBasename.length() - 3) != ".vm"))
+      {
+        cerr << "Input filename required to end with .vm extension." << endl;
+        exit(-1);
+      }
+
+      outputFilenameStem = fileBasename.substr(0, fileBasename.length() - 3);
+    }
+    else
+    {
+      char resolvedDirPath[PATH_MAX + 1];
+
+      // Expand given directory into full path
+      rvalue_s = realpath(argv.c_str(), resolvedDirPath);
+
+      if (rvalue_s == nullptr)
+      {
+        puts("Failed to resolve directory path");
+        exit(1);
+      }
+
+      directoryName = string(resolvedDirPath);
+
+      // Derive output filename from directory
+      char* pDirBasename = basename(resolvedDirPath);
+
+      outputFilenameStem = string(pDirBasename);
+    }
+
+    //
+    // Add file(s) to be processed to fileNameStemList
+    //
+
+    if (isFile)
+    {
+      fileNameStemList.push_back(outputFilenameStem);
+    }
+    else
+    {
+      // Directories are assumed to require bootstrap code
+      bootstrapRequired = true;
+
+      DIR* dir = opendir(directoryName.c_str());
+
+      if (dir == NULL)
+      {
+        cerr << "Unable to read files in directory." << endl;
+        exit(-1);
+      }
+
+      while(true)
+      {
+        struct dirent* dirEntry;
+
+        errno = 0;
+        dirEntry = readdir(dir);
 
         if (dirEntry == NULL)
         {
@@ -1045,99 +1995,658 @@ class VMTranslator
       puts("No .vm files found.  Exiting normally.");
       exit(0);
     }
+
+    // Directory order is arbitrary; translate in a reproducible order
+    sort(fileNameStemList.begin(), fileNameStemList.end());
+    fileStats.resize(fileNameStemList.size());
+  }
+
+  // Seconds since `since`, which is then reset to now
+  static double lap(chrono::steady_clock::time_point& since)
+  {
+    auto now = chrono::steady_clock::now();
+    chrono::duration<double> elapsed = now - since;
+    since = now;
+
+    return elapsed.count();
   }
 
   void process()
   {
-    CodeWriter writer(directoryName + "/" + outputFilenameStem);
+    auto startTime = chrono::steady_clock::now();
+
+    string outputPathStem = directoryName + "/" + outputFilenameStem;
+
+    if (!options.machineCode)
+    {
+      openOutput(outfile, outputPathStem + ".asm", ofstream::out);
+    }
+
+    size_t bytes = 0;
+    size_t instructions = 0;
+    bool sharedRoutinesUsed = false;
+
+    CodeWriter writer(options);
 
     if (bootstrapRequired)
     {
       writer.writeInit();
     }
 
-    // TODO: If directory name set, open writer file with that name
-    // TODO: Writer is only a single .asm file.  So either way,
-    // can call writer just once.  Why the list of stems for writing?  Just needed for reading.
+    // Parse every file before generating any code so that whole program
+    // passes see all of the functions
+    modules.resize(fileNameStemList.size());
+
+    bool wholeProgram = (options.deadFunctions && bootstrapRequired) ||
+                        (options.profileTop > 0) ||
+                        (options.inlineLimit > 0) ||
+                        options.packStatics || options.foldConstants;
+
+    // Cached translations carry no source positions
+    if (!options.cacheDirectory.empty() && !options.sourceMap)
+    {
+      cache = make_unique<TranslationCache>(options.cacheDirectory);
+      cacheKeys.resize(fileNameStemList.size());
+      cachedFragments.resize(fileNameStemList.size());
+    }
+
+    // Setting up the writer, e.g. its peephole rules, is in no phase
+    auto phaseStart = chrono::steady_clock::now();
+
+    forEachFile([&](size_t i) {
+      // A file found in the cache need not be parsed, unless a whole
+      // program pass is to see it
+      if (cache && !wholeProgram && lookUpCache(i))
+        return;
+
+      const string& filenameStem = fileNameStemList[i];
+      modules[i] = buildModule(directoryName + "/" + filenameStem + ".vm",
+          filenameStem);
+    });
+
+    for (const auto& module : modules)
+      commandsParsed += module.commandCount();
+
+    phaseTimes.parse = lap(phaseStart);
+
+    // Before dead function elimination, which may then find a function
+    // without calls
+    if (options.inlineLimit > 0)
+    {
+      inlinedFunctions = inlineLeafFunctions(modules, options.inlineLimit,
+          INLINE_BUDGET);
+    }
+
+    if (options.deadFunctions && bootstrapRequired)
+    {
+      removedFunctions = removeUnreachableFunctions(modules, "Sys.init");
+    }
+
+    // After -fdce, so that the statics of removed functions take no RAM
+    if (options.packStatics)
+    {
+      staticLayout = StaticLayout(modules);
+
+      if (!staticLayout.fits())
+      {
+        cerr << "Static variables overflow RAM[" << StaticLayout::FIRST_ADDRESS
+             << "-" << StaticLayout::LAST_ADDRESS << "]" << endl;
+        staticLayout.report(cerr);
+        exit(-1);
+      }
+    }
+
+    // After -finline, whose bodies take temps of their own
+    if (options.foldConstants)
+    {
+      spareTemp = findSpareTemp(modules);
+    }
+
+    if (cache && wholeProgram)
+    {
+      forEachFile([&](size_t i) { lookUpCache(i); });
+    }
+
+    if (options.profileTop > 0)
+    {
+      NgramProfile profile;
+
+      for (const auto& module : modules)
+        profile.addModule(module);
+
+      profile.report(cout, options.profileTop);
+    }
+
+    phaseTimes.passes = lap(phaseStart);
 
-    for (auto filenameStem : fileNameStemList)
+    if (options.jobs <= 1)
     {
-      Parser parser(directoryName + "/" + filenameStem + ".vm");
-      writer.setInputFilenameStem(filenameStem);
+      // The bootstrap is not part of the first file
+      flush(writer);
+      phaseTimes.output += lap(phaseStart);
 
-      while (parser.hasMoreCommands())
+      for (size_t i = 0; i < fileNameStemList.size(); i++)
       {
-        parser.advance();
-        auto cmdType = parser.commandType();
+        translateFile(i, writer);
+        phaseTimes.codegen += lap(phaseStart);
+        flush(writer);
+        phaseTimes.output += lap(phaseStart);
+      }
 
-        if (cmdType == C_ARITHMETIC)
-        {
-          writer.writeArithmetic(parser.lineNumber(), parser.arg1());
-        }
-        else if ((cmdType == C_PUSH) || (cmdType == C_POP))
-        {
-          writer.writePushPop(parser.lineNumber(), parser.commandType(),
-              parser.arg1(), parser.args());
-        }
-        else if (cmdType == C_IF_GOTO)
-        {
-          writer.writeIfGoto(parser.lineNumber(), parser.commandType(),
-              parser.arg1());
-        }
-        else if (cmdType == C_LABEL)
-        {
-          writer.writeLabel(parser.lineNumber(), parser.commandType(),
-              parser.arg1());
-        }
-        else if (cmdType == C_GOTO)
-        {
-          writer.writeGoto(parser.lineNumber(), parser.commandType(),
-              parser.arg1());
-        }
-        else if (cmdType == C_FUNCTION)
-        {
-          writer.writeFunction(parser.lineNumber(), parser.commandType(),
-              parser.arg1(), parser.args());
-        }
-        else if (cmdType == C_CALL)
-        {
-          writer.writeCall(parser.lineNumber(), parser.commandType(),
-              parser.arg1(), parser.args());
-        }
-        else if (cmdType == C_RETURN)
+      sharedRoutinesUsed = writer.usesSharedRoutines();
+    }
+    else
+    {
+      flush(writer);
+      phaseTimes.output += lap(phaseStart);
+
+      // Each file is translated by its own writer into its own buffer.
+      // The buffers are then written out in list order, giving the same
+      // output as the serial loop above.
+      vector<CodeWriter> fileWriters(fileNameStemList.size(), CodeWriter(options));
+
+      forEachFile([&](size_t i) {
+        translateFile(i, fileWriters[i]);
+      });
+
+      phaseTimes.codegen += lap(phaseStart);
+
+      for (auto& fileWriter : fileWriters)
+      {
+        flush(fileWriter);
+        bytes += fileWriter.bytesWritten();
+        instructions += fileWriter.instructionsWritten();
+        sharedRoutinesUsed |= fileWriter.usesSharedRoutines();
+      }
+
+      sharedRoutinesUsed |= writer.usesSharedRoutines();
+    }
+
+    phaseTimes.output += lap(phaseStart);
+
+    if (sharedRoutinesUsed)
+    {
+      writer.writeSharedRoutines();
+      phaseTimes.codegen += lap(phaseStart);
+      flush(writer);
+    }
+
+    bytes += writer.bytesWritten();
+    instructions += writer.instructionsWritten();
+
+    if (options.machineCode)
+    {
+      // Second pass once every label is known
+      assembler.resolve();
+
+      ofstream hackfile;
+      openOutput(hackfile, outputPathStem + ".hack", ofstream::out);
+      bytes += assembler.writeHack(hackfile);
+
+      ofstream imagefile;
+      openOutput(imagefile, outputPathStem + ".bin",
+          ofstream::out | ofstream::binary);
+      assembler.writeImage(imagefile);
+    }
+
+    if (options.sourceMap)
+    {
+      ofstream mapfile;
+      openOutput(mapfile, outputPathStem + ".map", ofstream::out);
+      sourceMap.write(mapfile, romAddress);
+    }
+
+    phaseTimes.output += lap(phaseStart);
+
+    if (options.showStats)
+    {
+      chrono::duration<double> elapsed = chrono::steady_clock::now() - startTime;
+      reportStats(bytes, instructions, elapsed.count());
+    }
+  }
+
+  void openOutput(ofstream& file, const string& filename,
+      ios_base::openmode mode)
+  {
+    file.open(filename, mode);
+
+    if (!file.is_open())
+    {
+      cerr << "Failed to open output file, " << filename << endl;
+      exit(-2);
+    }
+  }
+
+  // Pass the code translated by `writer` on to the output
+  void flush(CodeWriter& writer)
+  {
+    if (options.sourceMap)
+    {
+      romAddress = writer.mapSources(sourceMap, romAddress);
+    }
+
+    if (options.machineCode)
+      writer.flushTo(assembler);
+    else
+      writer.flushTo(outfile);
+  }
+
+  // Run task(i) for the index of each file, on options.jobs threads
+  void forEachFile(const function<void(size_t)>& task)
+  {
+    if (options.jobs <= 1)
+    {
+      for (size_t i = 0; i < fileNameStemList.size(); i++)
+      {
+        task(i);
+      }
+
+      return;
+    }
+
+    atomic<size_t> nextFile(0);
+
+    auto worker = [&]() {
+      size_t i;
+
+      while ((i = nextFile++) < fileNameStemList.size())
+      {
+        task(i);
+      }
+    };
+
+    vector<thread> workers;
+    unsigned int threadCount = min<size_t>(options.jobs, fileNameStemList.size());
+
+    for (unsigned int i = 0; i < threadCount; i++)
+    {
+      workers.emplace_back(worker);
+    }
+
+    for (auto& t : workers)
+    {
+      t.join();
+    }
+  }
+
+  // Everything besides the contents of fileNameStemList[fileIndex] that
+  // its translation depends on
+  string cacheContext(size_t fileIndex) const
+  {
+    string context = fileNameStemList[fileIndex];
+
+    context += options.sharedCallReturn ? " -fshared-calls" : "";
+    context += options.peephole ? " -fpeephole" : "";
+    context += options.superinstructions ? " -fsuperinstructions" : "";
+    context += options.cacheTop ? " -fcache-top" : "";
+    context += options.sharedCompare ? " -fshared-compare" : "";
+    context += options.foldConstants ?
+        " -ffold-constants=" + to_string(spareTemp) : "";
+    context += options.shortOffsets ? " -fshort-offsets" : "";
+    context += options.compactFrames ? " -fcompact-frames" : "";
+    context += options.tailCalls ? " -ftail-calls" : "";
+
+    // Every file's statics, as inlined bodies may use those of another
+    if (options.packStatics)
+    {
+      context += " -fpack-statics ";
+      context += staticLayout.describe();
+    }
+
+    // The bodies that may have replaced calls of this file
+    if (options.inlineLimit > 0)
+    {
+      context += " -finline=" + to_string(options.inlineLimit);
+
+      for (const auto& function : inlinedFunctions)
+      {
+        context += " ";
+        context += function.name;
+        context += "@";
+        context += function.file;
+        context += ":";
+
+        for (const auto& cmd : function.body)
         {
-          writer.writeReturn(parser.lineNumber(), parser.commandType());
+          context += to_string(cmd.type) + "," + to_string(cmd.arithmetic) +
+                     "," + to_string(cmd.segment) + "," +
+                     to_string(cmd.index) + ",";
+          context += cmd.name;
+          context += ";";
         }
+      }
+    }
+
+    // The functions left by dead function elimination
+    if (options.deadFunctions && bootstrapRequired)
+    {
+      context += " -fdce";
+
+      for (const auto& function : modules[fileIndex].functions)
+      {
+        context += " ";
+        context += function.name();
+      }
+    }
+
+    return context;
+  }
+
+  // Find the translation of fileNameStemList[fileIndex] in the cache.
+  // Returns true if found.
+  bool lookUpCache(size_t fileIndex)
+  {
+    MappedFile file(directoryName + "/" + fileNameStemList[fileIndex] + ".vm");
+
+    cacheKeys[fileIndex] = cache->key(file.contents(),
+        cacheContext(fileIndex));
+
+    fileStats[fileIndex].cached = cache->load(cacheKeys[fileIndex],
+        cachedFragments[fileIndex]);
+
+    return fileStats[fileIndex].cached;
+  }
+
+  // Translate the parsed commands of the file fileNameStemList[fileIndex]
+  void translateFile(size_t fileIndex, CodeWriter& writer)
+  {
+    FileStats& stats = fileStats[fileIndex];
+
+    if (options.packStatics)
+    {
+      writer.useStaticLayout(&staticLayout);
+    }
+
+    if (stats.cached)
+    {
+      writer.writeFragment(cachedFragments[fileIndex]);
+      stats.before = writer.instructionsPending();
+      stats.after = stats.before;
+      return;
+    }
+
+    // After -finline, which may bring constant arguments to the code that
+    // uses them
+    if (options.foldConstants)
+    {
+      stats.folding = foldConstants(modules[fileIndex], spareTemp);
+    }
+
+    writer.writeModule(modules[fileIndex]);
+
+    // Each file is optimized on its own, by whichever thread translated it
+    stats.before = writer.instructionsPending();
+    stats.after = stats.before;
+
+    if (options.peephole)
+    {
+      stats.after -= writer.optimizePeephole();
+    }
+
+    if (cache)
+    {
+      cache->store(cacheKeys[fileIndex], writer.pendingText());
+    }
+  }
+
+  void reportStats(size_t bytes, size_t instructions, double seconds)
+  {
+    // Guard against a clock too coarse to measure small inputs
+    if (seconds <= 0.0)
+      seconds = 1e-9;
+
+    cout << "Translated " << fileNameStemList.size() << " file(s) in "
+         << seconds * 1000.0 << " ms";
+
+    if (options.jobs > 1)
+      cout << " using " << options.jobs << " threads";
+
+    cout << endl;
+    cout << "  " << instructions << " instructions, " << bytes << " bytes"
+         << endl;
+    cout << "  " << instructions / seconds << " instructions/s, "
+         << bytes / seconds / (1024.0 * 1024.0) << " MiB/s" << endl;
+    cout << "  " << commandsParsed << " commands parsed, "
+         << commandsParsed / max(phaseTimes.parse, 1e-9) << " commands/s"
+         << endl;
+    cout << "  Phases: parse " << phaseTimes.parse * 1000.0 << " ms, passes "
+         << phaseTimes.passes * 1000.0 << " ms, code generation "
+         << phaseTimes.codegen * 1000.0 << " ms, output "
+         << phaseTimes.output * 1000.0 << " ms" << endl;
+
+    if (options.inlineLimit > 0)
+    {
+      cout << "Inlining: " << inlinedFunctions.size() << " function(s)"
+           << endl;
+
+      for (const auto& function : inlinedFunctions)
+      {
+        cout << "  " << function.name << ": " << function.body.size()
+             << " command(s) at " << function.sites << " call site(s)"
+             << endl;
+      }
+    }
+
+    if (options.packStatics)
+    {
+      staticLayout.report(cout);
+    }
+
+    if (options.foldConstants)
+    {
+      FoldingStats total;
+
+      for (const auto& stats : fileStats)
+      {
+        total.folded += stats.folding.folded;
+        total.callsReplaced += stats.folding.callsReplaced;
+      }
+
+      cout << "Constant folding: " << total.folded << " operation(s), "
+           << total.callsReplaced << " call(s) of Math.multiply or "
+           << "Math.divide replaced" << endl;
+    }
+
+    if (options.deadFunctions)
+    {
+      size_t remaining = 0;
+
+      for (const auto& module : modules)
+      {
+        for (const auto& function : module.functions)
+          remaining += (function.entry.type == C_FUNCTION);
+      }
+
+      cout << "Dead function elimination: removed " << removedFunctions.size()
+           << " function(s), " << remaining << " remain" << endl;
+
+      for (const auto& name : removedFunctions)
+      {
+        cout << "  " << name << endl;
+      }
+    }
+
+    if (options.peephole)
+    {
+      cout << "Peephole optimization:" << endl;
+
+      for (size_t i = 0; i < fileNameStemList.size(); i++)
+      {
+        cout << "  " << fileNameStemList[i] << ": ";
+
+        if (fileStats[i].cached)
+          cout << fileStats[i].after << " instructions (cached)" << endl;
         else
-        {
-          ASSERT(0, string("Unsupported cmdType."));
-        }
+          cout << fileStats[i].before << " -> " << fileStats[i].after
+               << " instructions" << endl;
       }
     }
+
+    if (cache)
+    {
+      size_t reused = count_if(fileStats.begin(), fileStats.end(),
+          [](const FileStats& stats) { return stats.cached; });
+
+      cout << "Translation cache: reused " << reused << " of "
+           << fileNameStemList.size() << " file(s)" << endl;
+    }
   }
 };
 
 int main(int argc, char** argv)
 {
-  if (argc != 2)
+  TranslatorOptions options;
+  int argi = 1;
+
+  for (; argi < argc - 1; argi++)
+  {
+    if (strcmp(argv[argi], "-s") == 0)
+    {
+      options.showStats = true;
+    }
+    else if (strcmp(argv[argi], "-b") == 0)
+    {
+      options.machineCode = true;
+    }
+    else if (strcmp(argv[argi], "-m") == 0)
+    {
+      options.sourceMap = true;
+    }
+    else if ((strcmp(argv[argi], "-j") == 0) && (argi + 1 < argc - 1))
+    {
+      int jobs = atoi(argv[++argi]);
+
+      // -j 0 selects one thread per available core
+      options.jobs = (jobs > 0) ? jobs : max(1u, thread::hardware_concurrency());
+    }
+    else if ((strcmp(argv[argi], "-p") == 0) && (argi + 1 < argc - 1))
+    {
+      int top = atoi(argv[++argi]);
+      options.profileTop = (top > 0) ? top : 0;
+    }
+    else if ((strcmp(argv[argi], "-c") == 0) && (argi + 1 < argc - 1))
+    {
+      options.cacheDirectory = argv[++argi];
+    }
+    else if (strcmp(argv[argi], "-fshared-calls") == 0)
+    {
+      options.sharedCallReturn = true;
+    }
+    else if (strcmp(argv[argi], "-fpeephole") == 0)
+    {
+      options.peephole = true;
+    }
+    else if (strcmp(argv[argi], "-fdce") == 0)
+    {
+      options.deadFunctions = true;
+    }
+    else if (strcmp(argv[argi], "-fsuperinstructions") == 0)
+    {
+      options.superinstructions = true;
+    }
+    else if (strcmp(argv[argi], "-fcache-top") == 0)
+    {
+      options.cacheTop = true;
+    }
+    else if (strcmp(argv[argi], "-fshared-compare") == 0)
+    {
+      options.sharedCompare = true;
+    }
+    else if (strcmp(argv[argi], "-ffold-constants") == 0)
+    {
+      options.foldConstants = true;
+    }
+    else if (strcmp(argv[argi], "-fshort-offsets") == 0)
+    {
+      options.shortOffsets = true;
+    }
+    else if (strcmp(argv[argi], "-fcompact-frames") == 0)
+    {
+      options.compactFrames = true;
+    }
+    else if (strcmp(argv[argi], "-fpack-statics") == 0)
+    {
+      options.packStatics = true;
+    }
+    else if (strcmp(argv[argi], "-ftail-calls") == 0)
+    {
+      options.tailCalls = true;
+    }
+    else if (strcmp(argv[argi], "-finline") == 0)
+    {
+      options.inlineLimit = INLINE_LIMIT;
+    }
+    else if (strncmp(argv[argi], "-finline=", 9) == 0)
+    {
+      int limit = atoi(argv[argi] + 9);
+      options.inlineLimit = (limit > 0) ? limit : 0;
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  if (argi != argc - 1)
   {
-    cout << "USAGE: vmt [-h] FILENAME.vm | DIRECTORY | ." << endl;
+    cout << "USAGE: vmt [-h] [-s] [-b] [-m] [-j N] [-p N] [-c DIR] [-fOPTIMIZATION] FILENAME.vm | DIRECTORY | ." << endl;
     return 1;
   }
 
-  if (strcmp(argv[1], "-h") == 0)
+  if (strcmp(argv[argi], "-h") == 0)
   {
     cout << "USAGE:\n\n"
-              << "    vmt FILENAME.vm\n\n"
-              << "    vmt DIRECTORY | .\n\n"
+              << "    vmt [-s] [-b] [-m] [-p N] [-c DIR] [-fOPTIMIZATION] FILENAME.vm\n\n"
+              << "    vmt [-s] [-b] [-m] [-j N] [-p N] [-c DIR] [-fOPTIMIZATION] DIRECTORY | .\n\n"
               << "DESCRIPTION\n\n"
               << "    Parses the VM commands found in FILENAME.vm into the corresponding Hack\n"
               << "    assembly code file, FILENAME.asm.  When provided the argument DIRECTORY,\n"
-              << "    all .vm files will be translated into DIRECTORY.asm.\n" << endl;
+              << "    all .vm files will be translated into DIRECTORY.asm.\n\n"
+              << "OPTIONS\n\n"
+              << "    -s    Report instructions and bytes emitted per second\n"
+              << "    -b    Assemble the translation, writing FILENAME.hack and the raw\n"
+              << "          16-bit image FILENAME.bin in place of FILENAME.asm\n"
+              << "    -m    Write FILENAME.map, the ROM address range of the code of each\n"
+              << "          VM line and of its Jack line when the VM has jfcl -g comments\n"
+              << "    -j N  Translate the files of DIRECTORY using N threads (0: one per core)\n"
+              << "    -p N  Report the N most frequent sequences of 2 to 4 VM commands\n"
+              << "    -c DIR  Keep the translation of each file in the directory DIR and\n"
+              << "          reuse it while the file and the options are unchanged\n\n"
+              << "OPTIMIZATIONS\n\n"
+              << "    -fshared-calls  Route every call and return through one shared\n"
+              << "                    $$CALL and $$RETURN routine to reduce ROM size\n"
+              << "    -fpeephole      Replace common instruction sequences, such as a push\n"
+              << "                    followed by a pop, with shorter equivalents\n"
+              << "    -fdce           Omit the functions of DIRECTORY that cannot be reached\n"
+              << "                    by calls from Sys.init\n"
+              << "    -fsuperinstructions  Translate frequent command sequences, such as an\n"
+              << "                    array load or an increment of a variable, as a unit\n"
+              << "    -fcache-top     Keep the top of the stack in D within a block instead\n"
+              << "                    of storing and reloading it through RAM\n"
+              << "    -fshared-compare  Evaluate eq, lt and gt in one shared $$EQ, $$LT\n"
+              << "                    and $$GT routine to reduce ROM size\n"
+              << "    -finline[=N]    Replace the calls of functions of up to N (default\n"
+              << "                    " << INLINE_LIMIT << ") commands that call nothing with their bodies\n"
+              << "    -ffold-constants  Evaluate arithmetic on constants and replace\n"
+              << "                    multiplication by a power of two with additions\n"
+              << "    -fshort-offsets  Address local, argument, this and that entries 0 to\n"
+              << "                    " << MAX_SHORT_OFFSET << " by incrementing A, without adding the index in D\n"
+              << "    -fcompact-frames  Zero the locals of a function with one update of SP\n"
+              << "                    and compute ARG and LCL of a call from one load of SP\n"
+              << "    -fpack-statics  Place the static variables used in RAM[16-255] in file\n"
+              << "                    name order, failing if they do not fit, and with -s\n"
+              << "                    report the RAM each file's statics take\n"
+              << "    -ftail-calls    Translate a call followed by return as a jump that\n"
+              << "                    reuses the frame of the calling function\n" << endl;
     return 0;
   }
 
-  VMTranslator vmTranslator(argv[1]);
+  // The peephole patterns rely on D being dead between commands, which
+  // no longer holds once the top of stack is kept in D
+  if (options.cacheTop)
+    options.peephole = false;
+
+  VMTranslator vmTranslator(argv[argi], options);
 
   vmTranslator.process();
 
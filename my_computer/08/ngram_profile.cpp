@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+#include "ngram_profile.h"
+
+using namespace std;
+
+string ngramText(const VmCommand& cmd)
+{
+  switch (cmd.type)
+  {
+    case C_ARITHMETIC:
+      return arithmeticName(cmd.arithmetic);
+    case C_PUSH:
+    case C_POP:
+    {
+      string text = (cmd.type == C_PUSH) ? "push " : "pop ";
+
+      text += segmentName(cmd.segment);
+
+      if ((cmd.segment == S_CONSTANT) || (cmd.segment == S_POINTER))
+        return text + " " + to_string(cmd.index);
+
+      return text + " K";
+    }
+    case C_LABEL:
+      return "label";
+    case C_GOTO:
+      return "goto";
+    case C_IF_GOTO:
+      return "if-goto";
+    case C_FUNCTION:
+      return "function";
+    case C_CALL:
+      return "call";
+    case C_RETURN:
+      return "return";
+    default:
+      return "?";
+  }
+}
+
+void NgramProfile::addModule(const VmModule& module)
+{
+  for (const auto& function : module.functions)
+  {
+    for (const auto& block : function.blocks)
+    {
+      vector<string> texts;
+
+      for (const auto& cmd : block.commands)
+      {
+        if (cmd.type != C_LABEL)
+          texts.push_back(ngramText(cmd));
+      }
+
+      for (size_t first = 0; first < texts.size(); first++)
+      {
+        string sequence = texts[first];
+
+        for (size_t length = 2;
+             (length <= MAX_LENGTH) && (first + length <= texts.size());
+             length++)
+        {
+          sequence += "; " + texts[first + length - 1];
+          counts[length][sequence]++;
+        }
+      }
+    }
+  }
+}
+
+void NgramProfile::report(ostream& out, size_t top) const
+{
+  for (size_t length = 2; length <= MAX_LENGTH; length++)
+  {
+    vector<pair<string, uint64_t>> sorted(counts[length].begin(),
+                                          counts[length].end());
+
+    // Most frequent first, ties in text order for a reproducible report
+    sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+      return (a.second != b.second) ? (a.second > b.second) : (a.first < b.first);
+    });
+
+    if (sorted.size() > top)
+      sorted.resize(top);
+
+    out << "Most frequent sequences of " << length << " commands:" << endl;
+
+    for (const auto& [sequence, count] : sorted)
+      out << setw(8) << count << "  " << sequence << endl;
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include "vm_ir.h"
+
+/* NgramProfile - Counts how often each sequence of 2 to MAX_LENGTH    */
+/*                commands appears in a set of modules.  Sequences do */
+/*                not extend across labels or branches, as only the    */
+/*                commands of a block could be translated together.    */
+/*                                                                     */
+/*                Commands are compared by operation: the index of a   */
+/*                push or pop is kept for the constant and pointer     */
+/*                segments and written as K for the others, so         */
+/*                "push local 2; push constant 1; add" and the same    */
+/*                with local 5 count as one sequence.                  */
+class NgramProfile {
+public:
+  static constexpr size_t MAX_LENGTH = 4;
+
+private:
+  std::unordered_map<std::string, uint64_t> counts[MAX_LENGTH + 1];
+
+public:
+
+  void addModule(const VmModule& module);
+
+  // Write the `top` most frequent sequences of each length
+  void report(std::ostream& out, size_t top) const;
+};
+
+// Text of `cmd` as NgramProfile compares it, e.g. "push local K"
+std::string ngramText(const VmCommand& cmd);
@@ -0,0 +1,476 @@
+#include "parser.h"
+
+#include <charconv>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+struct Opcode {
+  string_view text;
+  Command_t type;
+  Arithmetic_t arithmetic;
+};
+
+// Ordered roughly by frequency in compiled Jack programs
+const Opcode opcodes[] = {
+  {"push",     C_PUSH,       A_NONE},
+  {"pop",      C_POP,        A_NONE},
+  {"call",     C_CALL,       A_NONE},
+  {"add",      C_ARITHMETIC, A_ADD},
+  {"label",    C_LABEL,      A_NONE},
+  {"if-goto",  C_IF_GOTO,    A_NONE},
+  {"goto",     C_GOTO,       A_NONE},
+  {"not",      C_ARITHMETIC, A_NOT},
+  {"return",   C_RETURN,     A_NONE},
+  {"function", C_FUNCTION,   A_NONE},
+  {"sub",      C_ARITHMETIC, A_SUB},
+  {"eq",       C_ARITHMETIC, A_EQ},
+  {"lt",       C_ARITHMETIC, A_LT},
+  {"gt",       C_ARITHMETIC, A_GT},
+  {"neg",      C_ARITHMETIC, A_NEG},
+  {"and",      C_ARITHMETIC, A_AND},
+  {"or",       C_ARITHMETIC, A_OR},
+};
+
+const struct {
+  string_view text;
+  Segment_t segment;
+} segments[] = {
+  {"local",    S_LOCAL},
+  {"argument", S_ARGUMENT},
+  {"constant", S_CONSTANT},
+  {"that",     S_THAT},
+  {"this",     S_THIS},
+  {"pointer",  S_POINTER},
+  {"temp",     S_TEMP},
+  {"static",   S_STATIC},
+};
+
+// Largest constant a push may give, as the code loads it with an
+// A-instruction
+const int MAX_CONSTANT = 32767;
+
+// Binary form: the header and the opcodes beyond arithmetic, which is
+// 0x01-0x09 in Arithmetic_t order.  Push and pop add the Segment_t.
+const string_view BINARY_MAGIC("\0VMB\1", 5);
+
+const unsigned char OP_PUSH = 0x10;
+const unsigned char OP_POP = 0x20;
+const unsigned char OP_LABEL = 0x30;
+const unsigned char OP_GOTO = 0x31;
+const unsigned char OP_IF_GOTO = 0x32;
+const unsigned char OP_FUNCTION = 0x33;
+const unsigned char OP_CALL = 0x34;
+const unsigned char OP_RETURN = 0x35;
+const unsigned char OP_LINE = 0x36;
+
+inline bool isBlank(char c)
+{
+  return (c == ' ') || (c == '\t');
+}
+
+inline bool isEndOfCommand(const char* p, const char* end)
+{
+  return (p == end) || (*p == '\n') || (*p == '\r') ||
+         ((*p == '/') && (p + 1 < end) && (p[1] == '/'));
+}
+
+}  // namespace
+
+const char* arithmeticName(Arithmetic_t arithmetic)
+{
+  for (const auto& opcode : opcodes)
+  {
+    if ((opcode.type == C_ARITHMETIC) && (opcode.arithmetic == arithmetic))
+      return opcode.text.data();
+  }
+
+  return "";
+}
+
+const char* segmentName(Segment_t segment)
+{
+  for (const auto& entry : segments)
+  {
+    if (entry.segment == segment)
+      return entry.text.data();
+  }
+
+  return "";
+}
+
+MappedFile::MappedFile(const string& pathname)
+{
+  int fd = open(pathname.c_str(), O_RDONLY);
+
+  if (fd < 0)
+  {
+    cerr << "Failed to open input file, " << pathname << endl;
+    exit(-2);
+  }
+
+  struct stat fileStat;
+
+  if (fstat(fd, &fileStat) != 0)
+  {
+    cerr << "Failed to read input file, " << pathname << endl;
+    exit(-2);
+  }
+
+  length = static_cast<size_t>(fileStat.st_size);
+
+  // mmap() rejects zero length mappings; an empty file has no commands
+  if (length > 0)
+  {
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (mapping == MAP_FAILED)
+    {
+      cerr << "Failed to map input file, " << pathname << endl;
+      exit(-2);
+    }
+
+    data = static_cast<const char*>(mapping);
+  }
+
+  close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (data != nullptr)
+  {
+    munmap(const_cast<char*>(data), length);
+  }
+}
+
+Parser::Parser(string filePathname) :
+  pathname(filePathname), file(make_shared<MappedFile>(pathname))
+{
+  cursor = file->contents().data();
+  end = cursor + file->contents().size();
+
+  if (file->contents().substr(0, 4) == BINARY_MAGIC.substr(0, 4))
+    readBinaryHeader();
+}
+
+void Parser::error(const char* what, string_view text) const
+{
+  cerr << pathname << ":" << currentLineNumber << ": " << what << ": "
+       << text << endl;
+  exit(-1);
+}
+
+// Position `cursor` at the first character of the next command, skipping
+// blank lines, comment lines and leading white space.  Returns false when
+// no commands remain.
+bool Parser::skipToCommand()
+{
+  if (binary)
+    return skipToBinaryCommand();
+
+  while (cursor != end)
+  {
+    while ((cursor != end) && isBlank(*cursor))
+      cursor++;
+
+    if (!isEndOfCommand(cursor, end))
+      return true;
+
+    // Nothing but a comment or line ending remains on this line
+    readLineComment();
+
+    while ((cursor != end) && (*cursor != '\n'))
+      cursor++;
+
+    if (cursor != end)
+    {
+      cursor++;
+      currentLineNumber++;
+    }
+  }
+
+  return false;
+}
+
+// Take the Jack line of a "// line N" comment at the cursor
+void Parser::readLineComment()
+{
+  static constexpr string_view LINE_COMMENT = "// line ";
+
+  if ((static_cast<size_t>(end - cursor) <= LINE_COMMENT.size()) ||
+      (string_view(cursor, LINE_COMMENT.size()) != LINE_COMMENT))
+  {
+    return;
+  }
+
+  const char* digits = cursor + LINE_COMMENT.size();
+  int line;
+
+  if (from_chars(digits, end, line).ec == errc())
+    currentSourceLine = line;
+}
+
+void Parser::advance()
+{
+  if (binary)
+  {
+    advanceBinary();
+    return;
+  }
+
+  skipToCommand();
+
+  currentLineNumber++;
+
+  // Split the line into at most three white space separated fields
+  string_view fields[3];
+  int fieldCount = 0;
+
+  while (!isEndOfCommand(cursor, end))
+  {
+    const char* start = cursor;
+
+    while (!isEndOfCommand(cursor, end) && !isBlank(*cursor))
+      cursor++;
+
+    if (fieldCount == 3)
+      error("Too many arguments", string_view(start, cursor - start));
+
+    fields[fieldCount++] = string_view(start, cursor - start);
+
+    while ((cursor != end) && isBlank(*cursor))
+      cursor++;
+  }
+
+  // Discard any trailing comment and the line ending
+  while ((cursor != end) && (*cursor != '\n'))
+    cursor++;
+
+  if (cursor != end)
+    cursor++;
+
+  current = VmCommand();
+  current.lineNumber = currentLineNumber;
+  current.sourceLine = currentSourceLine;
+
+  for (const auto& opcode : opcodes)
+  {
+    if (opcode.text == fields[0])
+    {
+      current.type = opcode.type;
+      current.arithmetic = opcode.arithmetic;
+      break;
+    }
+  }
+
+  int expectedFields;
+
+  switch (current.type)
+  {
+    case C_ARITHMETIC:
+    case C_RETURN:
+      expectedFields = 1;
+      break;
+    case C_LABEL:
+    case C_GOTO:
+    case C_IF_GOTO:
+      expectedFields = 2;
+      break;
+    case C_FUNCTION:
+      // Its Jack line comes with its first statement
+      current.sourceLine = currentSourceLine = 0;
+      expectedFields = 3;
+      break;
+    case C_PUSH:
+    case C_POP:
+    case C_CALL:
+      expectedFields = 3;
+      break;
+    default:
+      error("Unsupported command", fields[0]);
+  }
+
+  if (fieldCount != expectedFields)
+    error("Wrong number of arguments", fields[0]);
+
+  if (expectedFields == 3)
+  {
+    auto first = fields[2].data();
+    auto last = first + fields[2].size();
+    auto result = from_chars(first, last, current.index);
+
+    if ((result.ec != errc()) || (result.ptr != last) || (current.index < 0))
+      error("Invalid index", fields[2]);
+  }
+
+  if ((current.type == C_PUSH) || (current.type == C_POP))
+  {
+    for (const auto& entry : segments)
+    {
+      if (entry.text == fields[1])
+      {
+        current.segment = entry.segment;
+        break;
+      }
+    }
+
+    if (current.segment == S_NONE)
+      error("Unsupported segment", fields[1]);
+
+    if ((current.segment == S_CONSTANT) && (current.index > MAX_CONSTANT))
+      error("Invalid index", fields[2]);
+  }
+  else if (expectedFields >= 2)
+  {
+    current.name = fields[1];
+  }
+}
+
+unsigned int Parser::readVarint()
+{
+  unsigned int value = 0;
+
+  for (int shift = 0; shift < 32; shift += 7)
+  {
+    if (cursor == end)
+      error("Truncated binary command", "");
+
+    unsigned char byte = static_cast<unsigned char>(*cursor++);
+    value |= static_cast<unsigned int>(byte & 0x7f) << shift;
+
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+
+  error("Invalid binary number", "");
+}
+
+int Parser::readNumber(int limit, const char* what)
+{
+  unsigned int value = readVarint();
+
+  if (value > static_cast<unsigned int>(limit))
+    error(what, to_string(value));
+
+  return static_cast<int>(value);
+}
+
+string_view Parser::readString()
+{
+  unsigned int index = readVarint();
+
+  if (index >= strings.size())
+    error("Invalid binary string index", to_string(index));
+
+  return strings[index];
+}
+
+void Parser::readBinaryHeader()
+{
+  if (file->contents().substr(0, BINARY_MAGIC.size()) != BINARY_MAGIC)
+    error("Unsupported binary version", "");
+
+  binary = true;
+  cursor += BINARY_MAGIC.size();
+
+  // The names are used in place within the mapped file
+  unsigned int count = readVarint();
+
+  for (unsigned int i = 0; i < count; i++)
+  {
+    unsigned int length = readVarint();
+
+    if (static_cast<size_t>(end - cursor) < length)
+      error("Truncated binary string table", "");
+
+    strings.emplace_back(cursor, length);
+    cursor += length;
+  }
+}
+
+bool Parser::skipToBinaryCommand()
+{
+  // A "// line N" comment, giving the Jack line of the commands after it
+  while ((cursor != end) && (static_cast<unsigned char>(*cursor) == OP_LINE))
+  {
+    cursor++;
+    currentSourceLine = readNumber(INT_MAX, "Invalid line number");
+    currentLineNumber++;
+  }
+
+  return cursor != end;
+}
+
+void Parser::advanceBinary()
+{
+  skipToBinaryCommand();
+
+  currentLineNumber++;
+
+  unsigned char opcode = static_cast<unsigned char>(*cursor++);
+
+  current = VmCommand();
+  current.lineNumber = currentLineNumber;
+  current.sourceLine = currentSourceLine;
+
+  if ((opcode >= A_ADD) && (opcode <= A_NOT))
+  {
+    current.type = C_ARITHMETIC;
+    current.arithmetic = static_cast<Arithmetic_t>(opcode);
+    return;
+  }
+
+  unsigned char kind = opcode & 0xf0;
+  unsigned char segment = opcode & 0x0f;
+
+  if (((kind == OP_PUSH) || (kind == OP_POP)) && (segment >= S_ARGUMENT) &&
+      (segment <= S_TEMP))
+  {
+    current.type = (kind == OP_PUSH) ? C_PUSH : C_POP;
+    current.segment = static_cast<Segment_t>(segment);
+    current.index = readNumber(
+        (current.segment == S_CONSTANT) ? MAX_CONSTANT : INT_MAX,
+        "Invalid index");
+    return;
+  }
+
+  switch (opcode)
+  {
+    case OP_LABEL:
+      current.type = C_LABEL;
+      break;
+    case OP_GOTO:
+      current.type = C_GOTO;
+      break;
+    case OP_IF_GOTO:
+      current.type = C_IF_GOTO;
+      break;
+    case OP_FUNCTION:
+      current.type = C_FUNCTION;
+      current.sourceLine = currentSourceLine = 0;
+      break;
+    case OP_CALL:
+      current.type = C_CALL;
+      break;
+    case OP_RETURN:
+      current.type = C_RETURN;
+      return;
+    default:
+      error("Unsupported binary command", to_string(opcode));
+  }
+
+  current.name = readString();
+
+  if ((current.type == C_FUNCTION) || (current.type == C_CALL))
+    current.index = readNumber(INT_MAX, "Invalid index");
+}
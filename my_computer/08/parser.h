@@ -0,0 +1,144 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+typedef enum {
+  C_NONE,
+  C_ARITHMETIC,
+  C_PUSH,
+  C_POP,
+  C_LABEL,
+  C_GOTO,
+  C_IF_GOTO,
+  C_FUNCTION,
+  C_CALL,
+  C_RETURN,
+} Command_t;
+
+typedef enum {
+  A_NONE,
+  A_ADD,
+  A_SUB,
+  A_NEG,
+  A_EQ,
+  A_GT,
+  A_LT,
+  A_AND,
+  A_OR,
+  A_NOT,
+} Arithmetic_t;
+
+typedef enum {
+  S_NONE,
+  S_ARGUMENT,
+  S_LOCAL,
+  S_STATIC,
+  S_CONSTANT,
+  S_THIS,
+  S_THAT,
+  S_POINTER,
+  S_TEMP,
+} Segment_t;
+
+// VM spelling of the enumerations, e.g. "add" and "local"
+const char* arithmeticName(Arithmetic_t);
+const char* segmentName(Segment_t);
+
+/* VmCommand - A single classified VM command.  `name` refers to the */
+/*             label or function name within the mapped input file.  */
+struct VmCommand {
+  Command_t type = C_NONE;
+  Arithmetic_t arithmetic = A_NONE;   // C_ARITHMETIC
+  Segment_t segment = S_NONE;         // C_PUSH, C_POP
+  int index = 0;                      // C_PUSH, C_POP, C_FUNCTION, C_CALL
+  std::string_view name;              // C_LABEL, C_*GOTO, C_FUNCTION, C_CALL
+  int lineNumber = 0;
+
+  // Line of the Jack statement the command belongs to, from the last
+  // "// line N" comment before it (jfcl -g), or 0
+  int sourceLine = 0;
+
+  // C_PUSH, C_POP of static moved from another file, e.g. by inlining:
+  // the stem of that file.  Empty for the file being translated.
+  std::string_view file;
+};
+
+/* MappedFile - Read-only memory mapping of an entire file */
+class MappedFile {
+  const char* data = nullptr;
+  size_t length = 0;
+
+public:
+  MappedFile(const std::string& pathname);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view contents() const { return std::string_view(data, length); }
+};
+
+/* Parser - Handles the parsing of a single .vm file     */
+/*          Reads VM cmmands, parses them, and provides  */
+/*          access to their components.  All white space */
+/*          and comments are removed.                    */
+/*                                                       */
+/*          The file is memory mapped and scanned once;  */
+/*          each command is classified as it is reached  */
+/*          without copying any of its text.             */
+/*                                                       */
+/*          A file beginning with "\0VMB" holds the      */
+/*          binary form that `jfcl -b` writes (see       */
+/*          11v2/src/lib/vmwriter/vm_binary.h).  Its     */
+/*          commands are numbered as the lines of the    */
+/*          text form would be.                          */
+class Parser {
+  const std::string pathname;
+  std::shared_ptr<const MappedFile> file;
+  const char* cursor;
+  const char* end;
+  int currentLineNumber = 0;
+  int currentSourceLine = 0;
+  VmCommand current;
+
+  bool binary = false;
+  std::vector<std::string_view> strings;    // string table of the binary form
+
+  bool skipToCommand();
+  void readLineComment();
+  [[noreturn]] void error(const char* what, std::string_view text) const;
+
+  unsigned int readVarint();
+
+  // A varint of at most `limit`, failing with `what` otherwise
+  int readNumber(int limit, const char* what);
+  std::string_view readString();
+  void readBinaryHeader();
+  bool skipToBinaryCommand();
+  void advanceBinary();
+
+public:
+
+  // Open the input file and get ready to parse it
+  Parser(std::string pathname);
+
+  // Are there more commands in the input?
+  bool hasMoreCommands() { return skipToCommand(); }
+
+  // Reads the next command from the input file and makes it the
+  // current command.  Should be called only if hasMoreCommands() is true.
+  // Initially there is no current command.
+  void advance();
+
+  const VmCommand& command() const { return current; }
+
+  // The mapped input file.  Names in the parsed commands remain valid for
+  // as long as a reference to it is held.
+  std::shared_ptr<const MappedFile> source() const { return file; }
+
+  Command_t commandType() const { return current.type; }
+  int lineNumber() const { return current.lineNumber; }
+};
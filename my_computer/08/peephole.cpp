@@ -0,0 +1,263 @@
+#include "peephole.h"
+
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+using namespace std;
+
+/* Peephole - Pattern based rewriting of the generated assembly.          */
+/*                                                                        */
+/*            Each pattern lists the instructions it matches and the      */
+/*            instructions that replace them.  Besides literal text, a    */
+/*            pattern line may be a capture of an A-instruction:          */
+/*                                                                        */
+/*              @$N   any A-instruction                                   */
+/*              @#N   a numeric A-instruction, e.g. @17                   */
+/*              @!N   any A-instruction except @SP and @R15, i.e. one     */
+/*                    whose value does not change across the pattern      */
+/*                                                                        */
+/*            A capture used twice must match the same line both times,   */
+/*            and names that line within the replacement.                 */
+/*                                                                        */
+/*            Comments are skipped and kept ahead of the replacement.     */
+/*            Labels are jump targets, so no pattern matches across one.  */
+/*            The rewrites rely on D being dead at the start of each VM   */
+/*            command and on nothing reading the stack above SP.          */
+
+namespace {
+
+#define PUSH_D   "@SP", "AM=M+1", "A=A-1", "M=D"
+#define POP_D    "@SP", "AM=M-1", "D=M"
+
+// Address computation of pop local/argument/this/that into R15
+#define POP_ADDRESS   "@!2", "AD=M", "@#3", "D=D+A", "@R15", "M=D"
+#define POP_STORE     "@R15", "A=M", "M=D"
+
+struct Pattern {
+  vector<string_view> match;
+  vector<string_view> replacement;
+};
+
+const Pattern patterns[] = {
+  // push constant/static/temp/pointer/local...; pop local...
+  // Compute the destination first so the value never visits the stack
+  { {"@#1", "D=A", PUSH_D, POP_ADDRESS, POP_D, POP_STORE},
+    {POP_ADDRESS, "@#1", "D=A", POP_STORE} },
+  { {"@!1", "D=M", PUSH_D, POP_ADDRESS, POP_D, POP_STORE},
+    {POP_ADDRESS, "@!1", "D=M", POP_STORE} },
+  { {"@!1", "D=M", "@#4", "AD=D+A", "D=M", PUSH_D, POP_ADDRESS, POP_D, POP_STORE},
+    {POP_ADDRESS, "@!1", "D=M", "@#4", "AD=D+A", "D=M", POP_STORE} },
+
+  // push x; add/sub/and/or -- operate on the top of stack directly
+  { {PUSH_D, POP_D, "A=A-1", "M=D+M"}, {"@SP", "A=M-1", "M=D+M"} },
+  { {PUSH_D, POP_D, "A=A-1", "M=M-D"}, {"@SP", "A=M-1", "M=M-D"} },
+  { {PUSH_D, POP_D, "A=A-1", "M=D&M"}, {"@SP", "A=M-1", "M=D&M"} },
+  { {PUSH_D, POP_D, "A=A-1", "M=D|M"}, {"@SP", "A=M-1", "M=D|M"} },
+
+  // push x; eq/lt/gt
+  { {PUSH_D, POP_D, "A=A-1", "D=M-D"}, {"@SP", "A=M-1", "D=M-D"} },
+
+  // push x; if-goto
+  { {PUSH_D, "@SP", "M=M-1", "A=M", "D=M", "@$1", "D;JNE"},
+    {"@$1", "D;JNE"} },
+
+  // push x; neg/not
+  { {PUSH_D, "@SP", "A=M-1", "D=M", "M=-D"}, {PUSH_D, "M=-D"} },
+  { {PUSH_D, "@SP", "A=M-1", "D=M", "M=!D"}, {PUSH_D, "M=!D"} },
+
+  // push x; push constant c; add/sub/and/or -- combine before pushing
+  { {PUSH_D, "@#1", "D=A", "@SP", "A=M-1", "M=D+M"}, {"@#1", "D=D+A", PUSH_D} },
+  { {PUSH_D, "@#1", "D=A", "@SP", "A=M-1", "M=M-D"}, {"@#1", "D=D-A", PUSH_D} },
+  { {PUSH_D, "@#1", "D=A", "@SP", "A=M-1", "M=D&M"}, {"@#1", "D=D&A", PUSH_D} },
+  { {PUSH_D, "@#1", "D=A", "@SP", "A=M-1", "M=D|M"}, {"@#1", "D=D|A", PUSH_D} },
+
+  // push x; push static/temp/pointer; add/sub/and/or
+  { {PUSH_D, "@!1", "D=M", "@SP", "A=M-1", "M=D+M"}, {"@!1", "D=D+M", PUSH_D} },
+  { {PUSH_D, "@!1", "D=M", "@SP", "A=M-1", "M=M-D"}, {"@!1", "D=D-M", PUSH_D} },
+  { {PUSH_D, "@!1", "D=M", "@SP", "A=M-1", "M=D&M"}, {"@!1", "D=D&M", PUSH_D} },
+  { {PUSH_D, "@!1", "D=M", "@SP", "A=M-1", "M=D|M"}, {"@!1", "D=D|M", PUSH_D} },
+
+  // push x; push constant c; eq/lt/gt -- only D is used by the comparison
+  { {PUSH_D, "@#1", "D=A", "@SP", "A=M-1", "D=M-D", "@$2"},
+    {PUSH_D, "@#1", "D=D-A", "@$2"} },
+
+  // push x; pop static/temp/pointer
+  { {PUSH_D, POP_D, "@$1"}, {"@$1"} },
+};
+
+#undef PUSH_D
+#undef POP_D
+#undef POP_ADDRESS
+#undef POP_STORE
+
+const int MAX_CAPTURES = 10;
+
+inline bool isCapture(string_view token)
+{
+  return (token.size() == 3) && (token[0] == '@') &&
+         ((token[1] == '$') || (token[1] == '#') || (token[1] == '!')) &&
+         isdigit(static_cast<unsigned char>(token[2]));
+}
+
+bool matchCapture(string_view token, string_view text, string_view* captures)
+{
+  if ((text.size() < 2) || (text[0] != '@'))
+    return false;
+
+  if (token[1] == '#')
+  {
+    for (size_t i = 1; i < text.size(); i++)
+    {
+      if (!isdigit(static_cast<unsigned char>(text[i])))
+        return false;
+    }
+  }
+  else if (token[1] == '!')
+  {
+    if ((text == "@SP") || (text == "@R15"))
+      return false;
+  }
+
+  string_view& capture = captures[token[2] - '0'];
+
+  if (capture.empty())
+    capture = text;
+
+  return capture == text;
+}
+
+// Match `pattern` against the lines to be scanned, which are stored in
+// reverse so that the next line is work.back().  On success, `length` is
+// the number of lines matched, comments included.
+bool matchPattern(const Pattern& pattern, const vector<AsmLine>& work,
+    size_t& length, string_view* captures)
+{
+  size_t i = 0;
+
+  for (auto token : pattern.match)
+  {
+    while ((i < work.size()) && (work[work.size() - 1 - i].type == L_COMMENT))
+      i++;
+
+    if (i == work.size())
+      return false;
+
+    const AsmLine& line = work[work.size() - 1 - i];
+
+    if (line.type == L_LABEL)
+      return false;
+
+    if (isCapture(token))
+    {
+      if (!matchCapture(token, line.text, captures))
+        return false;
+    }
+    else if (token != line.text)
+    {
+      return false;
+    }
+
+    i++;
+  }
+
+  length = i;
+  return true;
+}
+
+size_t longestPattern()
+{
+  size_t longest = 0;
+
+  for (const auto& pattern : patterns)
+    longest = max(longest, pattern.match.size());
+
+  return longest;
+}
+
+}  // namespace
+
+size_t optimizePeephole(AsmBuffer& buffer)
+{
+  static const size_t backtrack = longestPattern() - 1;
+
+  const vector<AsmLine>& lines = buffer.getLines();
+  vector<AsmLine> work(lines.rbegin(), lines.rend());
+  vector<AsmLine> result;
+  size_t removed = 0;
+
+  result.reserve(lines.size());
+
+  while (!work.empty())
+  {
+    const Pattern* matched = nullptr;
+    string_view captures[MAX_CAPTURES];
+    size_t length = 0;
+
+    // Every pattern begins with an A-instruction
+    if ((work.back().type == L_INSTRUCTION) && (work.back().text[0] == '@'))
+    {
+      for (const auto& pattern : patterns)
+      {
+        string_view first = pattern.match.front();
+
+        if (!isCapture(first) && (first != work.back().text))
+          continue;
+
+        for (auto& capture : captures)
+          capture = string_view();
+
+        if (matchPattern(pattern, work, length, captures))
+        {
+          matched = &pattern;
+          break;
+        }
+      }
+    }
+
+    if (matched == nullptr)
+    {
+      result.push_back(work.back());
+      work.pop_back();
+      continue;
+    }
+
+    // Keep the comments of the matched lines and queue the replacement
+    // to be scanned next
+    for (size_t i = 0; i < length; i++)
+    {
+      if (work.back().type == L_COMMENT)
+        result.push_back(work.back());
+
+      work.pop_back();
+    }
+
+    for (auto token = matched->replacement.rbegin();
+         token != matched->replacement.rend(); ++token)
+    {
+      string_view text = isCapture(*token) ? captures[(*token)[2] - '0'] : *token;
+      work.push_back(AsmLine{L_INSTRUCTION, text});
+    }
+
+    removed += matched->match.size() - matched->replacement.size();
+
+    // The replacement may complete a pattern that begins before it, so
+    // scan again from as far back as the longest pattern reaches
+    size_t instructions = 0;
+
+    while (!result.empty() && (result.back().type != L_LABEL) &&
+           (instructions < backtrack))
+    {
+      if (result.back().type == L_INSTRUCTION)
+        instructions++;
+
+      work.push_back(result.back());
+      result.pop_back();
+    }
+  }
+
+  if (removed > 0)
+    buffer.replaceLines(move(result));
+
+  return removed;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "asm_buffer.h"
+
+// Rewrite the pending lines of `buffer` with shorter equivalent
+// instruction sequences.  Returns the number of instructions removed.
+size_t optimizePeephole(AsmBuffer& buffer);
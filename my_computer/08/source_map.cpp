@@ -0,0 +1,133 @@
+#include "source_map.h"
+
+#include <algorithm>
+#include <charconv>
+
+using namespace std;
+
+namespace {
+
+// Room for the numbers and separators of a line
+const size_t MAX_NUMBERS_LENGTH = 96;
+
+const size_t BUFFER_SIZE = 64 * 1024;
+
+char* appendNumber(char* p, size_t value)
+{
+  return to_chars(p, p + 24, value).ptr;
+}
+
+char* appendText(char* p, string_view text)
+{
+  return copy(text.begin(), text.end(), p);
+}
+
+}  // namespace
+
+SourceMap::Names::Names() :
+  names(1)
+{
+  indexes.emplace("", 0);
+}
+
+uint32_t SourceMap::Names::index(string_view name)
+{
+  // Positions come in runs of one file and function
+  if (names.back() == name)
+    return static_cast<uint32_t>(names.size() - 1);
+
+  auto [it, inserted] = indexes.try_emplace(string(name),
+      static_cast<uint32_t>(names.size()));
+
+  if (inserted)
+    names.emplace_back(name);
+
+  return it->second;
+}
+
+void SourceMap::add(size_t address, const SourcePosition& position)
+{
+  // The last position had no code, e.g. a label
+  if (!ranges.empty() && (ranges.back().first == address))
+    ranges.pop_back();
+
+  Range range{address, functions.index(position.function),
+              files.index(position.file), position.vmLine,
+              position.jackLine};
+
+  // Commands of one line, such as those of an inlined call, share a range
+  if (!ranges.empty() && (ranges.back().function == range.function) &&
+      (ranges.back().file == range.file) &&
+      (ranges.back().vmLine == range.vmLine) &&
+      (ranges.back().jackLine == range.jackLine))
+  {
+    return;
+  }
+
+  ranges.push_back(range);
+}
+
+void SourceMap::write(ostream& out, size_t end) const
+{
+  // Formatted a buffer at a time, the map being about a line per command
+  size_t longestFile = 0;
+  size_t longestFunction = 1;
+
+  for (const auto& file : files.names)
+    longestFile = max(longestFile, file.size());
+
+  for (const auto& function : functions.names)
+    longestFunction = max(longestFunction, function.size());
+
+  size_t longestLine = MAX_NUMBERS_LENGTH + 2 * longestFile + longestFunction;
+  vector<char> buffer(max(BUFFER_SIZE, 2 * longestLine));
+  char* const bufferEnd = buffer.data() + buffer.size();
+  char* p = buffer.data();
+
+  for (size_t i = 0; i < ranges.size(); i++)
+  {
+    const Range& range = ranges[i];
+    size_t next = (i + 1 < ranges.size()) ? ranges[i + 1].first : end;
+
+    if (range.first >= next)
+      continue;
+
+    if (static_cast<size_t>(bufferEnd - p) < longestLine)
+    {
+      out.write(buffer.data(), p - buffer.data());
+      p = buffer.data();
+    }
+
+    p = appendNumber(p, range.first);
+    *p++ = '\t';
+    p = appendNumber(p, next - 1);
+    *p++ = '\t';
+    p = appendText(p, (range.function == 0) ? string_view("-")
+                                            : functions.names[range.function]);
+
+    if (range.file == 0)
+    {
+      *p++ = '\n';
+      continue;
+    }
+
+    const string& file = files.names[range.file];
+
+    *p++ = '\t';
+    p = appendText(p, file);
+    p = appendText(p, ".vm:");
+    p = appendNumber(p, range.vmLine);
+
+    if (range.jackLine > 0)
+    {
+      *p++ = '\t';
+      p = appendText(p, file);
+      p = appendText(p, ".jack:");
+      p = appendNumber(p, range.jackLine);
+    }
+
+    *p++ = '\n';
+  }
+
+  out.write(buffer.data(), p - buffer.data());
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/* SourcePosition - Where the code of a VM command comes from */
+struct SourcePosition {
+  std::string_view file;    // stem of the .vm file, empty for code of no
+                            // command such as the bootstrap
+  int vmLine = 0;
+  int jackLine = 0;         // from jfcl -g line comments, or 0
+  std::string_view function;    // VM function or shared routine ($$CALL)
+                                // of the code, empty outside of both
+};
+
+/* SourceMap - The ROM addresses of the code translated from each VM   */
+/*             command, written by vmt -m next to the program as       */
+/*             FILE.map, one range per line:                           */
+/*                                                                     */
+/*               FIRST LAST Main.f Main.vm:12 Main.jack:7              */
+/*                                                                     */
+/*             FIRST and LAST are the range's first and last address,  */
+/*             followed by the function of the code: a VM function, a  */
+/*             shared routine such as $$CALL, or "-" for the bootstrap */
+/*             and commands outside of any function.  The VM position  */
+/*             is left out for code of no command, and the Jack        */
+/*             position when the .vm file has no "// line N"           */
+/*             comments.  Fields are separated by tabs.                */
+class SourceMap {
+  struct Range {
+    size_t first;
+    uint32_t function;      // index into functions
+    uint32_t file;          // index into files
+    int vmLine;
+    int jackLine;
+  };
+
+  /* Names - Names numbered in order of first use, 0 being the empty name */
+  struct Names {
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> indexes;
+
+    Names();
+    uint32_t index(std::string_view name);
+  };
+
+  Names functions;
+  Names files;
+  std::vector<Range> ranges;
+
+public:
+
+  // The code from `address` on comes from `position`
+  void add(size_t address, const SourcePosition& position);
+
+  // Write the ranges below `end`, the address after the program
+  void write(std::ostream& out, size_t end) const;
+};
@@ -0,0 +1,107 @@
+#include "static_layout.h"
+
+#include <set>
+
+using namespace std;
+
+StaticLayout::StaticLayout(const vector<VmModule>& modules)
+{
+  map<string_view, set<int>> used;
+
+  for (const auto& module : modules)
+  {
+    for (const auto& function : module.functions)
+    {
+      for (const auto& block : function.blocks)
+      {
+        for (const auto& cmd : block.commands)
+        {
+          if (((cmd.type == C_PUSH) || (cmd.type == C_POP)) &&
+              (cmd.segment == S_STATIC))
+          {
+            string_view stem = cmd.file.empty() ? string_view(module.stem)
+                                                : cmd.file;
+            used[stem].insert(cmd.index);
+          }
+        }
+      }
+    }
+  }
+
+  int next = FIRST_ADDRESS;
+
+  for (const auto& [stem, indexes] : used)
+  {
+    FileStatics& statics = files[string(stem)];
+    statics.first = next;
+    statics.highestIndex = *indexes.rbegin();
+    statics.addresses.assign(statics.highestIndex + 1, -1);
+
+    for (int index : indexes)
+      statics.addresses[index] = next++;
+
+    statics.count = static_cast<int>(indexes.size());
+  }
+
+  words = next - FIRST_ADDRESS;
+}
+
+int StaticLayout::address(string_view stem, int index) const
+{
+  auto it = files.find(stem);
+
+  if ((it == files.end()) || (index < 0) ||
+      (index >= static_cast<int>(it->second.addresses.size())))
+  {
+    return -1;
+  }
+
+  return it->second.addresses[index];
+}
+
+void StaticLayout::report(ostream& out) const
+{
+  int available = LAST_ADDRESS - FIRST_ADDRESS + 1;
+
+  out << "Static variables: " << words << " of " << available
+      << " words (RAM " << FIRST_ADDRESS << "-" << LAST_ADDRESS << ")";
+
+  if (words > 0)
+    out << ", RAM " << FIRST_ADDRESS << "-" << FIRST_ADDRESS + words - 1;
+
+  out << endl;
+
+  for (const auto& [stem, statics] : files)
+  {
+    out << "  " << stem << ": " << statics.count << " word(s) at RAM "
+        << statics.first;
+
+    if (statics.count > 1)
+      out << "-" << statics.first + statics.count - 1;
+
+    // Indexes below the highest that no command of the program uses
+    int unused = statics.highestIndex + 1 - statics.count;
+
+    if (unused > 0)
+      out << ", " << unused << " unused index(es) left out";
+
+    out << endl;
+  }
+}
+
+string StaticLayout::describe() const
+{
+  string text;
+
+  for (const auto& [stem, statics] : files)
+  {
+    text += stem;
+
+    for (int address : statics.addresses)
+      text += "," + to_string(address);
+
+    text += ";";
+  }
+
+  return text;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "vm_ir.h"
+
+/* StaticLayout - RAM addresses of the static variables of a program.    */
+/*                Only the statics that some command uses are placed,    */
+/*                the files in name order and each file's statics by     */
+/*                index, packed from RAM[16] without gaps.  The layout   */
+/*                depends on nothing but the commands, unlike the        */
+/*                assembler's allocation in order of first use.          */
+/*                                                                       */
+/*                A static belongs to the file named by the `file` of    */
+/*                its command when set, e.g. within an inlined body, and */
+/*                otherwise to the file of its module.                   */
+class StaticLayout {
+public:
+  // The static segment of the Hack platform, RAM[16-255]
+  static constexpr int FIRST_ADDRESS = 16;
+  static constexpr int LAST_ADDRESS = 255;
+
+private:
+  /* FileStatics - The statics of one file, at consecutive addresses */
+  struct FileStatics {
+    int first = 0;                  // address of the lowest index used
+    std::vector<int> addresses;     // by index, -1 where unused
+    int count = 0;
+    int highestIndex = -1;
+  };
+
+  std::map<std::string, FileStatics, std::less<>> files;
+  int words = 0;
+
+public:
+
+  StaticLayout() = default;
+
+  // Place the statics used by `modules`
+  explicit StaticLayout(const std::vector<VmModule>& modules);
+
+  // Address of static `index` of the file `stem`, or -1 if not placed
+  int address(std::string_view stem, int index) const;
+
+  // Words taken, and whether they fit below LAST_ADDRESS
+  int size() const { return words; }
+  bool fits() const { return FIRST_ADDRESS + words - 1 <= LAST_ADDRESS; }
+
+  // Write the addresses and words of each file
+  void report(std::ostream& out) const;
+
+  // The layout as text, which the translation of a file depends on
+  std::string describe() const;
+};
@@ -0,0 +1,126 @@
+#include "superinstructions.h"
+
+using namespace std;
+
+namespace {
+
+bool isCommand(const VmCommand& cmd, Command_t type, Segment_t segment)
+{
+  return (cmd.type == type) && (cmd.segment == segment);
+}
+
+bool isArithmetic(const VmCommand& cmd, Arithmetic_t arithmetic)
+{
+  return (cmd.type == C_ARITHMETIC) && (cmd.arithmetic == arithmetic);
+}
+
+// A constant the Hack ALU can store without loading it into D first,
+// -1 coming from constant folding
+bool isSmallConstant(const VmCommand& cmd)
+{
+  return isCommand(cmd, C_PUSH, S_CONSTANT) && (cmd.index >= -1) &&
+         (cmd.index <= 1);
+}
+
+// Can `pop` be written straight from D?  The segments reached through a
+// base pointer need the address in A, which costs a spill to R15 unless
+// the index is 0 or 1.
+bool isDirectPop(const VmCommand& pop)
+{
+  if (pop.type != C_POP)
+    return false;
+
+  switch (pop.segment)
+  {
+    case S_STATIC:
+    case S_TEMP:
+    case S_POINTER:
+      return true;
+    case S_LOCAL:
+    case S_ARGUMENT:
+    case S_THIS:
+    case S_THAT:
+      return pop.index <= 1;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+const char* superinstructionName(Superinstruction_t type)
+{
+  switch (type)
+  {
+    case SI_INCREMENT: return "increment";
+    case SI_ARRAY_LOAD: return "array load";
+    case SI_ARRAY_STORE: return "array store";
+    case SI_MOVE: return "move";
+    case SI_PUSH_CONSTANTS: return "push constants";
+    case SI_COMPARE_BRANCH: return "compare branch";
+    default: return "none";
+  }
+}
+
+Superinstruction matchSuperinstruction(const vector<VmCommand>& commands,
+    size_t first)
+{
+  size_t remaining = commands.size() - first;
+  const VmCommand* cmd = commands.data() + first;
+
+  // push x; push constant c; add|sub; pop x
+  if ((remaining >= 4) && (cmd[0].type == C_PUSH) &&
+      (cmd[0].segment != S_CONSTANT) &&
+      isCommand(cmd[1], C_PUSH, S_CONSTANT) && (cmd[1].index >= 0) &&
+      (isArithmetic(cmd[2], A_ADD) || isArithmetic(cmd[2], A_SUB)) &&
+      isCommand(cmd[3], C_POP, cmd[0].segment) &&
+      (cmd[3].index == cmd[0].index) && (cmd[3].file == cmd[0].file))
+  {
+    return {SI_INCREMENT, 4};
+  }
+
+  // add; pop pointer 1; push|pop that k
+  if ((remaining >= 3) && isArithmetic(cmd[0], A_ADD) &&
+      isCommand(cmd[1], C_POP, S_POINTER) && (cmd[1].index == 1))
+  {
+    if (isCommand(cmd[2], C_PUSH, S_THAT))
+      return {SI_ARRAY_LOAD, 3};
+
+    if (isCommand(cmd[2], C_POP, S_THAT))
+      return {SI_ARRAY_STORE, 3};
+  }
+
+  // eq|lt|gt; [not;] if-goto L -- the loops and ifs of compiled Jack
+  if ((remaining >= 2) && (isArithmetic(cmd[0], A_EQ) ||
+                           isArithmetic(cmd[0], A_LT) ||
+                           isArithmetic(cmd[0], A_GT)))
+  {
+    if (cmd[1].type == C_IF_GOTO)
+      return {SI_COMPARE_BRANCH, 2};
+
+    if ((remaining >= 3) && isArithmetic(cmd[1], A_NOT) &&
+        (cmd[2].type == C_IF_GOTO))
+    {
+      return {SI_COMPARE_BRANCH, 3};
+    }
+  }
+
+  // push x; pop y
+  if ((remaining >= 2) && (cmd[0].type == C_PUSH) && isDirectPop(cmd[1]))
+    return {SI_MOVE, 2};
+
+  // push constant 0|1; push constant 0|1...  The last constant before a
+  // pop is left to be moved.
+  size_t length = 0;
+
+  while ((length < remaining) && isSmallConstant(cmd[length]) &&
+         !((length + 1 < remaining) && isDirectPop(cmd[length + 1])))
+  {
+    length++;
+  }
+
+  if (length >= 2)
+    return {SI_PUSH_CONSTANTS, length};
+
+  return {SI_NONE, 1};
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include "parser.h"
+
+// Sequences of VM commands that Jack programs use often enough to be
+// translated as a unit (see `vmt -p N` for the counts behind this list)
+typedef enum {
+  SI_NONE,
+  SI_INCREMENT,       // push x; push constant c; add|sub; pop x
+  SI_ARRAY_LOAD,      // add; pop pointer 1; push that k
+  SI_ARRAY_STORE,     // add; pop pointer 1; pop that k
+  SI_MOVE,            // push x; pop y
+  SI_PUSH_CONSTANTS,  // push constant -1|0|1, two or more times
+  SI_COMPARE_BRANCH,  // eq|lt|gt; [not;] if-goto L
+} Superinstruction_t;
+
+struct Superinstruction {
+  Superinstruction_t type = SI_NONE;
+  size_t length = 1;                  // number of commands it replaces
+};
+
+// Name of a superinstruction for comments in the output, e.g. "array load"
+const char* superinstructionName(Superinstruction_t);
+
+// The superinstruction beginning at commands[first], or SI_NONE.  The
+// commands must be those of one block, so that no label is passed over.
+Superinstruction matchSuperinstruction(const std::vector<VmCommand>& commands,
+    size_t first);
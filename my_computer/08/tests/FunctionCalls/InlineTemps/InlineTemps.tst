@@ -0,0 +1,15 @@
+// Test for the temps of a caller kept across an inlined call.
+// File name: InlineTemps.tst
+
+load InlineTemps.asm,
+output-file InlineTemps.out,
+compare-to InlineTemps.cmp,
+output-list RAM[0]%D1.6.1 RAM[5]%D1.6.1 RAM[6]%D1.6.1 RAM[7]%D1.6.1 RAM[8]%D1.6.1;
+
+set RAM[0] 256,
+
+repeat 2000 {
+  ticktock;
+}
+
+output;
@@ -0,0 +1,15 @@
+// Test for the temps of a caller kept across a folded multiplication.
+// File name: MultiplyTemps.tst
+
+load MultiplyTemps.asm,
+output-file MultiplyTemps.out,
+compare-to MultiplyTemps.cmp,
+output-list RAM[0]%D1.6.1 RAM[5]%D1.6.1 RAM[12]%D1.6.1;
+
+set RAM[0] 256,
+
+repeat 3000 {
+  ticktock;
+}
+
+output;
@@ -0,0 +1,15 @@
+// Test for the temps of a caller kept across a folded multiplication.
+// File name: MultiplyTempsVME.tst
+
+load,  // loads all the VM files from the current directory.
+output-file MultiplyTemps.out,
+compare-to MultiplyTemps.cmp,
+output-list RAM[0]%D1.6.1 RAM[5]%D1.6.1 RAM[12]%D1.6.1;
+
+set sp 261,
+
+repeat 150 {
+  vmstep;
+}
+
+output;
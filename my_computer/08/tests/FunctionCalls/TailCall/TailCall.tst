@@ -0,0 +1,16 @@
+// Test for calls directly followed by a return.
+// File name: TailCall.tst
+
+load TailCall.asm,
+output-file TailCall.out,
+compare-to TailCall.cmp,
+output-list RAM[0]%D1.6.1 RAM[1]%D1.6.1 RAM[2]%D1.6.1 RAM[3]%D1.6.1
+            RAM[4]%D1.6.1 RAM[5]%D1.6.1;
+
+set RAM[0] 256,
+
+repeat 40000 {
+  ticktock;
+}
+
+output;
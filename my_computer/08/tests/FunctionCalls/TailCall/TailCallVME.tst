@@ -0,0 +1,16 @@
+// Test for calls directly followed by a return.
+// File name: TailCallVME.tst
+
+load,  // loads all the VM files from the current directory.
+output-file TailCall.out,
+compare-to TailCall.cmp,
+output-list RAM[0]%D1.6.1 RAM[1]%D1.6.1 RAM[2]%D1.6.1 RAM[3]%D1.6.1
+            RAM[4]%D1.6.1 RAM[5]%D1.6.1;
+
+set sp 261,
+
+repeat 2000 {
+  vmstep;
+}
+
+output;
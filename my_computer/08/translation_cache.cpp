@@ -0,0 +1,125 @@
+#include "translation_cache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sys/stat.h>
+
+#ifdef __APPLE__
+# include <mach-o/dyld.h>
+#endif
+
+#include "parser.h"
+
+using namespace std;
+
+namespace {
+
+
+uint64_t fnv1a(string_view text, uint64_t hash = 0xcbf29ce484222325ull)
+{
+  for (unsigned char c : text)
+  {
+    hash ^= c;
+    hash *= 0x100000001b3ull;
+  }
+
+  return hash;
+}
+
+// Path of the running vmt executable
+string executablePath()
+{
+#ifdef __APPLE__
+  char path[4096];
+  uint32_t size = sizeof(path);
+
+  if (_NSGetExecutablePath(path, &size) == 0)
+    return path;
+#endif
+
+  return "/proc/self/exe";
+}
+
+}  // namespace
+
+TranslationCache::TranslationCache(const string& cacheDirectory) :
+  directory(cacheDirectory)
+{
+  if ((mkdir(directory.c_str(), 0777) != 0) && (errno != EEXIST))
+  {
+    cerr << "Failed to create cache directory, " << directory << endl;
+    exit(-2);
+  }
+
+  // Any rebuild of vmt that may change its output changes the executable,
+  // whichever source file the change was in
+  MappedFile executable(executablePath());
+  char build[32];
+  snprintf(build, sizeof(build), "%016llx",
+      static_cast<unsigned long long>(fnv1a(executable.contents())));
+
+  entryHeader = string("// vmt cache ") + build + "\n";
+}
+
+string TranslationCache::entryPath(uint64_t key) const
+{
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.asm",
+      static_cast<unsigned long long>(key));
+
+  return directory + "/" + name;
+}
+
+uint64_t TranslationCache::key(string_view contents,
+    string_view context) const
+{
+  // The context is hashed first so that moving text between the two
+  // changes the key
+  uint64_t hash = fnv1a(context);
+  hash = fnv1a(string_view("\0", 1), hash);
+  hash = fnv1a(entryHeader, hash);
+
+  return fnv1a(contents, hash);
+}
+
+bool TranslationCache::load(uint64_t key, string& fragment) const
+{
+  ifstream entry(entryPath(key), ifstream::binary);
+
+  if (!entry.is_open())
+    return false;
+
+  fragment.assign(istreambuf_iterator<char>(entry), istreambuf_iterator<char>());
+
+  // A file that is not an entry of this build or that was cut short
+  if ((fragment.compare(0, entryHeader.size(), entryHeader) != 0) ||
+      (fragment.back() != '\n'))
+  {
+    return false;
+  }
+
+  fragment.erase(0, entryHeader.size());
+  return true;
+}
+
+void TranslationCache::store(uint64_t key, string_view fragment) const
+{
+  string path = entryPath(key);
+  string partialPath = path + ".tmp";
+
+  {
+    ofstream entry(partialPath, ofstream::binary);
+
+    entry << entryHeader;
+    entry.write(fragment.data(), fragment.size());
+
+    if (!entry.good())
+      return;
+  }
+
+  // Readers never see a partial entry
+  rename(partialPath.c_str(), path.c_str());
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/* TranslationCache - A directory of translated .vm files.  Each entry is */
+/*                    the assembly of one file, named after a hash of the */
+/*                    file's contents and of everything else that its     */
+/*                    translation depends on (the file name stem, the     */
+/*                    optimization options and the vmt executable).       */
+/*                                                                        */
+/*                    The translation of a file refers to nothing outside */
+/*                    of it: comparison and return labels are numbered    */
+/*                    per file and qualified by its stem or function, so  */
+/*                    an entry may be spliced between any other files.    */
+class TranslationCache {
+  std::string directory;
+
+  // First line of every entry, naming the vmt executable that wrote it by
+  // a hash of its contents.  An entry of another executable may translate
+  // differently and is not used.
+  std::string entryHeader;
+
+  std::string entryPath(uint64_t key) const;
+
+public:
+
+  // Use the cache in `directory`, creating it if needed
+  TranslationCache(const std::string& directory);
+
+  // Key of the translation of `contents` in `context` by this vmt
+  uint64_t key(std::string_view contents, std::string_view context) const;
+
+  // Read the entry of `key` into `fragment`.  Returns false if there is
+  // none.
+  bool load(uint64_t key, std::string& fragment) const;
+
+  // Record the translation of `key`.  Failures only cost the next run a
+  // translation, so they are ignored.
+  void store(uint64_t key, std::string_view fragment) const;
+};
@@ -0,0 +1,532 @@
+#include <iostream>
+
+#include "vm_interpreter.h"
+
+using namespace std;
+
+VmInterpreter::VmInterpreter(const vector<VmModule>& modules, bool bootstrap)
+  : ram(RAM_SIZE, 0)
+{
+  if (bootstrap)
+  {
+    // As writeInit(): SP=256, the pointers set to values that are
+    // recognizable in a dump, then "call Sys.init 0"
+    ram[0] = 256;
+    ram[1] = -1;
+    ram[2] = -2;
+    ram[3] = -3;
+    ram[4] = -4;
+
+    code.push_back({OP_CALL, 0, 0});
+    code.push_back({OP_HALT});
+  }
+
+  for (const auto& module : modules)
+  {
+    for (const auto& function : module.functions)
+      linkFunction(module, function);
+  }
+
+  // Running off the end of the code halts
+  code.push_back({OP_HALT});
+
+  if (bootstrap)
+  {
+    auto found = functionIndex.find("Sys.init");
+
+    if (found == functionIndex.end())
+    {
+      cerr << "Undefined function: Sys.init" << endl;
+      exit(-1);
+    }
+
+    code[0].operand = found->second;
+  }
+
+  for (const auto& call : calls)
+  {
+    auto found = functionIndex.find(call.command->name);
+
+    if (found == functionIndex.end())
+      error(*call.module, *call.command, "Undefined function",
+            call.command->name);
+
+    code[call.index].operand = found->second;
+  }
+
+  calls.clear();
+
+  // Return addresses are kept in 16-bit RAM words
+  if (code.size() > static_cast<size_t>(INT16_MAX))
+  {
+    cerr << "Program too large: " << code.size() << " instructions" << endl;
+    exit(-1);
+  }
+
+  markHaltLoops();
+}
+
+void VmInterpreter::error(const VmModule& module, const VmCommand& command,
+    const char* what, string_view text)
+{
+  cerr << module.stem << ".vm:" << command.lineNumber << ": " << what << ": "
+       << text << endl;
+  exit(-1);
+}
+
+// Append the instructions of `function`.  Labels are scoped to their
+// function, as the translator's "function$label" symbols are, and are
+// resolved once the whole function is placed.
+void VmInterpreter::linkFunction(const VmModule& module,
+    const VmFunction& function)
+{
+  unordered_map<string_view, int32_t> labels;
+  vector<pair<size_t, const VmCommand*>> branches;
+
+  if (function.entry.type == C_FUNCTION)
+  {
+    if (!functionIndex.emplace(function.name(), code.size()).second)
+      error(module, function.entry, "Duplicate function", function.name());
+
+    code.push_back({OP_FUNCTION, function.localCount()});
+  }
+
+  for (const auto& block : function.blocks)
+  {
+    for (const auto& cmd : block.commands)
+    {
+      if (cmd.type == C_LABEL)
+      {
+        if (!labels.emplace(cmd.name, code.size()).second)
+          error(module, cmd, "Duplicate label", cmd.name);
+
+        continue;
+      }
+
+      if ((cmd.type == C_GOTO) || (cmd.type == C_IF_GOTO))
+        branches.emplace_back(code.size(), &cmd);
+
+      linkCommand(module, cmd);
+    }
+  }
+
+  for (const auto& [index, cmd] : branches)
+  {
+    auto found = labels.find(cmd->name);
+
+    if (found == labels.end())
+      error(module, *cmd, "Undefined label", cmd->name);
+
+    code[index].operand = found->second;
+  }
+}
+
+void VmInterpreter::linkCommand(const VmModule& module, const VmCommand& cmd)
+{
+  switch (cmd.type)
+  {
+    case C_ARITHMETIC:
+    {
+      static const Opcode opcodes[] = {
+        OP_HALT, OP_ADD, OP_SUB, OP_NEG, OP_EQ, OP_GT, OP_LT, OP_AND, OP_OR,
+        OP_NOT,
+      };
+
+      code.push_back({opcodes[cmd.arithmetic]});
+      break;
+    }
+
+    case C_PUSH:
+    case C_POP:
+    {
+      bool push = (cmd.type == C_PUSH);
+      int32_t address = 0;
+
+      switch (cmd.segment)
+      {
+        case S_CONSTANT:
+          if (!push)
+            error(module, cmd, "Cannot pop to segment", "constant");
+
+          code.push_back({OP_PUSH_CONSTANT, static_cast<int16_t>(cmd.index)});
+          return;
+        case S_LOCAL:
+          code.push_back({push ? OP_PUSH_LOCAL : OP_POP_LOCAL, cmd.index});
+          return;
+        case S_ARGUMENT:
+          code.push_back({push ? OP_PUSH_ARGUMENT : OP_POP_ARGUMENT, cmd.index});
+          return;
+        case S_THIS:
+          code.push_back({push ? OP_PUSH_THIS : OP_POP_THIS, cmd.index});
+          return;
+        case S_THAT:
+          code.push_back({push ? OP_PUSH_THAT : OP_POP_THAT, cmd.index});
+          return;
+        case S_STATIC:
+          address = staticAddress(module, cmd.index);
+          break;
+        case S_TEMP:
+          if (cmd.index > 7)
+            error(module, cmd, "Invalid index", "temp");
+
+          address = 5 + cmd.index;
+          break;
+        case S_POINTER:
+          if (cmd.index > 1)
+            error(module, cmd, "Invalid index", "pointer");
+
+          address = 3 + cmd.index;
+          break;
+        default:
+          error(module, cmd, "Unsupported segment", segmentName(cmd.segment));
+      }
+
+      code.push_back({push ? OP_PUSH_ADDRESS : OP_POP_ADDRESS, address});
+      break;
+    }
+
+    case C_GOTO:
+      code.push_back({OP_GOTO});
+      break;
+
+    case C_IF_GOTO:
+      code.push_back({OP_IF_GOTO});
+      break;
+
+    case C_CALL:
+      calls.push_back({code.size(), &module, &cmd});
+      code.push_back({OP_CALL, 0, cmd.index});
+      break;
+
+    case C_RETURN:
+      code.push_back({OP_RETURN});
+      break;
+
+    default:
+      error(module, cmd, "Unsupported command", "");
+  }
+}
+
+// Statics are assigned RAM from 16 in order of first use, as the
+// assembler allocates the translator's "Stem.index" variables
+int32_t VmInterpreter::staticAddress(const VmModule& module, int index)
+{
+  string symbol = module.stem + "." + to_string(index);
+  auto found = staticAddresses.emplace(symbol, nextStatic);
+
+  if (found.second)
+    nextStatic++;
+
+  return found.first->second;
+}
+
+// Replace the head of each loop that can never exit or change memory,
+// such as Sys.halt's "while (true) {}", with OP_HALT
+void VmInterpreter::markHaltLoops()
+{
+  for (size_t i = 0; i < code.size(); i++)
+  {
+    if (code[i].opcode != OP_GOTO)
+      continue;
+
+    size_t target = code[i].operand;
+
+    if ((target <= i) && isHaltLoop(target, i))
+      code[target] = {OP_HALT};
+  }
+}
+
+// Does the loop from `target` to the goto at `gotoIndex` only compute
+// constants, with every if-goto in it falling through and the stack
+// depth unchanged?
+bool VmInterpreter::isHaltLoop(size_t target, size_t gotoIndex) const
+{
+  vector<int16_t> stack;
+
+  for (size_t i = target; i < gotoIndex; i++)
+  {
+    const Instruction& instruction = code[i];
+
+    if (instruction.opcode == OP_PUSH_CONSTANT)
+    {
+      stack.push_back(static_cast<int16_t>(instruction.operand));
+      continue;
+    }
+
+    if ((instruction.opcode == OP_NEG) || (instruction.opcode == OP_NOT))
+    {
+      if (stack.empty())
+        return false;
+
+      int16_t y = stack.back();
+      stack.back() = (instruction.opcode == OP_NEG) ? -y : ~y;
+      continue;
+    }
+
+    if (instruction.opcode == OP_IF_GOTO)
+    {
+      if (stack.empty() || (stack.back() != 0))
+        return false;
+
+      stack.pop_back();
+      continue;
+    }
+
+    if ((instruction.opcode < OP_ADD) || (instruction.opcode > OP_OR) ||
+        (stack.size() < 2))
+      return false;
+
+    int16_t y = stack.back();
+    stack.pop_back();
+    int16_t x = stack.back();
+    int16_t difference = x - y;
+
+    switch (instruction.opcode)
+    {
+      case OP_ADD: stack.back() = x + y; break;
+      case OP_SUB: stack.back() = difference; break;
+      case OP_EQ: stack.back() = (difference == 0) ? -1 : 0; break;
+      case OP_GT: stack.back() = (difference > 0) ? -1 : 0; break;
+      case OP_LT: stack.back() = (difference < 0) ? -1 : 0; break;
+      case OP_AND: stack.back() = x & y; break;
+      case OP_OR: stack.back() = x | y; break;
+      default: return false;
+    }
+  }
+
+  return stack.empty();
+}
+
+// Dispatch is by computed goto where the compiler supports it: each
+// handler ends with its own indirect jump, which predicts far better than
+// the single shared jump of a switch.  The switch remains for other
+// compilers, where a handler leaves it with a break and the loop around
+// it switches again.  NEXT() is a single if statement rather than a
+// do-while, so that the break leaves the switch and not the do-while.
+#if defined(__GNUC__)
+# pragma GCC diagnostic push
+# pragma GCC diagnostic ignored "-Wpedantic"
+# define HANDLER(op) L_##op:
+# define DISPATCH() goto *handlers[ip->opcode]
+#else
+# define HANDLER(op) case op:
+# define DISPATCH() break
+#endif
+
+#define NEXT() \
+    if (--remaining == 0) \
+      goto done; \
+    else \
+      DISPATCH()
+
+uint64_t VmInterpreter::run(uint64_t steps)
+{
+  if ((steps == 0) || stopped)
+    return 0;
+
+  const Instruction* const base = code.data();
+  const Instruction* ip = base + pc;
+  int16_t* const memory = ram.data();
+  uint16_t sp = ram[0];
+  uint32_t depth = callDepth;
+  uint64_t remaining = steps;
+
+  constexpr uint16_t MASK = RAM_SIZE - 1;
+
+#define RAM(address) memory[static_cast<uint16_t>(address) & MASK]
+#define TOP RAM(sp - 1)
+#define PUSH(value) \
+    do { \
+      RAM(sp) = (value); \
+      sp++; \
+    } while (false)
+#define BINARY(expression) \
+    { \
+      sp--; \
+      int16_t y = RAM(sp); \
+      int16_t x = RAM(sp - 1); \
+      TOP = static_cast<int16_t>(expression); \
+      ip++; \
+    } \
+    NEXT()
+#define COMPARE(condition) \
+    BINARY((static_cast<int16_t>(x - y) condition 0) ? -1 : 0)
+
+#if defined(__GNUC__)
+  static const void* const handlers[] = {
+    &&L_OP_PUSH_CONSTANT, &&L_OP_PUSH_LOCAL, &&L_OP_PUSH_ARGUMENT,
+    &&L_OP_PUSH_THIS, &&L_OP_PUSH_THAT, &&L_OP_PUSH_ADDRESS,
+    &&L_OP_POP_LOCAL, &&L_OP_POP_ARGUMENT, &&L_OP_POP_THIS, &&L_OP_POP_THAT,
+    &&L_OP_POP_ADDRESS, &&L_OP_ADD, &&L_OP_SUB, &&L_OP_NEG, &&L_OP_EQ,
+    &&L_OP_GT, &&L_OP_LT, &&L_OP_AND, &&L_OP_OR, &&L_OP_NOT, &&L_OP_GOTO,
+    &&L_OP_IF_GOTO, &&L_OP_CALL, &&L_OP_FUNCTION, &&L_OP_RETURN, &&L_OP_HALT,
+  };
+
+  DISPATCH();
+#else
+  for (;;)
+  switch (ip->opcode)
+  {
+#endif
+
+  HANDLER(OP_PUSH_CONSTANT)
+    PUSH(ip->operand);
+    ip++;
+    NEXT();
+
+  HANDLER(OP_PUSH_LOCAL)
+    PUSH(RAM(RAM(1) + ip->operand));
+    ip++;
+    NEXT();
+
+  HANDLER(OP_PUSH_ARGUMENT)
+    PUSH(RAM(RAM(2) + ip->operand));
+    ip++;
+    NEXT();
+
+  HANDLER(OP_PUSH_THIS)
+    PUSH(RAM(RAM(3) + ip->operand));
+    ip++;
+    NEXT();
+
+  HANDLER(OP_PUSH_THAT)
+    PUSH(RAM(RAM(4) + ip->operand));
+    ip++;
+    NEXT();
+
+  HANDLER(OP_PUSH_ADDRESS)
+    PUSH(RAM(ip->operand));
+    ip++;
+    NEXT();
+
+  HANDLER(OP_POP_LOCAL)
+    sp--;
+    RAM(RAM(1) + ip->operand) = RAM(sp);
+    ip++;
+    NEXT();
+
+  HANDLER(OP_POP_ARGUMENT)
+    sp--;
+    RAM(RAM(2) + ip->operand) = RAM(sp);
+    ip++;
+    NEXT();
+
+  HANDLER(OP_POP_THIS)
+    sp--;
+    RAM(RAM(3) + ip->operand) = RAM(sp);
+    ip++;
+    NEXT();
+
+  HANDLER(OP_POP_THAT)
+    sp--;
+    RAM(RAM(4) + ip->operand) = RAM(sp);
+    ip++;
+    NEXT();
+
+  HANDLER(OP_POP_ADDRESS)
+    sp--;
+    RAM(ip->operand) = RAM(sp);
+    ip++;
+    NEXT();
+
+  HANDLER(OP_ADD) BINARY(x + y);
+  HANDLER(OP_SUB) BINARY(x - y);
+  HANDLER(OP_EQ) COMPARE(==);
+  HANDLER(OP_GT) COMPARE(>);
+  HANDLER(OP_LT) COMPARE(<);
+  HANDLER(OP_AND) BINARY(x & y);
+  HANDLER(OP_OR) BINARY(x | y);
+
+  HANDLER(OP_NEG)
+    TOP = static_cast<int16_t>(-TOP);
+    ip++;
+    NEXT();
+
+  HANDLER(OP_NOT)
+    TOP = static_cast<int16_t>(~TOP);
+    ip++;
+    NEXT();
+
+  HANDLER(OP_GOTO)
+    ip = base + ip->operand;
+    NEXT();
+
+  HANDLER(OP_IF_GOTO)
+    sp--;
+    ip = (RAM(sp) != 0) ? base + ip->operand : ip + 1;
+    NEXT();
+
+  HANDLER(OP_CALL)
+  {
+    PUSH(static_cast<int16_t>(ip - base + 1));
+    PUSH(RAM(1));
+    PUSH(RAM(2));
+    PUSH(RAM(3));
+    PUSH(RAM(4));
+    RAM(2) = static_cast<int16_t>(sp - 5 - ip->nargs);
+    RAM(1) = static_cast<int16_t>(sp);
+    ip = base + ip->operand;
+    depth++;
+    NEXT();
+  }
+
+  HANDLER(OP_FUNCTION)
+    for (int32_t i = 0; i < ip->operand; i++)
+      PUSH(0);
+
+    ip++;
+    NEXT();
+
+  HANDLER(OP_RETURN)
+  {
+    uint16_t frame = RAM(1);
+    auto returnIndex = static_cast<uint16_t>(RAM(frame - 5));
+
+    RAM(RAM(2)) = RAM(sp - 1);
+    sp = RAM(2) + 1;
+    RAM(4) = RAM(frame - 1);
+    RAM(3) = RAM(frame - 2);
+    RAM(2) = RAM(frame - 3);
+    RAM(1) = RAM(frame - 4);
+
+    // A return from the outermost function, where there was no call,
+    // finds whatever the caller's frame holds in place of an address and
+    // ends the program at the final OP_HALT instead
+    if (depth == 0)
+      returnIndex = code.size() - 1;
+    else
+      depth--;
+
+    ip = base + returnIndex;
+    NEXT();
+  }
+
+  HANDLER(OP_HALT)
+    stopped = true;
+    goto done;
+
+#if !defined(__GNUC__)
+  }
+#endif
+
+done:
+  pc = ip - base;
+  callDepth = depth;
+  ram[0] = static_cast<int16_t>(sp);
+
+  return steps - remaining;
+
+#undef RAM
+#undef TOP
+#undef PUSH
+#undef BINARY
+#undef COMPARE
+}
+
+#undef NEXT
+#undef DISPATCH
+#undef HANDLER
+
+#if defined(__GNUC__)
+# pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "vm_ir.h"
+
+/* VmInterpreter - Executes parsed VM modules without translating them.  */
+/*                                                                       */
+/*                 The modules are linked into one array of instructions:*/
+/*                 calls refer to the index of the function, branches to */
+/*                 the index of their label, and each static variable to */
+/*                 its RAM address.  Push and pop have an opcode per     */
+/*                 kind of segment so no segment is decoded at run time. */
+/*                                                                       */
+/*                 Memory is laid out as on the Hack platform (SP, LCL,  */
+/*                 ARG, THIS and THAT in RAM[0-4], temp in RAM[5-12],    */
+/*                 statics from RAM[16] and the stack from 256), so the  */
+/*                 RAM of a test program may be compared with a run of   */
+/*                 its translation.                                      */
+class VmInterpreter {
+public:
+  // Operation of an instruction.  The order matches the handler table
+  // of run().
+  enum Opcode : uint8_t {
+    OP_PUSH_CONSTANT,
+    OP_PUSH_LOCAL,
+    OP_PUSH_ARGUMENT,
+    OP_PUSH_THIS,
+    OP_PUSH_THAT,
+    OP_PUSH_ADDRESS,              // static, temp and pointer
+    OP_POP_LOCAL,
+    OP_POP_ARGUMENT,
+    OP_POP_THIS,
+    OP_POP_THAT,
+    OP_POP_ADDRESS,
+    OP_ADD,
+    OP_SUB,
+    OP_NEG,
+    OP_EQ,
+    OP_GT,
+    OP_LT,
+    OP_AND,
+    OP_OR,
+    OP_NOT,
+    OP_GOTO,
+    OP_IF_GOTO,
+    OP_CALL,
+    OP_FUNCTION,
+    OP_RETURN,
+    OP_HALT,
+  };
+
+  struct Instruction {
+    Opcode opcode;
+    int32_t operand = 0;          // constant, index, address or target
+    int32_t nargs = 0;            // OP_CALL
+  };
+
+  static constexpr int RAM_SIZE = 32768;
+
+private:
+  // A call awaiting the index of its function
+  struct CallSite {
+    size_t index;
+    const VmModule* module;
+    const VmCommand* command;
+  };
+
+  std::vector<Instruction> code;
+  std::vector<int16_t> ram;
+  std::unordered_map<std::string_view, int32_t> functionIndex;
+  std::unordered_map<std::string, int32_t> staticAddresses;
+  std::vector<CallSite> calls;
+  int32_t nextStatic = 16;
+  size_t pc = 0;
+  uint32_t callDepth = 0;       // calls not yet returned from
+  bool stopped = false;
+
+  void linkFunction(const VmModule& module, const VmFunction& function);
+  void linkCommand(const VmModule& module, const VmCommand& command);
+  int32_t staticAddress(const VmModule& module, int index);
+  void markHaltLoops();
+  bool isHaltLoop(size_t target, size_t gotoIndex) const;
+  [[noreturn]] static void error(const VmModule& module,
+      const VmCommand& command, const char* what, std::string_view text);
+
+public:
+
+  // Link `modules`, which must outlive the interpreter.  With
+  // `bootstrap`, execution begins as the translator's writeInit() does:
+  // SP=256 and a call of Sys.init.  Otherwise it begins at the first
+  // command of the first module.
+  VmInterpreter(const std::vector<VmModule>& modules, bool bootstrap);
+
+  // Execute up to `steps` instructions.  Returns the number executed,
+  // fewer if the program halts.
+  uint64_t run(uint64_t steps);
+
+  // Has the program halted?  It halts on reaching an infinite loop that
+  // changes nothing (Sys.halt), the end of the code, or a return from the
+  // outermost function.
+  bool halted() const { return stopped; }
+
+  // RAM[address]; SP is stored to RAM[0] when run() returns
+  int16_t peek(int address) const { return ram[address & (RAM_SIZE - 1)]; }
+  void poke(int address, int16_t value) { ram[address & (RAM_SIZE - 1)] = value; }
+
+  size_t instructionCount() const { return code.size(); }
+};
@@ -0,0 +1,79 @@
+#include "vm_ir.h"
+
+using namespace std;
+
+string_view VmBlock::label() const
+{
+  if (!commands.empty() && (commands.front().type == C_LABEL))
+    return commands.front().name;
+
+  return string_view();
+}
+
+bool VmBlock::fallsThrough() const
+{
+  if (commands.empty())
+    return true;
+
+  Command_t last = commands.back().type;
+
+  return (last != C_GOTO) && (last != C_RETURN);
+}
+
+size_t VmModule::commandCount() const
+{
+  size_t count = 0;
+
+  for (const auto& function : functions)
+  {
+    if (function.entry.type == C_FUNCTION)
+      count++;
+
+    for (const auto& block : function.blocks)
+      count += block.commands.size();
+  }
+
+  return count;
+}
+
+VmModule buildModule(const string& pathname, const string& stem)
+{
+  Parser parser(pathname);
+  VmModule module;
+
+  module.stem = stem;
+  module.source = parser.source();
+
+  while (parser.hasMoreCommands())
+  {
+    parser.advance();
+    const VmCommand& cmd = parser.command();
+
+    if (cmd.type == C_FUNCTION)
+    {
+      module.functions.emplace_back();
+      module.functions.back().entry = cmd;
+      continue;
+    }
+
+    if (module.functions.empty())
+      module.functions.emplace_back();
+
+    appendCommand(module.functions.back().blocks, cmd);
+  }
+
+  return module;
+}
+
+void appendCommand(vector<VmBlock>& blocks, const VmCommand& cmd)
+{
+  // A new block is started on demand by the next command that needs one
+  if (blocks.empty() || (cmd.type == C_LABEL) ||
+      (!blocks.back().commands.empty() &&
+       isBranch(blocks.back().commands.back().type)))
+  {
+    blocks.emplace_back();
+  }
+
+  blocks.back().commands.push_back(cmd);
+}
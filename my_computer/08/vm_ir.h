@@ -0,0 +1,63 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.h"
+
+/* VmBlock - A straight line run of commands.  A block begins at a label, */
+/*           at the start of a function, or after a branch, and ends with */
+/*           a goto, if-goto or return, or just before the next label.    */
+/*           A leading label is kept as the first command of the block.   */
+struct VmBlock {
+  std::vector<VmCommand> commands;
+
+  // Label of the block or empty if it is entered only by falling through
+  std::string_view label() const;
+
+  // Can control reach the following block from the end of this one?
+  bool fallsThrough() const;
+};
+
+/* VmFunction - The blocks of one VM function.  Commands that precede  */
+/*              the first function of a file, as in the Stage 1 tests, */
+/*              belong to a function whose `entry` has type C_NONE.    */
+struct VmFunction {
+  VmCommand entry;                  // the C_FUNCTION command
+  std::vector<VmBlock> blocks;
+
+  std::string_view name() const { return entry.name; }
+  int localCount() const { return entry.index; }
+};
+
+/* VmModule - The typed representation of one .vm file.  Label and   */
+/*            function names refer to the mapped file held by `source`. */
+struct VmModule {
+  std::string stem;                 // file name without ".vm"
+  std::shared_ptr<const MappedFile> source;
+  std::vector<VmFunction> functions;
+
+  // Names made up by passes over the module, such as the labels of
+  // inlined functions.  A deque never moves them, so commands may refer
+  // to them as they do to the source.
+  std::deque<std::string> names;
+
+  // Number of commands in the module, labels and functions included
+  size_t commandCount() const;
+};
+
+// Parse the .vm file at `pathname` into a module
+VmModule buildModule(const std::string& pathname, const std::string& stem);
+
+// Add `cmd` to the end of `blocks`, beginning a new block at a label or
+// after a branch
+void appendCommand(std::vector<VmBlock>& blocks, const VmCommand& cmd);
+
+// Does `type` end a basic block?
+inline bool isBranch(Command_t type)
+{
+  return (type == C_GOTO) || (type == C_IF_GOTO) || (type == C_RETURN);
+}
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "vm_interpreter.h"
+#include "vm_ir.h"
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+// Commands executed before a program that has not halted is stopped
+constexpr uint64_t DEFAULT_STEPS = 100000000;
+
+/* RamRange - RAM words printed after the run, from -p ADDR[:COUNT] */
+struct RamRange {
+  int address;
+  int count;
+};
+
+static void showUsage()
+{
+  cout << "USAGE: vmi [-h] [-s] [-n STEPS] [-m ADDR=VALUE]... [-p ADDR[:COUNT]]... FILENAME.vm | DIRECTORY" << endl;
+}
+
+static void showHelp()
+{
+  cout << "USAGE:\n\n"
+       << "    vmi [-s] [-n STEPS] [-m ADDR=VALUE]... [-p ADDR[:COUNT]]... FILENAME.vm\n\n"
+       << "    vmi [-s] [-n STEPS] [-m ADDR=VALUE]... [-p ADDR[:COUNT]]... DIRECTORY\n\n"
+       << "DESCRIPTION\n\n"
+       << "    Executes the VM commands of FILENAME.vm, or of all .vm files in DIRECTORY,\n"
+       << "    without translating them.  A directory is started as its translation\n"
+       << "    would be, by calling Sys.init with SP=256.  A file is started at its\n"
+       << "    first command.  The program runs until it halts or STEPS commands are\n"
+       << "    executed, then SP, LCL, ARG, THIS, THAT and the requested RAM are shown.\n\n"
+       << "OPTIONS\n\n"
+       << "    -s               Report the commands executed per second\n"
+       << "    -n STEPS         Stop after STEPS commands (default 100000000)\n"
+       << "    -m ADDR=VALUE    Set RAM[ADDR] to VALUE before the program starts\n"
+       << "    -p ADDR[:COUNT]  Show COUNT words of RAM from ADDR (default 1)\n" << endl;
+}
+
+static bool parseNumber(const char* text, char terminator, const char*& end, long& value)
+{
+  char* last;
+
+  errno = 0;
+  value = strtol(text, &last, 10);
+  end = last;
+
+  return (last != text) && (errno == 0) && (*last == terminator);
+}
+
+// Load FILENAME.vm, or the .vm files of DIRECTORY in name order
+static vector<VmModule> loadModules(const fs::path& path, bool& bootstrap)
+{
+  vector<fs::path> files;
+
+  if (fs::is_directory(path))
+  {
+    // Directories are assumed to require bootstrap code, as in vmt
+    bootstrap = true;
+
+    for (const auto& entry : fs::directory_iterator(path))
+    {
+      if (entry.is_regular_file() && (entry.path().extension() == ".vm"))
+        files.push_back(entry.path());
+    }
+
+    sort(files.begin(), files.end());
+  }
+  else if (path.extension() == ".vm")
+  {
+    bootstrap = false;
+    files.push_back(path);
+  }
+  else
+  {
+    cerr << "Input must be a .vm file or a directory, " << path.string() << endl;
+    exit(-1);
+  }
+
+  if (files.empty())
+  {
+    cerr << "No .vm files found in " << path.string() << endl;
+    exit(-1);
+  }
+
+  vector<VmModule> modules;
+
+  for (const auto& file : files)
+    modules.push_back(buildModule(file.string(), file.stem().string()));
+
+  return modules;
+}
+
+int main(int argc, char** argv)
+{
+  bool showStats = false;
+  uint64_t steps = DEFAULT_STEPS;
+  vector<pair<int, int16_t>> settings;
+  vector<RamRange> ranges;
+  int argi = 1;
+
+  for (; argi < argc - 1; argi++)
+  {
+    const char* end;
+    long address;
+    long value;
+
+    if (strcmp(argv[argi], "-s") == 0)
+    {
+      showStats = true;
+    }
+    else if ((strcmp(argv[argi], "-n") == 0) && (argi + 1 < argc - 1))
+    {
+      steps = strtoull(argv[++argi], nullptr, 10);
+    }
+    else if ((strcmp(argv[argi], "-m") == 0) && (argi + 1 < argc - 1))
+    {
+      const char* text = argv[++argi];
+
+      if (!parseNumber(text, '=', end, address) ||
+          !parseNumber(end + 1, '\0', end, value) ||
+          (address < 0) || (address >= VmInterpreter::RAM_SIZE) ||
+          (value < -32768) || (value > 65535))
+      {
+        cerr << "Invalid RAM setting, " << text << endl;
+        return 1;
+      }
+
+      settings.emplace_back(address, static_cast<int16_t>(value));
+    }
+    else if ((strcmp(argv[argi], "-p") == 0) && (argi + 1 < argc - 1))
+    {
+      const char* text = argv[++argi];
+      value = 1;
+
+      bool valid = parseNumber(text, ':', end, address) ?
+          parseNumber(end + 1, '\0', end, value) :
+          parseNumber(text, '\0', end, address);
+
+      if (!valid || (address < 0) || (value < 1) ||
+          (address + value > VmInterpreter::RAM_SIZE))
+      {
+        cerr << "Invalid RAM range, " << text << endl;
+        return 1;
+      }
+
+      ranges.push_back({static_cast<int>(address), static_cast<int>(value)});
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  if (argi != argc - 1)
+  {
+    showUsage();
+    return 1;
+  }
+
+  if ((strcmp(argv[argi], "-h") == 0) || (strcmp(argv[argi], "--help") == 0))
+  {
+    showHelp();
+    return 0;
+  }
+
+  bool bootstrap = false;
+  vector<VmModule> modules = loadModules(argv[argi], bootstrap);
+  VmInterpreter interpreter(modules, bootstrap);
+
+  for (const auto& [address, value] : settings)
+    interpreter.poke(address, value);
+
+  auto startTime = chrono::steady_clock::now();
+  uint64_t executed = interpreter.run(steps);
+
+  if (showStats)
+  {
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - startTime;
+
+    cerr << "Executed " << executed << " commands in "
+         << elapsed.count() * 1000.0 << " ms ("
+         << static_cast<double>(executed) / elapsed.count() / 1e6
+         << " M commands/s)" << endl;
+  }
+
+  cout << (interpreter.halted() ? "Halted" : "Stopped") << " after "
+       << executed << " commands" << endl
+       << "SP: " << interpreter.peek(0) << "  LCL: " << interpreter.peek(1)
+       << "  ARG: " << interpreter.peek(2) << "  THIS: " << interpreter.peek(3)
+       << "  THAT: " << interpreter.peek(4) << endl;
+
+  for (const auto& range : ranges)
+  {
+    for (int i = 0; i < range.count; i++)
+    {
+      int address = range.address + i;
+
+      cout << "RAM[" << address << "]: " << interpreter.peek(address) << endl;
+    }
+  }
+
+  return 0;
+}
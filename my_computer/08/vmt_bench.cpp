@@ -0,0 +1,618 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+// Runs of each corpus and option set; the fastest is reported
+constexpr int DEFAULT_REPEATS = 5;
+
+// Slowdown against the baseline reported as a regression, in percent
+constexpr double DEFAULT_TOLERANCE = 25.0;
+
+// Slowdowns of less than this many ms are taken as noise
+constexpr double NOISE_MS = 1.0;
+
+const vector<string> DEFAULT_OPTION_SETS = {
+  "",
+  "-fpeephole",
+  "-fshared-calls -fdce -finline -ffold-constants -fcache-top -fsuperinstructions",
+};
+
+/* Corpus - A .vm file or directory of them to translate */
+struct Corpus {
+  string name;
+  fs::path path;
+};
+
+/* Result - vmt's -s report for one corpus and option set, times in ms */
+struct Result {
+  size_t commands = 0;        // VM commands parsed
+  size_t instructions = 0;    // Hack instructions written
+  double parse = 0.0;
+  double passes = 0.0;
+  double codegen = 0.0;
+  double output = 0.0;
+  double total = 0.0;
+};
+
+static void showUsage()
+{
+  cout << "USAGE: vmt_bench [-h] [-r REPEATS] [-O OPTIONS]... [-o RESULTS] [-b BASELINE] [-t PERCENT] VMT [DIRECTORY]..." << endl;
+}
+
+static void showHelp()
+{
+  showUsage();
+
+  cout << "\nDESCRIPTION\n\n"
+       << "    Times the VM translator VMT over generated programs and over the .vm\n"
+       << "    files found below each DIRECTORY, such as 07/tests and 08/tests.  The\n"
+       << "    parse, code generation and output phases are reported separately, with\n"
+       << "    the Hack instructions written as a measure of code size.  Everything is\n"
+       << "    translated in a copy under the system temporary directory.\n\n"
+       << "OPTIONS\n\n"
+       << "    -r REPEATS    Keep the fastest of REPEATS runs (default " << DEFAULT_REPEATS << ")\n"
+       << "    -O OPTIONS    Translate with the vmt OPTIONS, e.g. \"-fpeephole\".  May be\n"
+       << "                  repeated; by default no options, -fpeephole and all of the\n"
+       << "                  optimizations other than -fpeephole\n"
+       << "    -o RESULTS    Write the results to the file RESULTS\n"
+       << "    -b BASELINE   Compare with the results in BASELINE and exit with 1 on\n"
+       << "                  any growth in instructions or a slowdown beyond PERCENT\n"
+       << "    -t PERCENT    Slowdown tolerated against BASELINE (default " << DEFAULT_TOLERANCE << ")\n" << endl;
+}
+
+/* ProgramGenerator - Writes a program shaped like compiled Jack: classes */
+/*                    of functions made of assignments, ifs, whiles and   */
+/*                    calls, with Sys.init calling the first function of  */
+/*                    each class.  The same seed gives the same program.  */
+class ProgramGenerator {
+  uint64_t state;
+  ostream* out = nullptr;
+  int labelCounter = 0;
+  int nargs = 0;
+  int nlocals = 0;
+  string className;
+  int functionIndex = 0;
+  int functionCount = 0;
+
+  unsigned int random(unsigned int limit)
+  {
+    // xorshift64
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    return static_cast<unsigned int>(state % limit);
+  }
+
+  static int argumentCount(int function) { return function % 3; }
+  static int localCount(int function) { return 2 + function % 4; }
+
+  void writeValue()
+  {
+    switch (random(8))
+    {
+      case 0:
+      case 1:
+        *out << "push local " << random(nlocals) << '\n';
+        break;
+      case 2:
+        if (nargs > 0)
+        {
+          *out << "push argument " << random(nargs) << '\n';
+          break;
+        }
+        [[fallthrough]];
+      case 3:
+        *out << "push constant " << random(100) << '\n';
+        break;
+      case 4:
+        *out << "push static " << random(8) << '\n';
+        break;
+      case 5:
+        *out << "push this " << random(4) << '\n';
+        break;
+      case 6:
+        // An array element
+        *out << "push local " << random(nlocals) << '\n'
+             << "push constant " << random(16) << '\n'
+             << "add\n"
+             << "pop pointer 1\n"
+             << "push that 0\n";
+        break;
+      default:
+        *out << "push constant " << random(2) << '\n';
+        break;
+    }
+  }
+
+  void writeExpression(int depth)
+  {
+    static const char* const operators[] = {"add", "sub", "and", "or", "eq",
+                                            "lt", "gt"};
+
+    unsigned int choice = (depth > 2) ? 0 : random(6);
+
+    if (choice < 3)
+    {
+      writeValue();
+    }
+    else if (choice < 5)
+    {
+      writeExpression(depth + 1);
+      writeExpression(depth + 1);
+      *out << operators[random(7)] << '\n';
+    }
+    else if (functionIndex + 1 < functionCount)
+    {
+      // Only later functions are called, so the program has no recursion
+      int callee = functionIndex + 1 + random(functionCount - functionIndex - 1);
+
+      for (int i = 0; i < argumentCount(callee); i++)
+        writeExpression(depth + 1);
+
+      *out << "call " << className << ".f" << callee << " "
+           << argumentCount(callee) << '\n';
+    }
+    else
+    {
+      writeValue();
+      *out << "neg\n";
+    }
+  }
+
+  void writeStatements(int depth, int count)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      unsigned int choice = (depth > 1) ? 0 : random(10);
+
+      if (choice < 6)
+      {
+        writeExpression(0);
+        *out << "pop local " << random(nlocals) << '\n';
+      }
+      else if (choice < 8)
+      {
+        int label = labelCounter++;
+
+        writeExpression(0);
+        *out << "not\n"
+             << "if-goto IF_FALSE" << label << '\n';
+        writeStatements(depth + 1, 1 + random(3));
+        *out << "goto IF_END" << label << '\n'
+             << "label IF_FALSE" << label << '\n';
+        writeStatements(depth + 1, 1 + random(2));
+        *out << "label IF_END" << label << '\n';
+      }
+      else
+      {
+        int label = labelCounter++;
+
+        *out << "label WHILE_EXP" << label << '\n';
+        writeExpression(0);
+        *out << "not\n"
+             << "if-goto WHILE_END" << label << '\n';
+        writeStatements(depth + 1, 1 + random(3));
+        *out << "goto WHILE_EXP" << label << '\n'
+             << "label WHILE_END" << label << '\n';
+      }
+    }
+  }
+
+public:
+
+  ProgramGenerator(uint64_t seed) : state(seed) {}
+
+  // Write `classes` files of `functions` functions each to `directory`
+  void write(const fs::path& directory, int classes, int functions)
+  {
+    fs::create_directories(directory);
+    functionCount = functions;
+
+    ofstream sys(directory / "Sys.vm");
+    sys << "function Sys.init 0\n";
+
+    for (int c = 0; c < classes; c++)
+    {
+      className = "Class" + to_string(c);
+
+      for (int i = 0; i < argumentCount(0); i++)
+        sys << "push constant " << i << '\n';
+
+      sys << "call " << className << ".f0 " << argumentCount(0) << '\n'
+          << "pop temp 0\n";
+
+      ofstream file(directory / (className + ".vm"));
+      out = &file;
+
+      for (functionIndex = 0; functionIndex < functions; functionIndex++)
+      {
+        nargs = argumentCount(functionIndex);
+        nlocals = localCount(functionIndex);
+        labelCounter = 0;
+
+        file << "function " << className << ".f" << functionIndex << " "
+             << nlocals << '\n';
+        writeStatements(0, 4 + random(8));
+        file << "push constant 0\n"
+             << "return\n";
+      }
+    }
+
+    sys << "label HALT\n"
+        << "goto HALT\n";
+  }
+};
+
+// Run `command`, returning its standard output.  Exits if it fails.
+static string runCommand(const string& command)
+{
+  FILE* pipe = popen(command.c_str(), "r");
+
+  if (pipe == nullptr)
+  {
+    cerr << "Failed to run " << command << endl;
+    exit(-1);
+  }
+
+  string output;
+  char buffer[4096];
+  size_t count;
+
+  while ((count = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+    output.append(buffer, count);
+
+  int status = pclose(pipe);
+
+  if ((status == -1) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+  {
+    cerr << "Failed: " << command << endl << output;
+    exit(-1);
+  }
+
+  return output;
+}
+
+// Translate `corpus` once, reading the -s report of vmt
+static Result translate(const string& vmt, const string& options,
+    const Corpus& corpus)
+{
+  string output = runCommand("'" + vmt + "' -s " + options + " '" +
+                             corpus.path.string() + "'");
+  Result result;
+  bool haveSize = false;
+  bool havePhases = false;
+
+  istringstream lines(output);
+  string line;
+
+  while (getline(lines, line))
+  {
+    const char* text = line.c_str();
+    unsigned long long first;
+    int files;
+    int matched = 0;              // characters matched by the whole pattern
+
+    if (sscanf(text, "Translated %d file(s) in %lf ms", &files,
+            &result.total) == 2)
+    {
+      continue;
+    }
+
+    if ((sscanf(text, " %llu instructions,%n", &first, &matched) == 1) &&
+        (matched > 0))
+    {
+      result.instructions = first;
+      haveSize = true;
+    }
+    else if ((sscanf(text, " %llu commands parsed,%n", &first, &matched) ==
+              1) && (matched > 0))
+    {
+      result.commands = first;
+    }
+    else if (sscanf(text, " Phases: parse %lf ms, passes %lf ms, code "
+                 "generation %lf ms, output %lf ms", &result.parse,
+                 &result.passes, &result.codegen, &result.output) == 4)
+    {
+      havePhases = true;
+    }
+  }
+
+  if (!haveSize || !havePhases)
+  {
+    cerr << "No report from vmt -s for " << corpus.name << endl << output;
+    exit(-1);
+  }
+
+  return result;
+}
+
+// The fastest of `repeats` translations of `corpus`
+static Result measure(const string& vmt, const string& options,
+    const Corpus& corpus, int repeats)
+{
+  Result best = translate(vmt, options, corpus);
+
+  for (int i = 1; i < repeats; i++)
+  {
+    Result result = translate(vmt, options, corpus);
+
+    if (result.instructions != best.instructions)
+    {
+      cerr << "Output of " << corpus.name << " changed between runs" << endl;
+      exit(-1);
+    }
+
+    best.parse = min(best.parse, result.parse);
+    best.passes = min(best.passes, result.passes);
+    best.codegen = min(best.codegen, result.codegen);
+    best.output = min(best.output, result.output);
+    best.total = min(best.total, result.total);
+  }
+
+  return best;
+}
+
+// Copy each directory below `root` that holds .vm files to `workDirectory`.
+// A directory of one file is translated as that file, without bootstrap,
+// as its test expects.
+static void findTestCorpora(const fs::path& root, const fs::path& workDirectory,
+    vector<Corpus>& corpora)
+{
+  if (!fs::is_directory(root))
+  {
+    cerr << "Not a directory, " << root << endl;
+    exit(-1);
+  }
+
+  vector<fs::path> directories = {root};
+
+  for (const auto& entry : fs::recursive_directory_iterator(root))
+  {
+    if (entry.is_directory())
+      directories.push_back(entry.path());
+  }
+
+  sort(directories.begin(), directories.end());
+
+  for (const auto& directory : directories)
+  {
+    vector<fs::path> files;
+
+    for (const auto& entry : fs::directory_iterator(directory))
+    {
+      if (entry.is_regular_file() && (entry.path().extension() == ".vm"))
+        files.push_back(entry.path().filename());
+    }
+
+    if (files.empty())
+      continue;
+
+    string name = directory.parent_path().filename().string() + "/" +
+                  directory.filename().string();
+    fs::path copy = workDirectory / "tests" / to_string(corpora.size()) /
+                    directory.filename();
+
+    fs::create_directories(copy);
+
+    for (const auto& file : files)
+      fs::copy_file(directory / file, copy / file);
+
+    corpora.push_back({name, (files.size() == 1) ? copy / files[0] : copy});
+  }
+}
+
+static string resultKey(const string& corpus, const string& options)
+{
+  return corpus + "\t" + options;
+}
+
+// Read results written with -o, keyed by corpus and options
+static map<string, Result> readResults(const string& filename)
+{
+  ifstream file(filename);
+
+  if (!file.is_open())
+  {
+    cerr << "Failed to open baseline, " << filename << endl;
+    exit(-1);
+  }
+
+  map<string, Result> results;
+  string line;
+
+  while (getline(file, line))
+  {
+    vector<string> fields;
+    istringstream splitter(line);
+    string field;
+
+    while (getline(splitter, field, '\t'))
+      fields.push_back(field);
+
+    if ((fields.size() != 9) || (fields[0] == "corpus"))
+      continue;
+
+    Result& result = results[resultKey(fields[0], fields[1])];
+    result.commands = stoull(fields[2]);
+    result.instructions = stoull(fields[3]);
+    result.parse = stod(fields[4]);
+    result.passes = stod(fields[5]);
+    result.codegen = stod(fields[6]);
+    result.output = stod(fields[7]);
+    result.total = stod(fields[8]);
+  }
+
+  return results;
+}
+
+int main(int argc, char* argv[])
+{
+  int repeats = DEFAULT_REPEATS;
+  double tolerance = DEFAULT_TOLERANCE;
+  vector<string> optionSets;
+  string resultsFilename;
+  string baselineFilename;
+  int argi = 1;
+
+  for (; argi < argc; argi++)
+  {
+    bool hasValue = (argi + 1 < argc);
+
+    if (strcmp(argv[argi], "-h") == 0)
+    {
+      showHelp();
+      return 0;
+    }
+    else if ((strcmp(argv[argi], "-r") == 0) && hasValue)
+    {
+      repeats = max(1, atoi(argv[++argi]));
+    }
+    else if ((strcmp(argv[argi], "-O") == 0) && hasValue)
+    {
+      optionSets.push_back(argv[++argi]);
+    }
+    else if ((strcmp(argv[argi], "-o") == 0) && hasValue)
+    {
+      resultsFilename = argv[++argi];
+    }
+    else if ((strcmp(argv[argi], "-b") == 0) && hasValue)
+    {
+      baselineFilename = argv[++argi];
+    }
+    else if ((strcmp(argv[argi], "-t") == 0) && hasValue)
+    {
+      tolerance = atof(argv[++argi]);
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  if (argi >= argc)
+  {
+    showUsage();
+    return 1;
+  }
+
+  string vmt = fs::absolute(argv[argi++]).string();
+
+  if (optionSets.empty())
+    optionSets = DEFAULT_OPTION_SETS;
+
+  fs::path workDirectory = fs::temp_directory_path() /
+                           ("vmt_bench." + to_string(getpid()));
+  fs::remove_all(workDirectory);
+
+  vector<Corpus> corpora = {
+    {"synthetic/small", workDirectory / "small"},
+    {"synthetic/large", workDirectory / "large"},
+  };
+
+  ProgramGenerator(1).write(corpora[0].path, 8, 16);
+  ProgramGenerator(2).write(corpora[1].path, 64, 64);
+
+  for (; argi < argc; argi++)
+    findTestCorpora(argv[argi], workDirectory, corpora);
+
+  map<string, Result> baseline;
+
+  if (!baselineFilename.empty())
+    baseline = readResults(baselineFilename);
+
+  ofstream resultsFile;
+
+  if (!resultsFilename.empty())
+  {
+    resultsFile.open(resultsFilename);
+
+    if (!resultsFile.is_open())
+    {
+      cerr << "Failed to open output file, " << resultsFilename << endl;
+      exit(-2);
+    }
+
+    resultsFile << "corpus\toptions\tcommands\tinstructions\tparse_ms\t"
+                << "passes_ms\tcodegen_ms\toutput_ms\ttotal_ms\n";
+  }
+
+  cout << left << setw(32) << "corpus" << right << setw(10) << "commands"
+       << setw(13) << "instructions" << setw(10) << "parse ms" << setw(10)
+       << "codegen" << setw(10) << "output" << setw(10) << "total"
+       << setw(14) << "commands/s" << endl;
+
+  int regressions = 0;
+
+  for (const auto& options : optionSets)
+  {
+    cout << "vmt " << (options.empty() ? "(no options)" : options) << endl;
+
+    for (const auto& corpus : corpora)
+    {
+      Result result = measure(vmt, options, corpus, repeats);
+      double rate = result.commands / max(result.total / 1000.0, 1e-9);
+
+      cout << "  " << left << setw(30) << corpus.name << right
+           << setw(10) << result.commands << setw(13) << result.instructions
+           << fixed << setprecision(2) << setw(10) << result.parse
+           << setw(10) << result.codegen << setw(10) << result.output
+           << setw(10) << result.total << setprecision(0) << setw(14)
+           << rate << defaultfloat << setprecision(6) << endl;
+
+      if (resultsFile.is_open())
+      {
+        resultsFile << corpus.name << '\t' << options << '\t'
+                    << result.commands << '\t' << result.instructions << '\t'
+                    << result.parse << '\t' << result.passes << '\t'
+                    << result.codegen << '\t' << result.output << '\t'
+                    << result.total << '\n';
+      }
+
+      auto previous = baseline.find(resultKey(corpus.name, options));
+
+      if (previous == baseline.end())
+        continue;
+
+      const Result& expected = previous->second;
+
+      if (result.instructions > expected.instructions)
+      {
+        cout << "    REGRESSION: " << expected.instructions << " -> "
+             << result.instructions << " instructions" << endl;
+        regressions++;
+      }
+
+      if ((result.total > expected.total * (1.0 + tolerance / 100.0)) &&
+          (result.total - expected.total > NOISE_MS))
+      {
+        cout << "    REGRESSION: " << expected.total << " -> "
+             << result.total << " ms" << endl;
+        regressions++;
+      }
+    }
+  }
+
+  fs::remove_all(workDirectory);
+
+  if (!baselineFilename.empty())
+    cout << regressions << " regression(s) against " << baselineFilename << endl;
+
+  return (regressions > 0) ? 1 : 0;
+}
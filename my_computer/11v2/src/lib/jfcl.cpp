@@ -71,7 +71,14 @@ static int jfcl_inner_main(const CliArgs& cliargs)
       return 0;
     }
 
-    jfcl::VmWriter VM(parser.get_ast(), cliargs.left_justify_vm_output);
+    // -w shows the text whatever the output format
+    const bool binary_output =
+        cliargs.binary_vm_output && !cliargs.halt_after_vmwriter;
+
+    jfcl::VmWriter VM(parser.get_ast(), cliargs.left_justify_vm_output,
+                      cliargs.emit_source_lines,
+                      binary_output ? VmWriter::VmFormat_t::BINARY
+                                    : VmWriter::VmFormat_t::TEXT);
     VM.lower_module();
 
     if (cliargs.halt_after_vmwriter)
@@ -80,7 +87,9 @@ static int jfcl_inner_main(const CliArgs& cliargs)
       return 0;
     }
 
-    std::ofstream ofile(output_filename);
+    std::ofstream ofile(output_filename, binary_output
+                                             ? std::ios::out | std::ios::binary
+                                             : std::ios::out);
 
     if (!ofile)
     {
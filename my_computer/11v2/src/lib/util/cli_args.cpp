@@ -62,6 +62,24 @@ CliArgs::CliArgs(int argc, const char* argv[])
       i++;
       continue;
     }
+
+    // -g - precede the VM commands of each statement with a "// line N"
+    //      comment giving its line in the .jack file
+    if ((argv[i][0] == '-') && (argv[i][1] == 'g') && (argv[i][2] == '\0'))
+    {
+      emit_source_lines = true;
+      i++;
+      continue;
+    }
+
+    // -b - write each .vm file in the binary form that vmt reads without
+    //      parsing text
+    if ((argv[i][0] == '-') && (argv[i][1] == 'b') && (argv[i][2] == '\0'))
+    {
+      binary_vm_output = true;
+      i++;
+      continue;
+    }
   }
 
   bool isDirectory = false;
@@ -121,7 +139,7 @@ void CliArgs::show_usage()
   std::cout << "SYNOPSIS:\n\n";
   std::cout << "  jfcl -h" << std::endl;
   std::cout << "  jfcl [-t|-p|-w] FILENAME.jack" << std::endl;
-  std::cout << "  jfcl [-r|-l] DIRECTORY|FILENAME.jack" << std::endl;
+  std::cout << "  jfcl [-r|-l|-g|-b] DIRECTORY|FILENAME.jack" << std::endl;
 }
 
 void CliArgs::show_help()
@@ -156,6 +174,14 @@ void CliArgs::show_help()
   std::cout << std::setw(24) << std::left << "-l";
   std::cout << "Left justify VM output (no indentation)";
 
+  std::cout << "\n  ";
+  std::cout << std::setw(24) << std::left << "-g";
+  std::cout << "Mark the VM output with the Jack line of each statement";
+
+  std::cout << "\n  ";
+  std::cout << std::setw(24) << std::left << "-b";
+  std::cout << "Write the .vm files in binary form (see vm_binary.h)";
+
   std::cout << std::endl;
 }
 
@@ -23,6 +23,10 @@ struct CliArgs {
 
   bool left_justify_vm_output {false};
 
+  bool emit_source_lines {false};
+
+  bool binary_vm_output {false};
+
 private:
   filelist_t filelist;
 };
@@ -0,0 +1,156 @@
+#include "vmwriter/vm_binary.h"
+
+#include <array>
+#include <stdexcept>
+
+using namespace std;
+
+namespace jfcl {
+
+namespace {
+
+// In opcode order, from 0x01
+constexpr array<string_view, 9> ARITHMETIC_COMMANDS {
+    "add", "sub", "neg", "eq", "gt", "lt", "and", "or", "not"};
+
+// In operand order, from 0x11 for push and 0x21 for pop
+constexpr array<string_view, 8> SEGMENTS {"argument", "local", "static",
+                                          "constant", "this",  "that",
+                                          "pointer",  "temp"};
+
+constexpr uint8_t OP_PUSH = 0x10;
+constexpr uint8_t OP_POP = 0x20;
+constexpr uint8_t OP_LABEL = 0x30;
+constexpr uint8_t OP_GOTO = 0x31;
+constexpr uint8_t OP_IF_GOTO = 0x32;
+constexpr uint8_t OP_FUNCTION = 0x33;
+constexpr uint8_t OP_CALL = 0x34;
+constexpr uint8_t OP_RETURN = 0x35;
+constexpr uint8_t OP_LINE = 0x36;
+
+constexpr string_view MAGIC {"\0VMB\1", 5};
+
+void add_varint(string& out, uint32_t value)
+{
+  while (value >= 0x80)
+  {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+
+  out.push_back(static_cast<char>(value));
+}
+
+}  // namespace
+
+void VmBinaryEncoder::add_arithmetic(string_view command)
+{
+  for (size_t i = 0; i < ARITHMETIC_COMMANDS.size(); i++)
+  {
+    if (command == ARITHMETIC_COMMANDS[i])
+    {
+      records.push_back(static_cast<char>(1 + i));
+      return;
+    }
+  }
+
+  throw domain_error("Unsupported VM command: " + string(command));
+}
+
+void VmBinaryEncoder::add_push(string_view segment, uint32_t index)
+{
+  add_segment_command(OP_PUSH, segment, index);
+}
+
+void VmBinaryEncoder::add_pop(string_view segment, uint32_t index)
+{
+  add_segment_command(OP_POP, segment, index);
+}
+
+void VmBinaryEncoder::add_label(string_view name)
+{
+  add_name_command(OP_LABEL, name);
+}
+
+void VmBinaryEncoder::add_goto(string_view name)
+{
+  add_name_command(OP_GOTO, name);
+}
+
+void VmBinaryEncoder::add_if_goto(string_view name)
+{
+  add_name_command(OP_IF_GOTO, name);
+}
+
+void VmBinaryEncoder::add_function(string_view name, uint32_t nlocals)
+{
+  add_name_command(OP_FUNCTION, name);
+  add_varint(records, nlocals);
+}
+
+void VmBinaryEncoder::add_call(string_view name, uint32_t nargs)
+{
+  add_name_command(OP_CALL, name);
+  add_varint(records, nargs);
+}
+
+void VmBinaryEncoder::add_return()
+{
+  records.push_back(static_cast<char>(OP_RETURN));
+}
+
+void VmBinaryEncoder::add_source_line(uint32_t line)
+{
+  records.push_back(static_cast<char>(OP_LINE));
+  add_varint(records, line);
+}
+
+void VmBinaryEncoder::add_segment_command(uint8_t base, string_view segment,
+                                          uint32_t index)
+{
+  for (size_t i = 0; i < SEGMENTS.size(); i++)
+  {
+    if (segment == SEGMENTS[i])
+    {
+      records.push_back(static_cast<char>(base + 1 + i));
+      add_varint(records, index);
+      return;
+    }
+  }
+
+  throw domain_error("Unsupported VM segment: " + string(segment));
+}
+
+void VmBinaryEncoder::add_name_command(uint8_t opcode, string_view name)
+{
+  records.push_back(static_cast<char>(opcode));
+  add_varint(records, intern(name));
+}
+
+string VmBinaryEncoder::str() const
+{
+  string out(MAGIC);
+
+  add_varint(out, static_cast<uint32_t>(strings.size()));
+
+  for (const auto& s : strings)
+  {
+    add_varint(out, static_cast<uint32_t>(s.size()));
+    out += s;
+  }
+
+  return out + records;
+}
+
+uint32_t VmBinaryEncoder::intern(string_view name)
+{
+  auto [it, inserted] = string_indices.try_emplace(
+      string(name), static_cast<uint32_t>(strings.size()));
+
+  if (inserted)
+    strings.emplace_back(name);
+
+  return it->second;
+}
+
+}  // namespace jfcl
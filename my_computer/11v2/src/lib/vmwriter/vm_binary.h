@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace jfcl {
+
+// Binary form of a .vm file, read by the VM translator (vmt) in place of
+// the text.  All numbers are unsigned LEB128 varints.
+//
+//   magic       "\0VMB" and a version byte (1)
+//   strings     count, then each as its length and bytes
+//   records     until the end of the file, each an opcode byte and its
+//               operands:
+//     0x01-0x09 add sub neg eq gt lt and or not
+//     0x11-0x18 push argument|local|static|constant|this|that|pointer|temp
+//               index
+//     0x21-0x28 pop of the same segments, index
+//     0x30      label string
+//     0x31      goto string
+//     0x32      if-goto string
+//     0x33      function string nlocals
+//     0x34      call string nargs
+//     0x35      return
+//     0x36      line N, the "// line N" comment of -g
+//
+// Function and label names are indices into the string table.  Each record
+// stands for one line of the text form, so that both number their
+// commands alike.
+//
+// Unknown arithmetic commands and segments throw std::domain_error.
+class VmBinaryEncoder {
+public:
+  void add_arithmetic(std::string_view command);
+  void add_push(std::string_view segment, uint32_t index);
+  void add_pop(std::string_view segment, uint32_t index);
+  void add_label(std::string_view name);
+  void add_goto(std::string_view name);
+  void add_if_goto(std::string_view name);
+  void add_function(std::string_view name, uint32_t nlocals);
+  void add_call(std::string_view name, uint32_t nargs);
+  void add_return();
+
+  // The "// line N" comment of -g
+  void add_source_line(uint32_t line);
+
+  // The encoded module
+  std::string str() const;
+
+private:
+  uint32_t intern(std::string_view name);
+  void add_segment_command(uint8_t base, std::string_view segment,
+                           uint32_t index);
+  void add_name_command(uint8_t opcode, std::string_view name);
+
+  std::vector<std::string> strings;
+  std::unordered_map<std::string, uint32_t> string_indices;
+
+  std::string records;
+};
+
+}  // namespace jfcl
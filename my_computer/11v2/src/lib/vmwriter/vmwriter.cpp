@@ -228,6 +228,11 @@ void VmWriter::lower_statement_block(SubroutineDescr& subroutine_descr,
 {
   for (auto& node : root.get_child_nodes())
   {
+    if (emit_source_lines && (node.get().line_number >= 0))
+    {
+      emit_source_line(node.get().line_number);
+    }
+
     if (node.get().type == AstNodeType_t::N_RETURN_STATEMENT)
     {
       lower_return_statement(subroutine_descr, node);
@@ -248,7 +253,7 @@ void VmWriter::lower_statement_block(SubroutineDescr& subroutine_descr,
 
       lower_subroutine_call(subroutine_descr, call_site_parent);
       // throw away call-ed subroutine's return value
-      emit_vm_instruction("pop temp 0");
+      emit_pop("temp", 0);
     }
     else if (node.get().type == AstNodeType_t::N_WHILE_STATEMENT)
     {
@@ -324,20 +329,15 @@ void VmWriter::lower_subroutine(ClassDescr& class_descr, const AstNode& root)
   // Add any subroutine local variables to the symbol table
   add_symbol(AstNodeType_t::N_LOCAL_VARIABLES);
 
-  stringstream function_decl;
-  function_decl << "function " << class_descr.get_name() << "."
-                << subroutine_name;
-  function_decl << " " << subroutine_descr.num_locals();
-  emit_vm_instruction(function_decl.str());
+  emit_function(class_descr.get_name() + "." + subroutine_name,
+                subroutine_descr.num_locals());
 
   // For class constructors, allocate class object and save to pointer 0
   if (root.type == AstNodeType_t::N_CONSTRUCTOR_DECL)
   {
-    stringstream push_const;
-    push_const << "push constant " << subroutine_descr.num_fields();
-    emit_vm_instruction(push_const.str());
-    emit_vm_instruction("call Memory.alloc 1");
-    emit_vm_instruction("pop pointer 0");
+    emit_push("constant", subroutine_descr.num_fields());
+    emit_call("Memory.alloc", 1);
+    emit_pop("pointer", 0);
   }
 
   // For class methods, get the THIS pointer passed in as argument 0
@@ -346,10 +346,8 @@ void VmWriter::lower_subroutine(ClassDescr& class_descr, const AstNode& root)
       this_var.has_value())
   {
     Symbol const& symbol = *this_var;
-    stringstream push_arg;
-    push_arg << "push argument " << symbol.index;
-    emit_vm_instruction(push_arg.str());
-    emit_vm_instruction("pop pointer 0");
+    emit_push("argument", symbol.index);
+    emit_pop("pointer", 0);
   }
 
   AstNodeCRef const BodyNode =
@@ -414,9 +412,7 @@ string VmWriter::lower_expression(SubroutineDescr& subroutine_descr,
         throw SemanticException("Unexpected encountered negative number");
       }
 
-      stringstream push_const;
-      push_const << "push constant " << int_value;
-      emit_vm_instruction(push_const.str());
+      emit_push("constant", int_value);
     }
     else if (node_type == AstNodeType_t::N_THIS_KEYWORD)
     {
@@ -425,7 +421,7 @@ string VmWriter::lower_expression(SubroutineDescr& subroutine_descr,
         throw SemanticException("'this' keyword not permitted in functions");
       }
 
-      emit_vm_instruction("push pointer 0");
+      emit_push("pointer", 0);
     }
     else if (node_type == AstNodeType_t::N_VARIABLE_NAME)
     {
@@ -439,24 +435,20 @@ string VmWriter::lower_expression(SubroutineDescr& subroutine_descr,
     {
       lower_var(subroutine_descr, node);
 
-      emit_vm_instruction("add");
-      emit_vm_instruction("pop pointer 1");
-      emit_vm_instruction("push that 0");
+      emit_arithmetic("add");
+      emit_pop("pointer", 1);
+      emit_push("that", 0);
     }
     else if (node_type == AstNodeType_t::N_STRING_CONSTANT)
     {
       const auto& str = get_ast_node_value<string>(node);
 
-      stringstream push_str_len;
-      push_str_len << "push constant " << str.length();
-      emit_vm_instruction(push_str_len.str());
-      emit_vm_instruction("call String.new 1");
+      emit_push("constant", static_cast<int>(str.length()));
+      emit_call("String.new", 1);
       for (auto ch : str)
       {
-        stringstream push_char;
-        push_char << "push constant " << static_cast<int>(ch);
-        emit_vm_instruction(push_char.str());
-        emit_vm_instruction("call String.appendChar 2");
+        emit_push("constant", static_cast<int>(ch));
+        emit_call("String.appendChar", 2);
       }
     }
     // handle operators
@@ -467,68 +459,68 @@ string VmWriter::lower_expression(SubroutineDescr& subroutine_descr,
       if (node_type == AstNodeType_t::N_OP_MULTIPLY)
       {
         validate_binary_operator_types(subroutine_descr, node);
-        emit_vm_instruction("call Math.multiply 2");
+        emit_call("Math.multiply", 2);
       }
       else if (node_type == AstNodeType_t::N_OP_DIVIDE)
       {
         validate_binary_operator_types(subroutine_descr, node);
-        emit_vm_instruction("call Math.divide 2");
+        emit_call("Math.divide", 2);
       }
       else if (node_type == AstNodeType_t::N_OP_ADD)
       {
         validate_binary_operator_types(subroutine_descr, node);
-        emit_vm_instruction("add");
+        emit_arithmetic("add");
       }
       else if (node_type == AstNodeType_t::N_OP_SUBTRACT)
       {
         validate_binary_operator_types(subroutine_descr, node);
-        emit_vm_instruction("sub");
+        emit_arithmetic("sub");
       }
       else if (node_type == AstNodeType_t::N_OP_LOGICAL_EQUALS)
       {
         validate_binary_operator_types(subroutine_descr, node);
-        emit_vm_instruction("eq");
+        emit_arithmetic("eq");
       }
       else if (node_type == AstNodeType_t::N_OP_LOGICAL_GT)
       {
         validate_binary_operator_types(subroutine_descr, node);
-        emit_vm_instruction("gt");
+        emit_arithmetic("gt");
       }
       else if (node_type == AstNodeType_t::N_OP_LOGICAL_LT)
       {
         validate_binary_operator_types(subroutine_descr, node);
-        emit_vm_instruction("lt");
+        emit_arithmetic("lt");
       }
       else if (node_type == AstNodeType_t::N_OP_BITWISE_AND)
       {
         validate_binary_operator_types(subroutine_descr, node);
-        emit_vm_instruction("and");
+        emit_arithmetic("and");
       }
       else if (node_type == AstNodeType_t::N_OP_BITWISE_OR)
       {
         validate_binary_operator_types(subroutine_descr, node);
-        emit_vm_instruction("or");
+        emit_arithmetic("or");
       }
       else if (node_type == AstNodeType_t::N_OP_PREFIX_NEG)
       {
-        emit_vm_instruction("neg");
+        emit_arithmetic("neg");
       }
       else if (node_type == AstNodeType_t::N_OP_PREFIX_BITWISE_NOT)
       {
-        emit_vm_instruction("not");
+        emit_arithmetic("not");
       }
       else if (node_type == AstNodeType_t::N_TRUE_KEYWORD)
       {
-        emit_vm_instruction("push constant 0");
-        emit_vm_instruction("not");
+        emit_push("constant", 0);
+        emit_arithmetic("not");
       }
       else if (node_type == AstNodeType_t::N_FALSE_KEYWORD)
       {
-        emit_vm_instruction("push constant 0");
+        emit_push("constant", 0);
       }
       else if (node_type == AstNodeType_t::N_NULL_KEYWORD)
       {
-        emit_vm_instruction("push constant 0");
+        emit_push("constant", 0);
       }
       else
       {
@@ -551,9 +543,7 @@ void VmWriter::lower_var(SubroutineDescr& subroutine_descr, const AstNode& node)
   {
     auto& symbol = symbol_alloc.value();
 
-    stringstream push_var;
-    push_var << "push " << symbol.stack_name << " " << symbol.symbol_index;
-    emit_vm_instruction(push_var.str());
+    emit_push(symbol.stack_name, symbol.symbol_index);
   }
   else
   {
@@ -588,8 +578,8 @@ void VmWriter::lower_return_statement(SubroutineDescr& subroutine_descr,
         throw SemanticException("Void subroutine returning non-void");
       }
 
-      emit_vm_instruction("push constant 0");
-      emit_vm_instruction("return");
+      emit_push("constant", 0);
+      emit_return();
       return;
     }
 
@@ -607,7 +597,7 @@ void VmWriter::lower_return_statement(SubroutineDescr& subroutine_descr,
     const auto& expression_node = root.get_child_nodes()[0].get();
 
     lower_expression(subroutine_descr, expression_node);
-    emit_vm_instruction("return");
+    emit_return();
   }
 }
 
@@ -641,9 +631,7 @@ void VmWriter::lower_let_statement(SubroutineDescr& subroutine_descr,
     {
       auto& sym = sym_locs.value();
 
-      stringstream pop_var;
-      pop_var << "pop " << sym.stack_name << " " << sym.symbol_index;
-      emit_vm_instruction(pop_var.str());
+      emit_pop(sym.stack_name, sym.symbol_index);
     }
     else
     {
@@ -659,9 +647,9 @@ void VmWriter::lower_let_statement(SubroutineDescr& subroutine_descr,
     lower_expression(subroutine_descr, subscript_expression_node);
     lower_var(subroutine_descr, lh_bind_node);
 
-    emit_vm_instruction("add");
-    emit_vm_instruction("pop pointer 1");
-    emit_vm_instruction("pop that 0");
+    emit_arithmetic("add");
+    emit_pop("pointer", 1);
+    emit_pop("that", 0);
   }
   else
   {
@@ -683,19 +671,16 @@ void VmWriter::lower_while_statement(SubroutineDescr& subroutine_descr,
   // Validate that while condition is boolean
   validate_boolean_context(subroutine_descr, expression_node, "while");
 
-  stringstream while_begin_label, while_end_label, if_goto_stmt, goto_stmt;
-  while_begin_label << "label WHILE_BEGIN_" << BEGIN_ID;
-  while_end_label << "label WHILE_EXIT_" << END_ID;
-  if_goto_stmt << "if-goto WHILE_EXIT_" << END_ID;
-  goto_stmt << "goto WHILE_BEGIN_" << BEGIN_ID;
+  const string begin_label = "WHILE_BEGIN_" + to_string(BEGIN_ID);
+  const string exit_label = "WHILE_EXIT_" + to_string(END_ID);
 
-  emit_vm_instruction(while_begin_label.str());
+  emit_label(begin_label);
   lower_expression(subroutine_descr, expression_node);
-  emit_vm_instruction("not");
-  emit_vm_instruction(if_goto_stmt.str());
+  emit_arithmetic("not");
+  emit_if_goto(exit_label);
   lower_statement_block(subroutine_descr, statement_block_node);
-  emit_vm_instruction(goto_stmt.str());
-  emit_vm_instruction(while_end_label.str());
+  emit_goto(begin_label);
+  emit_label(exit_label);
 }
 
 void VmWriter::lower_if_statement(SubroutineDescr& subroutine_descr,
@@ -719,41 +704,27 @@ void VmWriter::lower_if_statement(SubroutineDescr& subroutine_descr,
 
   lower_expression(subroutine_descr, expression_node);
 
+  const string true_label = "IF_TRUE_" + to_string(ID);
+  const string false_label = "IF_FALSE_" + to_string(ID);
+
+  emit_if_goto(true_label);
+  emit_goto(false_label);
+  emit_label(true_label);
+  lower_statement_block(subroutine_descr, true_statement_block_node);
+
   if (has_else)
   {
     const auto& false_statement_block_node = root.get_child_nodes()[2].get();
+    const string end_label = "IF_END_" + to_string(ID);
 
-    stringstream if_goto_true, if_false_label, goto_false, if_true_label,
-        goto_end, if_end_label;
-    if_goto_true << "if-goto IF_TRUE_" << ID;
-    if_false_label << "label IF_FALSE_" << ID;
-    goto_false << "goto IF_FALSE_" << ID;
-    if_true_label << "label IF_TRUE_" << ID;
-    goto_end << "goto IF_END_" << ID;
-    if_end_label << "label IF_END_" << ID;
-
-    emit_vm_instruction(if_goto_true.str());
-    emit_vm_instruction(goto_false.str());
-    emit_vm_instruction(if_true_label.str());
-    lower_statement_block(subroutine_descr, true_statement_block_node);
-    emit_vm_instruction(goto_end.str());
-    emit_vm_instruction(if_false_label.str());
+    emit_goto(end_label);
+    emit_label(false_label);
     lower_statement_block(subroutine_descr, false_statement_block_node);
-    emit_vm_instruction(if_end_label.str());
+    emit_label(end_label);
   }
   else
   {
-    stringstream if_goto_true, goto_false, if_true_label, if_false_label;
-    if_goto_true << "if-goto IF_TRUE_" << ID;
-    goto_false << "goto IF_FALSE_" << ID;
-    if_true_label << "label IF_TRUE_" << ID;
-    if_false_label << "label IF_FALSE_" << ID;
-
-    emit_vm_instruction(if_goto_true.str());
-    emit_vm_instruction(goto_false.str());
-    emit_vm_instruction(if_true_label.str());
-    lower_statement_block(subroutine_descr, true_statement_block_node);
-    emit_vm_instruction(if_false_label.str());
+    emit_label(false_label);
   }
 }
 
@@ -781,7 +752,7 @@ void VmWriter::lower_subroutine_call(SubroutineDescr& subroutine_descr,
     if (call_site.type == AstNodeType_t::N_LOCAL_CALL_SITE)
     {
       // Handle call: subroutine(), this pointer
-      emit_vm_instruction("push pointer 0");
+      emit_push("pointer", 0);
       call_site_args++;
 
       if (const auto* symbol_type_ptr =
@@ -810,9 +781,7 @@ void VmWriter::lower_subroutine_call(SubroutineDescr& subroutine_descr,
         auto& sym = symbol_alloc_.value();
 
         call_site_args++;
-        stringstream push_sym;
-        push_sym << "push " << sym.stack_name << " " << sym.symbol_index;
-        emit_vm_instruction(push_sym.str());
+        emit_push(sym.stack_name, sym.symbol_index);
 
         if (auto* class_type_ptr =
                 get_if<SymbolTable::ClassType_t>(&sym.variable_type);
@@ -845,7 +814,7 @@ void VmWriter::lower_subroutine_call(SubroutineDescr& subroutine_descr,
     if (call_site.type == AstNodeType_t::N_LOCAL_CALL_SITE)
     {
       // Handle call: subroutine()
-      emit_vm_instruction("push pointer 0");
+      emit_push("pointer", 0);
       call_site_args++;
       call_site_bind_name << subroutine_descr.get_class_name() << ".";
     }
@@ -863,9 +832,7 @@ void VmWriter::lower_subroutine_call(SubroutineDescr& subroutine_descr,
         auto& sym = symbol_alloc.value();
 
         call_site_args++;
-        stringstream push_sym2;
-        push_sym2 << "push " << sym.stack_name << " " << sym.symbol_index;
-        emit_vm_instruction(push_sym2.str());
+        emit_push(sym.stack_name, sym.symbol_index);
 
         if (auto* class_type_ptr =
                 get_if<SymbolTable::ClassType_t>(&sym.variable_type);
@@ -906,32 +873,97 @@ void VmWriter::lower_subroutine_call(SubroutineDescr& subroutine_descr,
   }
 
   // LOWER CALL
-  stringstream call_instr;
-  call_instr << "call " << call_site_bind_name.str() << " " << call_site_args;
-  emit_vm_instruction(call_instr.str());
+  emit_call(call_site_bind_name.str(), static_cast<int>(call_site_args));
 }
 
-void VmWriter::emit_vm_instruction(const std::string& instruction)
+void VmWriter::emit_arithmetic(std::string_view command)
 {
-  if (left_justify_output)
-  {
-    // Left justify - no indentation
-    lowered_vm << instruction << '\n';
-  }
+  if (vm_format == VmFormat_t::BINARY)
+    lowered_vm_binary.add_arithmetic(command);
   else
-  {
-    // Check if this is a control flow instruction that should not be indented
-    if (instruction.find("label ") == 0 || instruction.find("if-goto ") == 0 ||
-        instruction.find("function ") == 0)
-    {
-      lowered_vm << instruction << '\n';
-    }
-    else
-    {
-      // All other instructions get 4 spaces of indentation (including goto)
-      lowered_vm << "    " << instruction << '\n';
-    }
-  }
+    begin_text_line(true) << command << '\n';
+}
+
+void VmWriter::emit_push(std::string_view segment, int index)
+{
+  if (vm_format == VmFormat_t::BINARY)
+    lowered_vm_binary.add_push(segment, static_cast<uint32_t>(index));
+  else
+    begin_text_line(true) << "push " << segment << " " << index << '\n';
+}
+
+void VmWriter::emit_pop(std::string_view segment, int index)
+{
+  if (vm_format == VmFormat_t::BINARY)
+    lowered_vm_binary.add_pop(segment, static_cast<uint32_t>(index));
+  else
+    begin_text_line(true) << "pop " << segment << " " << index << '\n';
+}
+
+void VmWriter::emit_label(const std::string& name)
+{
+  if (vm_format == VmFormat_t::BINARY)
+    lowered_vm_binary.add_label(name);
+  else
+    begin_text_line(false) << "label " << name << '\n';
+}
+
+void VmWriter::emit_goto(const std::string& name)
+{
+  if (vm_format == VmFormat_t::BINARY)
+    lowered_vm_binary.add_goto(name);
+  else
+    begin_text_line(true) << "goto " << name << '\n';
+}
+
+void VmWriter::emit_if_goto(const std::string& name)
+{
+  if (vm_format == VmFormat_t::BINARY)
+    lowered_vm_binary.add_if_goto(name);
+  else
+    begin_text_line(false) << "if-goto " << name << '\n';
+}
+
+void VmWriter::emit_function(const std::string& name, int nlocals)
+{
+  if (vm_format == VmFormat_t::BINARY)
+    lowered_vm_binary.add_function(name, static_cast<uint32_t>(nlocals));
+  else
+    begin_text_line(false) << "function " << name << " " << nlocals << '\n';
+}
+
+void VmWriter::emit_call(const std::string& name, int nargs)
+{
+  if (vm_format == VmFormat_t::BINARY)
+    lowered_vm_binary.add_call(name, static_cast<uint32_t>(nargs));
+  else
+    begin_text_line(true) << "call " << name << " " << nargs << '\n';
+}
+
+void VmWriter::emit_return()
+{
+  if (vm_format == VmFormat_t::BINARY)
+    lowered_vm_binary.add_return();
+  else
+    begin_text_line(true) << "return" << '\n';
+}
+
+void VmWriter::emit_source_line(int line)
+{
+  // Comments are never indented
+  if (vm_format == VmFormat_t::BINARY)
+    lowered_vm_binary.add_source_line(static_cast<uint32_t>(line));
+  else
+    lowered_vm << "// line " << line << '\n';
+}
+
+std::ostream& VmWriter::begin_text_line(bool indent)
+{
+  // All other instructions get 4 spaces of indentation (including goto)
+  if (indent && !left_justify_output)
+    lowered_vm << "    ";
+
+  return lowered_vm;
 }
 
 SymbolTable::VariableType_t VmWriter::get_expression_type(
@@ -2,9 +2,11 @@
 
 #include "parser/ast.h"
 #include "program.h"
+#include "vm_binary.h"
 
 #include <sstream>
 #include <string>
+#include <string_view>
 
 namespace jfcl {
 
@@ -14,17 +16,30 @@ public:
   VmWriter(const VmWriter&) = delete;
   VmWriter& operator=(const VmWriter&) = delete;
 
-  VmWriter(const AstTree& ast_tree, bool left_justify = false)
+  typedef enum class VmFormat_s {
+    TEXT,
+    BINARY,  // see vm_binary.h
+  } VmFormat_t;
+
+  VmWriter(const AstTree& ast_tree, bool left_justify = false,
+           bool source_lines = false, VmFormat_t format = VmFormat_t::TEXT)
       : module_ast(ast_tree),
         module_root(ast_tree.get_root()),
         EmptyNodeRef(module_ast.get_empty_node_ref().get()),
-        left_justify_output(left_justify)
+        left_justify_output(left_justify),
+        emit_source_lines(source_lines),
+        vm_format(format)
   {
   }
 
   void lower_module();
 
-  std::string get_lowered_vm() const { return lowered_vm.str(); }
+  // The module in the format given to the constructor
+  std::string get_lowered_vm() const
+  {
+    return (vm_format == VmFormat_t::BINARY) ? lowered_vm_binary.str()
+                                             : lowered_vm.str();
+  }
 
 private:
   using SymbolLoweringLocations_t = struct SymbolLoweringLocations {
@@ -66,15 +81,36 @@ private:
 
   Program program;
 
+  // Only the one of vm_format is written
   std::stringstream lowered_vm;
+  VmBinaryEncoder lowered_vm_binary;
 
   bool left_justify_output;
 
+  // Precede each statement with a "// line N" comment for profilers and
+  // debuggers to map VM commands back to the .jack file
+  bool emit_source_lines;
+
+  VmFormat_t vm_format;
+
   // Global label counter for unique label generation across all subroutines
   int global_label_counter {0};
 
-  // Helper method to add indentation based on VM instruction type
-  void emit_vm_instruction(const std::string& instruction);
+  // Emit a VM command in vm_format
+  void emit_arithmetic(std::string_view command);
+  void emit_push(std::string_view segment, int index);
+  void emit_pop(std::string_view segment, int index);
+  void emit_label(const std::string& name);
+  void emit_goto(const std::string& name);
+  void emit_if_goto(const std::string& name);
+  void emit_function(const std::string& name, int nlocals);
+  void emit_call(const std::string& name, int nargs);
+  void emit_return();
+  void emit_source_line(int line);
+
+  // The text output, indented for a command other than label, if-goto
+  // and function unless left justified
+  std::ostream& begin_text_line(bool indent);
 
   // Helper method to get next unique label ID
   int get_next_label_id() { return global_label_counter++; }
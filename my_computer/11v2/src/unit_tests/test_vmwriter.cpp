@@ -884,6 +884,140 @@ SCENARIO("VMWriter Statements")
   }
 }
 
+SCENARIO("VMWriter source lines")
+{
+  SECTION("Each statement is marked with its Jack line")
+  {
+    // clang-format off
+    std::string expected_str = expected_string({
+        "class Main",
+        "{",
+        "  function int f()",
+        "  {",
+        "    var int a;",
+        "    let a = 1;",
+        "    while (true) {",
+        "      let a = 0;",
+        "    }",
+        "    return a;",
+        "  }",
+        "}",
+        ""}
+    );
+    // clang-format on
+    TextReader R(expected_str.data());
+    JackTokenizer T(R);
+    auto tokens = T.parse_tokens();
+
+    AstTree ast;
+    Parser parser(tokens, ast);
+    std::string class_name;
+    parser.parse_class(class_name);
+
+    VmWriter VM(parser.get_ast(), false, true);
+    VM.lower_module();
+
+    REQUIRE(VM.get_lowered_vm() ==
+            "function Main.f 1\n"
+            "// line 6\n"
+            "    push constant 1\n"
+            "    pop local 0\n"
+            "// line 7\n"
+            "label WHILE_BEGIN_0\n"
+            "    push constant 0\n"
+            "    not\n"
+            "    not\n"
+            "if-goto WHILE_EXIT_1\n"
+            "// line 8\n"
+            "    push constant 0\n"
+            "    pop local 0\n"
+            "    goto WHILE_BEGIN_0\n"
+            "label WHILE_EXIT_1\n"
+            "// line 10\n"
+            "    push local 0\n"
+            "    return\n");
+  }
+}
+
+SCENARIO("VMWriter binary output")
+{
+  SECTION("Commands and line comments are encoded with a string table")
+  {
+    // clang-format off
+    std::string expected_str = expected_string({
+        "class Main",
+        "{",
+        "  function int f()",
+        "  {",
+        "    var int a;",
+        "    let a = 1;",
+        "    while (true) {",
+        "      let a = 0;",
+        "    }",
+        "    return a;",
+        "  }",
+        "}",
+        ""}
+    );
+    // clang-format on
+    TextReader R(expected_str.data());
+    JackTokenizer T(R);
+    auto tokens = T.parse_tokens();
+
+    AstTree ast;
+    Parser parser(tokens, ast);
+    std::string class_name;
+    parser.parse_class(class_name);
+
+    VmWriter VM(parser.get_ast(), false, true, VmWriter::VmFormat_t::BINARY);
+    VM.lower_module();
+
+    // clang-format off
+    const char expected[] =
+        "\0VMB\1"
+        "\3" "\6Main.f" "\15WHILE_BEGIN_0" "\14WHILE_EXIT_1"
+        "\x33\0\1"      // function Main.f 1
+        "\x36\6"         // line 6
+        "\x14\1"         // push constant 1
+        "\x22\0"         // pop local 0
+        "\x36\7"         // line 7
+        "\x30\1"         // label WHILE_BEGIN_0
+        "\x14\0"         // push constant 0
+        "\x09"           // not
+        "\x09"           // not
+        "\x32\2"         // if-goto WHILE_EXIT_1
+        "\x36\10"        // line 8
+        "\x14\0"         // push constant 0
+        "\x22\0"         // pop local 0
+        "\x31\1"         // goto WHILE_BEGIN_0
+        "\x30\2"         // label WHILE_EXIT_1
+        "\x36\12"        // line 10
+        "\x12\0"         // push local 0
+        "\x35";          // return
+    // clang-format on
+
+    REQUIRE(VM.get_lowered_vm() ==
+            std::string(expected, sizeof(expected) - 1));
+  }
+
+  SECTION("Operands are varints")
+  {
+    VmBinaryEncoder encoder;
+    encoder.add_push("constant", 300);
+    encoder.add_pop("static", 5);
+
+    REQUIRE(encoder.str() == std::string("\0VMB\1\0\x14\xac\x02\x23\5", 11));
+  }
+
+  SECTION("Unknown commands and segments are rejected")
+  {
+    VmBinaryEncoder encoder;
+
+    REQUIRE_THROWS_AS(encoder.add_push("nowhere", 1), std::domain_error);
+    REQUIRE_THROWS_AS(encoder.add_arithmetic("mul"), std::domain_error);
+  }
+}
+
 #if 0
 // Not implementing this feature
 